@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_admission.h"
+
+#include <algorithm>
+
+#include "adaptiveCPU_controller.h"
+
+namespace bbque { namespace plugins {
+
+AdmissionQueue::AdmissionQueue():
+    cycle(0) {
+}
+
+void AdmissionQueue::RecordUsage(uint32_t uid, uint64_t used) {
+    if (history.size() >= ADMISSION_HISTORY_MAX &&
+            history.find(uid) == history.end())
+        TrimHistory();
+    history[uid] = {used, cycle};
+}
+
+uint32_t AdmissionQueue::Waited(uint32_t uid) const {
+    auto it = waiting.find(uid);
+    return (it != waiting.end()) ? it->second : 0;
+}
+
+uint32_t AdmissionQueue::PrevWaited(uint32_t uid) const {
+    auto it = prev_waiting.find(uid);
+    return (it != prev_waiting.end()) ? it->second : 0;
+}
+
+uint64_t AdmissionQueue::Reserve(
+        std::vector<AdmissionCandidate_t> const & candidates,
+        AdmissionParams_t const & params,
+        bool new_cycle) const {
+    // Waiting cycles up to the last cycle
+    uint32_t wait = std::max<uint32_t>(params.aging, 1);
+    for (auto const & c : candidates) {
+        uint32_t waited = new_cycle ? Waited(c.uid) : PrevWaited(c.uid);
+        if (waited >= wait)
+            return params.min_quota;
+    }
+    return 0;
+}
+
+uint64_t AdmissionQueue::Admit(
+        std::vector<AdmissionCandidate_t> const & candidates,
+        AdmissionParams_t const & params,
+        uint64_t available,
+        std::vector<uint64_t> & grants,
+        bool new_cycle) {
+    if (new_cycle) {
+        ++cycle;
+        prev_waiting.swap(waiting);
+        waiting.clear();
+    }
+
+    // Effective priority: the waiting time raises it
+    std::vector<std::pair<int64_t, size_t>> order;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        int64_t priority = candidates[i].priority;
+        if (params.aging > 0)
+            priority -= PrevWaited(candidates[i].uid) / params.aging;
+        order.emplace_back(priority, i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [this, &candidates](std::pair<int64_t, size_t> const & a,
+                std::pair<int64_t, size_t> const & b) {
+            if (a.first != b.first)
+                return a.first < b.first;
+            return PrevWaited(candidates[a.second].uid) >
+                PrevWaited(candidates[b.second].uid); });
+
+    bool queueing = false;
+    grants.assign(candidates.size(), 0);
+    for (auto const & entry : order) {
+        AdmissionCandidate_t const & c(candidates[entry.second]);
+
+        // Initial quota sized on the last known usage
+        uint64_t quota = params.default_quota;
+        auto it = history.find(c.uid);
+        if (it != history.end())
+            quota = std::min(std::max(
+                it->second.used + ADMISSIBLE_DELTA / 2, params.min_quota),
+                params.max_quota);
+
+        // Once a candidate is queued, the following ones are queued too:
+        // nobody overtakes an application waiting for a viable quota
+        quota = std::min(quota, available);
+        if (queueing || quota < params.min_quota) {
+            queueing = true;
+            waiting[c.uid] = PrevWaited(c.uid) + 1;
+            continue;
+        }
+        grants[entry.second] = quota;
+        available -= quota;
+    }
+
+    return available;
+}
+
+void AdmissionQueue::TrimHistory() {
+    std::vector<uint64_t> cycles;
+    for (auto const & h : history)
+        cycles.push_back(h.second.cycle);
+    std::nth_element(cycles.begin(), cycles.begin() + cycles.size() / 2,
+        cycles.end());
+    uint64_t median = cycles[cycles.size() / 2];
+
+    for (auto it = history.begin(); it != history.end(); ) {
+        if (it->second.cycle <= median)
+            it = history.erase(it);
+        else
+            ++it;
+    }
+}
+
+} // namespace plugins
+
+} // namespace bbque
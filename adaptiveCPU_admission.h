@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_ADMISSION_H_
+#define BBQUE_ADAPTIVE_CPU_ADMISSION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#define DEFAULT_ADMISSION_MIN_QUOTA 50
+#define DEFAULT_ADMISSION_MAX_QUOTA 300
+#define DEFAULT_ADMISSION_AGING 10
+/** Applications whose usage history is kept */
+#define ADMISSION_HISTORY_MAX 4096
+
+/*
+ * Admission control of the applications entering the scheduling.
+ *
+ * The candidates are visited by priority (0 is the highest one), raised by
+ * one level every "aging" cycles spent waiting, so that a low priority
+ * application cannot starve. A candidate is admitted only if it can get at
+ * least the minimum viable quota: otherwise it is queued, together with all
+ * the candidates following it. The initial quota is sized on the usage the
+ * application had the last time it was running, if known.
+ *
+ * Aging alone does not let the queue move if the running applications take
+ * all the budget freed: once a candidate has been waiting for "aging"
+ * cycles (or at all, with no aging), the minimum viable quota is set aside
+ * before the running applications can grow (see Reserve()).
+ */
+
+namespace bbque { namespace plugins {
+
+/** An application asking to be admitted */
+struct AdmissionCandidate_t
+{
+    uint32_t uid;
+    /** Application priority (0 is the highest one) */
+    uint32_t priority;
+};
+
+/** Admission parameters */
+struct AdmissionParams_t
+{
+    /** Minimum viable initial quota */
+    uint64_t min_quota;
+    /** Maximum initial quota sized on the usage history */
+    uint64_t max_quota;
+    /** Initial quota with no usage history */
+    uint64_t default_quota;
+    /** Waiting cycles to raise the priority by one level (0 = no aging) */
+    uint32_t aging;
+};
+
+class AdmissionQueue {
+
+public:
+
+    AdmissionQueue();
+
+    /**
+    * @brief Record the usage of a running application
+    */
+    void RecordUsage(uint32_t uid, uint64_t used);
+
+    /**
+    * @brief Admit the candidates within the available budget
+    *
+    * @param candidates The applications asking to be admitted
+    * @param params Admission parameters
+    * @param available The available budget
+    * @param grants Filled with the initial quota of each candidate, or 0 if
+    * the candidate has been queued
+    * @param new_cycle false to admit another partition of the candidates
+    * (e.g., of another budget group) in the same cycle
+    *
+    * @return The budget left
+    */
+    uint64_t Admit(
+        std::vector<AdmissionCandidate_t> const & candidates,
+        AdmissionParams_t const & params,
+        uint64_t available,
+        std::vector<uint64_t> & grants,
+        bool new_cycle = true);
+
+    /**
+    * @brief The budget to set aside for the candidates, before the running
+    * applications can grow
+    *
+    * @param new_cycle false if another partition of the candidates has
+    * already been admitted in the cycle (see Admit())
+    *
+    * @return The minimum viable quota if a candidate has been waiting for
+    * the aging cycles, 0 otherwise
+    */
+    uint64_t Reserve(
+        std::vector<AdmissionCandidate_t> const & candidates,
+        AdmissionParams_t const & params,
+        bool new_cycle = true) const;
+
+    /**
+    * @brief Cycles an application has been waiting for admission
+    */
+    uint32_t Waited(uint32_t uid) const;
+
+    /**
+    * @brief Number of applications queued in the last admission
+    */
+    inline size_t Queued() const { return waiting.size(); }
+
+private:
+
+    /** Waiting cycles of the queued applications */
+    std::unordered_map<uint32_t, uint32_t> waiting;
+
+    /** Waiting cycles at the beginning of the current cycle */
+    std::unordered_map<uint32_t, uint32_t> prev_waiting;
+
+    uint32_t PrevWaited(uint32_t uid) const;
+
+    /** Last usage of the applications and the cycle it has been recorded */
+    struct History_t
+    {
+        uint64_t used;
+        uint64_t cycle;
+    };
+    std::unordered_map<uint32_t, History_t> history;
+
+    uint64_t cycle;
+
+    /** Drop the oldest half of the usage history */
+    void TrimHistory();
+
+};
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_ADMISSION_H_
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_allocator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define WATERFILL_ITERATIONS 64
+
+namespace bbque { namespace plugins {
+
+namespace {
+
+inline double Share(Demand_t const & d, double level) {
+    double x = d.weight * level - static_cast<double>(d.base);
+    if (x <= 0.0)
+        return 0.0;
+    return std::min(x, static_cast<double>(d.request));
+}
+
+/** Water level at which the admitted demands consume the budget */
+double SolveLevel(
+        std::vector<Demand_t> const & demands,
+        std::vector<bool> const & admitted,
+        uint64_t budget) {
+    double hi = 0.0;
+    for (size_t i = 0; i < demands.size(); ++i) {
+        if (!admitted[i])
+            continue;
+        Demand_t const & d(demands[i]);
+        hi = std::max(hi, static_cast<double>(d.base + d.request) / d.weight);
+    }
+
+    double lo = 0.0;
+    for (int it = 0; it < WATERFILL_ITERATIONS; ++it) {
+        double mid = (lo + hi) / 2.0;
+        double sum = 0.0;
+        for (size_t i = 0; i < demands.size(); ++i) {
+            if (admitted[i])
+                sum += Share(demands[i], mid);
+        }
+        if (sum > static_cast<double>(budget))
+            hi = mid;
+        else
+            lo = mid;
+    }
+    return lo;
+}
+
+/** Integer grants at a given level, rounding leftovers included */
+void Integerize(
+        std::vector<Demand_t> const & demands,
+        std::vector<bool> const & admitted,
+        double level,
+        uint64_t budget,
+        std::vector<uint64_t> & grants) {
+    std::vector<std::pair<double, size_t>> fractions;
+    uint64_t used = 0;
+
+    grants.assign(demands.size(), 0);
+    for (size_t i = 0; i < demands.size(); ++i) {
+        if (!admitted[i])
+            continue;
+        double x = Share(demands[i], level);
+        grants[i] = static_cast<uint64_t>(std::floor(x));
+        used += grants[i];
+        if (grants[i] < demands[i].request)
+            fractions.emplace_back(x - std::floor(x), i);
+    }
+
+    std::stable_sort(fractions.begin(), fractions.end(),
+        [](std::pair<double, size_t> const & a,
+                std::pair<double, size_t> const & b) {
+            return a.first > b.first; });
+
+    uint64_t leftover = (budget > used) ? budget - used : 0;
+    for (auto const & f : fractions) {
+        if (leftover == 0)
+            break;
+        ++grants[f.second];
+        --leftover;
+    }
+}
+
+} // namespace
+
+uint64_t WaterFill(
+        std::vector<Demand_t> const & demands,
+        uint64_t budget,
+        std::vector<uint64_t> & grants) {
+    uint64_t total = 0;
+    for (auto const & d : demands)
+        total += d.request;
+
+    // Enough budget for everybody
+    if (total <= budget) {
+        grants.resize(demands.size());
+        for (size_t i = 0; i < demands.size(); ++i)
+            grants[i] = demands[i].request;
+        return budget - total;
+    }
+
+    // Demands subject to a floor, in admission order
+    std::vector<size_t> ranked;
+    for (size_t i = 0; i < demands.size(); ++i) {
+        if (demands[i].floor > 0)
+            ranked.push_back(i);
+    }
+    std::stable_sort(ranked.begin(), ranked.end(),
+        [&demands](size_t a, size_t b) {
+            return demands[a].weight > demands[b].weight; });
+
+    std::vector<bool> admitted(demands.size());
+    auto fill = [&](size_t nr_admitted) {
+        for (size_t i = 0; i < demands.size(); ++i)
+            admitted[i] = (demands[i].floor == 0);
+        for (size_t k = 0; k < nr_admitted; ++k)
+            admitted[ranked[k]] = true;
+        double level = SolveLevel(demands, admitted, budget);
+        Integerize(demands, admitted, level, budget, grants);
+        for (size_t k = 0; k < nr_admitted; ++k) {
+            size_t i = ranked[k];
+            if (grants[i] < std::min(demands[i].floor, demands[i].request))
+                return false;
+        }
+        return true;
+    };
+
+    // Largest number of floor-constrained demands that can be admitted:
+    // admitting one more can only lower the level of the others
+    size_t lo = 0;
+    size_t hi = ranked.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi + 1) / 2;
+        if (fill(mid))
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    fill(lo);
+
+    uint64_t used = 0;
+    for (auto g : grants)
+        used += g;
+    return (budget > used) ? budget - used : 0;
+}
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_ALLOCATOR_H_
+#define BBQUE_ADAPTIVE_CPU_ALLOCATOR_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace bbque { namespace plugins {
+
+/** CPU budget demand of an application */
+struct Demand_t
+{
+    /** Quota already held by the application */
+    uint64_t base;
+    /** Requested quota increment */
+    uint64_t request;
+    /**
+     * Minimum worthwhile increment: below this value the application gets
+     * nothing (0 to accept any increment)
+     */
+    uint64_t floor;
+    /** Relative weight of the application (> 0) */
+    float weight;
+};
+
+/**
+ * @brief Max-min fair (water-filling) division of a CPU budget
+ *
+ * Each application is filled up to a common water level, scaled by its
+ * weight and accounting for the quota it already holds:
+ *
+ *   grant_i = min(request_i, max(0, weight_i * level - base_i))
+ *
+ * If the budget covers every request, each application gets its whole
+ * request. Otherwise, the demands with a non-zero floor are admitted in
+ * order of weight (then of position) while every admitted one can get at
+ * least its floor. Integer rounding leftovers go to the largest fractional
+ * parts, ties broken by position, so that the result is deterministic.
+ *
+ * @param demands The demands
+ * @param budget The budget to divide
+ * @param grants Filled with the increment granted to each demand
+ *
+ * @return The unassigned budget
+ */
+uint64_t WaterFill(
+        std::vector<Demand_t> const & demands,
+        uint64_t budget,
+        std::vector<uint64_t> & grants);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_ALLOCATOR_H_
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_batch.h"
+
+#include <cstdlib>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+# define BATCH_SIMD
+# include <immintrin.h>
+#endif
+
+/** Bound of the inputs computed in 32-bit lanes: no sum can overflow */
+#define BATCH_LANE_LIMIT (1LL << 28)
+/** Bound of the products truncated to 32-bit lanes */
+#define BATCH_PRODUCT_LIMIT 2147483648.0f
+
+namespace bbque { namespace plugins {
+
+#ifdef BATCH_SIMD
+
+namespace {
+
+/*
+ * Load 8 (AVX2) or 4 (SSE) signed 64-bit values as 32-bit lanes, flagging
+ * in "bad" the values out of [-BATCH_LANE_LIMIT, BATCH_LANE_LIMIT]
+ */
+
+__attribute__((target("avx2")))
+inline __m256i Narrow8(int64_t const * p, __m256i & bad) {
+    __m256i const hi_bound = _mm256_set1_epi64x(BATCH_LANE_LIMIT);
+    __m256i const lo_bound = _mm256_set1_epi64x(-BATCH_LANE_LIMIT);
+    __m256i const pick = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + 4));
+    bad = _mm256_or_si256(bad, _mm256_cmpgt_epi64(lo, hi_bound));
+    bad = _mm256_or_si256(bad, _mm256_cmpgt_epi64(lo_bound, lo));
+    bad = _mm256_or_si256(bad, _mm256_cmpgt_epi64(hi, hi_bound));
+    bad = _mm256_or_si256(bad, _mm256_cmpgt_epi64(lo_bound, hi));
+    lo = _mm256_permutevar8x32_epi32(lo, pick);
+    hi = _mm256_permutevar8x32_epi32(hi, pick);
+    return _mm256_blend_epi32(lo, hi, 0xF0);
+}
+
+__attribute__((target("avx2")))
+inline void Widen8(int64_t * p, __m256i v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p),
+        _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + 4),
+        _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+}
+
+__attribute__((target("avx2")))
+inline __m256i Truncate8(__m256 v, __m256 & ok) {
+    __m256 const sign = _mm256_set1_ps(-0.0f);
+    __m256 const bound = _mm256_set1_ps(BATCH_PRODUCT_LIMIT);
+    ok = _mm256_and_ps(ok,
+        _mm256_cmp_ps(_mm256_andnot_ps(sign, v), bound, _CMP_LT_OQ));
+    return _mm256_cvttps_epi32(v);
+}
+
+__attribute__((target("sse4.2")))
+inline __m128i Narrow4(int64_t const * p, __m128i & bad) {
+    __m128i const hi_bound = _mm_set1_epi64x(BATCH_LANE_LIMIT);
+    __m128i const lo_bound = _mm_set1_epi64x(-BATCH_LANE_LIMIT);
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + 2));
+    bad = _mm_or_si128(bad, _mm_cmpgt_epi64(lo, hi_bound));
+    bad = _mm_or_si128(bad, _mm_cmpgt_epi64(lo_bound, lo));
+    bad = _mm_or_si128(bad, _mm_cmpgt_epi64(hi, hi_bound));
+    bad = _mm_or_si128(bad, _mm_cmpgt_epi64(lo_bound, hi));
+    lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 0, 2, 0));
+    hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm_unpacklo_epi64(lo, hi);
+}
+
+__attribute__((target("sse4.2")))
+inline void Widen4(int64_t * p, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm_cvtepi32_epi64(v));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 2),
+        _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+}
+
+__attribute__((target("sse4.2")))
+inline __m128i Truncate4(__m128 v, __m128 & ok) {
+    __m128 const sign = _mm_set1_ps(-0.0f);
+    __m128 const bound = _mm_set1_ps(BATCH_PRODUCT_LIMIT);
+    ok = _mm_and_ps(ok, _mm_cmplt_ps(_mm_andnot_ps(sign, v), bound));
+    return _mm_cvttps_epi32(v);
+}
+
+} // namespace
+
+#endif // BATCH_SIMD
+
+bool PIDBatch::ParseKernel(std::string const & name, Kernel_t & kernel) {
+    if (name == "auto")
+        kernel = KERNEL_AUTO;
+    else if (name == "scalar")
+        kernel = KERNEL_SCALAR;
+    else if (name == "sse")
+        kernel = KERNEL_SSE;
+    else if (name == "avx2")
+        kernel = KERNEL_AVX2;
+    else
+        return false;
+    return true;
+}
+
+char const * PIDBatch::KernelName(Kernel_t kernel) {
+    switch (kernel) {
+    case KERNEL_SCALAR:
+        return "scalar";
+    case KERNEL_SSE:
+        return "sse";
+    case KERNEL_AVX2:
+        return "avx2";
+    default:
+        return "auto";
+    }
+}
+
+PIDBatch::Kernel_t PIDBatch::BestKernel() {
+#ifdef BATCH_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return KERNEL_AVX2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return KERNEL_SSE;
+#endif
+    return KERNEL_SCALAR;
+}
+
+PIDBatch::PIDBatch():
+    kernel(KERNEL_SCALAR) {
+}
+
+PIDBatch::Kernel_t PIDBatch::SetKernel(Kernel_t k) {
+    Kernel_t best = BestKernel();
+    // Kernels are ordered by capability: never go beyond the CPU support
+    if (k == KERNEL_AUTO || k > best)
+        k = best;
+    kernel = k;
+    return kernel;
+}
+
+void PIDBatch::Resize(size_t count) {
+    for (auto v : {&prev_quota, &prev_used, &headroom, &ierr, &derr,
+            &neg_delta, &delta, &error, &pvar, &ivar, &dvar, &cv,
+            &ierr_next})
+        v->resize(count);
+    kp.resize(count);
+    ki.resize(count);
+    kd.resize(count);
+}
+
+void PIDBatch::Run(size_t begin, size_t end) {
+    if (kernel == KERNEL_AVX2)
+        RunAVX2(begin, end);
+    else if (kernel == KERNEL_SSE)
+        RunSSE(begin, end);
+    else
+        RunScalar(begin, end);
+}
+
+void PIDBatch::RunScalar(size_t begin, size_t end) {
+    // Same operations, in the same types, of PIDStep
+    for (size_t i = begin; i < end; ++i) {
+        int64_t d = prev_quota[i] - prev_used[i];
+        if (prev_used[i] >= prev_quota[i] - THRESHOLD)
+            d = neg_delta[i];
+
+        int64_t e = ADMISSIBLE_DELTA/2 + headroom[i] - d;
+        if (std::llabs(e) < ADMISSIBLE_DELTA/2)
+            e = 0;
+
+        int64_t ie = ierr[i] + e;
+        delta[i] = d;
+        error[i] = e;
+        pvar[i] = kp[i] * e;
+        ivar[i] = ki[i] * ie;
+        dvar[i] = kd[i] * (e - derr[i]);
+        cv[i] = pvar[i] + ivar[i] + dvar[i];
+        ierr_next[i] = ie;
+    }
+}
+
+#ifdef BATCH_SIMD
+
+__attribute__((target("avx2")))
+void PIDBatch::RunAVX2(size_t begin, size_t end) {
+    __m256i const threshold = _mm256_set1_epi32(THRESHOLD);
+    __m256i const half = _mm256_set1_epi32(ADMISSIBLE_DELTA/2);
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256i bad = _mm256_setzero_si256();
+        __m256i q = Narrow8(&prev_quota[i], bad);
+        __m256i u = Narrow8(&prev_used[i], bad);
+        __m256i h = Narrow8(&headroom[i], bad);
+        __m256i ie = Narrow8(&ierr[i], bad);
+        __m256i de = Narrow8(&derr[i], bad);
+        __m256i nd = Narrow8(&neg_delta[i], bad);
+        if (!_mm256_testz_si256(bad, bad)) {
+            RunScalar(i, i + 8);
+            continue;
+        }
+
+        // Slack, or the forfait delta if saturated
+        __m256i d = _mm256_sub_epi32(q, u);
+        __m256i free = _mm256_cmpgt_epi32(_mm256_sub_epi32(q, threshold), u);
+        d = _mm256_blendv_epi8(nd, d, free);
+
+        // Error, zeroed in the admissible range
+        __m256i e = _mm256_sub_epi32(_mm256_add_epi32(half, h), d);
+        __m256i in_range = _mm256_cmpgt_epi32(half, _mm256_abs_epi32(e));
+        e = _mm256_andnot_si256(in_range, e);
+        ie = _mm256_add_epi32(ie, e);
+
+        // Single precision products, truncated as the scalar conversions
+        __m256 ok = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        __m256i p = Truncate8(_mm256_mul_ps(_mm256_loadu_ps(&kp[i]),
+            _mm256_cvtepi32_ps(e)), ok);
+        __m256i iv = Truncate8(_mm256_mul_ps(_mm256_loadu_ps(&ki[i]),
+            _mm256_cvtepi32_ps(ie)), ok);
+        __m256i dv = Truncate8(_mm256_mul_ps(_mm256_loadu_ps(&kd[i]),
+            _mm256_cvtepi32_ps(_mm256_sub_epi32(e, de))), ok);
+        if (_mm256_movemask_ps(ok) != 0xFF) {
+            RunScalar(i, i + 8);
+            continue;
+        }
+
+        Widen8(&delta[i], d);
+        Widen8(&error[i], e);
+        Widen8(&pvar[i], p);
+        Widen8(&ivar[i], iv);
+        Widen8(&dvar[i], dv);
+        Widen8(&ierr_next[i], ie);
+        for (size_t j = i; j < i + 8; ++j)
+            cv[j] = pvar[j] + ivar[j] + dvar[j];
+    }
+    RunScalar(i, end);
+}
+
+__attribute__((target("sse4.2")))
+void PIDBatch::RunSSE(size_t begin, size_t end) {
+    __m128i const threshold = _mm_set1_epi32(THRESHOLD);
+    __m128i const half = _mm_set1_epi32(ADMISSIBLE_DELTA/2);
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128i bad = _mm_setzero_si128();
+        __m128i q = Narrow4(&prev_quota[i], bad);
+        __m128i u = Narrow4(&prev_used[i], bad);
+        __m128i h = Narrow4(&headroom[i], bad);
+        __m128i ie = Narrow4(&ierr[i], bad);
+        __m128i de = Narrow4(&derr[i], bad);
+        __m128i nd = Narrow4(&neg_delta[i], bad);
+        if (!_mm_testz_si128(bad, bad)) {
+            RunScalar(i, i + 4);
+            continue;
+        }
+
+        __m128i d = _mm_sub_epi32(q, u);
+        __m128i free = _mm_cmpgt_epi32(_mm_sub_epi32(q, threshold), u);
+        d = _mm_blendv_epi8(nd, d, free);
+
+        __m128i e = _mm_sub_epi32(_mm_add_epi32(half, h), d);
+        __m128i in_range = _mm_cmpgt_epi32(half, _mm_abs_epi32(e));
+        e = _mm_andnot_si128(in_range, e);
+        ie = _mm_add_epi32(ie, e);
+
+        __m128 ok = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128i p = Truncate4(_mm_mul_ps(_mm_loadu_ps(&kp[i]),
+            _mm_cvtepi32_ps(e)), ok);
+        __m128i iv = Truncate4(_mm_mul_ps(_mm_loadu_ps(&ki[i]),
+            _mm_cvtepi32_ps(ie)), ok);
+        __m128i dv = Truncate4(_mm_mul_ps(_mm_loadu_ps(&kd[i]),
+            _mm_cvtepi32_ps(_mm_sub_epi32(e, de))), ok);
+        if (_mm_movemask_ps(ok) != 0xF) {
+            RunScalar(i, i + 4);
+            continue;
+        }
+
+        Widen4(&delta[i], d);
+        Widen4(&error[i], e);
+        Widen4(&pvar[i], p);
+        Widen4(&ivar[i], iv);
+        Widen4(&dvar[i], dv);
+        Widen4(&ierr_next[i], ie);
+        for (size_t j = i; j < i + 4; ++j)
+            cv[j] = pvar[j] + ivar[j] + dvar[j];
+    }
+    RunScalar(i, end);
+}
+
+#else
+
+void PIDBatch::RunAVX2(size_t begin, size_t end) {
+    RunScalar(begin, end);
+}
+
+void PIDBatch::RunSSE(size_t begin, size_t end) {
+    RunScalar(begin, end);
+}
+
+#endif // BATCH_SIMD
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_BATCH_H_
+#define BBQUE_ADAPTIVE_CPU_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "adaptiveCPU_controller.h"
+
+/*
+ * Batch (structure of arrays) version of PIDStep.
+ *
+ * The inputs and the controller memory of all the applications are kept in
+ * contiguous arrays, and the control step is computed in a single pass by
+ * a SIMD kernel (AVX2 or SSE4.2, chosen at run-time) or by a scalar loop.
+ *
+ * The results are identical to PIDStep: the SIMD kernels use 32-bit integer
+ * lanes and single precision products, which give the same values of the
+ * scalar 64-bit math as long as the operands fit 32 bits. The blocks with
+ * an operand or a product out of range are computed by the scalar loop.
+ */
+
+namespace bbque { namespace plugins {
+
+class PIDBatch {
+
+public:
+
+    typedef enum Kernel {
+        KERNEL_AUTO = 0,
+        KERNEL_SCALAR,
+        KERNEL_SSE,
+        KERNEL_AVX2
+    } Kernel_t;
+
+    /**
+    * @brief Parse a kernel name (auto, scalar, sse, avx2)
+    *
+    * @return false if the name is unknown
+    */
+    static bool ParseKernel(std::string const & name, Kernel_t & kernel);
+
+    static char const * KernelName(Kernel_t kernel);
+
+    /**
+    * @brief The best kernel supported by the CPU
+    */
+    static Kernel_t BestKernel();
+
+    PIDBatch();
+
+    /**
+    * @brief Select the kernel, falling back to the best supported one
+    *
+    * @return The selected kernel
+    */
+    Kernel_t SetKernel(Kernel_t kernel);
+
+    inline Kernel_t GetKernel() const { return kernel; }
+
+    /**
+    * @brief Resize the arrays to the given number of applications
+    */
+    void Resize(size_t count);
+
+    inline size_t Size() const { return prev_quota.size(); }
+
+    /**
+    * @brief Set the inputs of an application
+    */
+    inline void Set(size_t i,
+            PIDParams_t const & params,
+            PIDState_t const & state,
+            uint64_t quota,
+            uint64_t used,
+            int64_t margin) {
+        neg_delta[i] = params.neg_delta;
+        kp[i] = params.kp;
+        ki[i] = params.ki;
+        kd[i] = params.kd;
+        ierr[i] = state.ierr;
+        derr[i] = state.derr;
+        prev_quota[i] = quota;
+        prev_used[i] = used;
+        headroom[i] = margin;
+    }
+
+    /**
+    * @brief Compute the control step of the applications in [begin, end)
+    */
+    void Run(size_t begin, size_t end);
+
+    /**
+    * @brief The control step outcome of an application
+    */
+    inline PIDOutput_t Output(size_t i) const {
+        PIDOutput_t out;
+        out.delta = delta[i];
+        out.error = error[i];
+        out.pvar = pvar[i];
+        out.ivar = ivar[i];
+        out.dvar = dvar[i];
+        out.ffvar = 0;
+        out.cv = cv[i];
+        out.state.ierr = ierr_next[i];
+        out.state.derr = error[i];
+        return out;
+    }
+
+    /** Inputs */
+    std::vector<int64_t> prev_quota;
+    std::vector<int64_t> prev_used;
+    std::vector<int64_t> headroom;
+    std::vector<int64_t> ierr;
+    std::vector<int64_t> derr;
+    std::vector<int64_t> neg_delta;
+    std::vector<float> kp;
+    std::vector<float> ki;
+    std::vector<float> kd;
+
+    /** Outputs */
+    std::vector<int64_t> delta;
+    std::vector<int64_t> error;
+    std::vector<int64_t> pvar;
+    std::vector<int64_t> ivar;
+    std::vector<int64_t> dvar;
+    std::vector<int64_t> cv;
+    std::vector<int64_t> ierr_next;
+
+private:
+
+    Kernel_t kernel;
+
+    void RunScalar(size_t begin, size_t end);
+
+    void RunSSE(size_t begin, size_t end);
+
+    void RunAVX2(size_t begin, size_t end);
+
+};
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_BATCH_H_
@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Scaling microbenchmarks of the AdaptiveCPU scheduling cycle.
+ *
+ * The tool replaces the System, ResourceAccounter, BindingManager and
+ * ApplicationManager with local stand-ins (a list of applications with
+ * their booked quota, a set of CPU binding domains, and a synthetic power
+ * reading), and runs the same phases of
+ * AdaptiveCPUSchedPol::ScheduleApplications: controller state lookup, the
+ * control actions and the budget reconciliation of the cycle engine shared
+ * with the policy (see CycleEngine), in each allocation mode, CPU domain
+ * placement and state eviction. The framework calls of the policy
+ * (resource accounting, binding and schedule requests, logging) are not
+ * measured.
+ *
+ * Each benchmark is parametrized by the number of applications, of CPU
+ * binding domains, and the percentage of running applications: the not
+ * running ones are replaced by new applications at every cycle. Besides
+ * the time per cycle, the heap allocations per cycle and per application
+ * are reported.
+ *
+ * The results can be stored as a baseline, and compared with a baseline:
+ *   --acpu_save_baseline=FILE  store the results in FILE
+ *   --acpu_baseline=FILE       compare the results with FILE, failing if
+ *                              slower (or allocating more) than tolerated
+ *   --acpu_tolerance=PERCENT   tolerated slow-down (default 10)
+ * All the other options are passed to Google Benchmark.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "adaptiveCPU_controller.h"
+#include "adaptiveCPU_cycle.h"
+#include "adaptiveCPU_params.h"
+#include "adaptiveCPU_placement.h"
+#include "adaptiveCPU_state.h"
+
+using namespace bbque::plugins;
+
+#define BENCH_DEFAULT_TOLERANCE 10.0
+/** Processing capacity per application, i.e. the level of contention */
+#define BENCH_CAPACITY_PER_APP 70
+#define BENCH_SEED 1
+/** Budget groups of the groups mode, and the cycle period [ms] */
+#define BENCH_GROUPS_COUNT 4
+#define BENCH_PERIOD_MS 100
+
+/*
+ * Heap allocations counter
+ */
+
+static std::atomic<uint64_t> nr_allocs(0);
+
+// The replaced operators pair malloc() and free() themselves
+#if __GNUC__ >= 11
+# pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void * operator new(size_t size) {
+    nr_allocs.fetch_add(1, std::memory_order_relaxed);
+    void * p = std::malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void * p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+    std::free(p);
+}
+
+/** Stand-in of the application descriptor and its booked resources */
+struct BenchApp_t
+{
+    uint32_t uid;
+    bool running;
+    uint32_t priority;
+    uint64_t quota;
+    uint64_t used;
+    uint64_t demand;
+};
+
+/** Stand-in of the per-cycle application info of the policy */
+struct BenchInfo_t : public CycleApp_t
+{
+    BenchApp_t * app;
+};
+
+typedef enum BenchMode {
+    BENCH_GREEDY = 0,
+    BENCH_BATCH,
+    BENCH_FAIR,
+    BENCH_ADMISSION,
+    BENCH_GROUPS,
+    BENCH_HYSTERESIS,
+    BENCH_OVERCOMMIT,
+    BENCH_POWER,
+    BENCH_BURST
+} BenchMode_t;
+
+/**
+ * Stand-in system and the scheduling cycle of the policy
+ */
+class BenchScheduler {
+
+public:
+
+    BenchScheduler(uint32_t nr_apps, uint32_t nr_domains,
+            uint32_t running_pct, BenchMode_t mode):
+            mode(mode),
+            running_pct(running_pct),
+            next_uid(0),
+            gen(BENCH_SEED),
+            params() {
+        uint64_t capacity = uint64_t(nr_apps) * BENCH_CAPACITY_PER_APP;
+        for (uint32_t d = 0; d < nr_domains; ++d) {
+            domain_ids.push_back(d);
+            domain_capacities.push_back(capacity / nr_domains);
+        }
+        total_capacity = capacity / nr_domains * nr_domains;
+        apps.resize(nr_apps);
+        for (auto & app : apps)
+            NewApplication(app);
+        Configure(nr_apps);
+        engine.Batch().SetKernel(PIDBatch::KERNEL_AUTO);
+
+        // Warm-up: reach the steady mix of running applications
+        for (int i = 0; i < 10; ++i)
+            Cycle();
+    }
+
+    /** A scheduling cycle, followed by the execution of the applications */
+    void Cycle() {
+        Schedule();
+        Execute();
+    }
+
+private:
+
+    BenchMode_t mode;
+    uint32_t running_pct;
+    uint32_t next_uid;
+    std::mt19937 gen;
+    PolicyParams_t params;
+
+    std::vector<BenchApp_t> apps;
+    std::vector<int32_t> domain_ids;
+    std::vector<uint64_t> domain_capacities;
+    uint64_t total_capacity;
+
+    ControllerStateTable ctrl_states;
+    PlacementEngine placement;
+    CycleEngine engine;
+    std::vector<BenchInfo_t> infos;
+    std::vector<CycleApp_t *> cycle_apps;
+    std::vector<int32_t> cpu_ids;
+
+    /** Policy parameters of the mode, with the defaults of the policy */
+    void Configure(uint32_t nr_apps) {
+        params.pid = {DEFAULT_NEG_DELTA, DEFAULT_KP, DEFAULT_KI, DEFAULT_KD};
+        params.parallel_chunk = DEFAULT_PARALLEL_CHUNK;
+        params.batch = (mode == BENCH_BATCH);
+        params.fair_allocation = (mode == BENCH_FAIR || mode == BENCH_GROUPS);
+        params.admission_queue = (mode == BENCH_ADMISSION);
+        params.admission = {DEFAULT_ADMISSION_MIN_QUOTA,
+            DEFAULT_ADMISSION_MAX_QUOTA, INITIAL_DEFAULT_QUOTA,
+            DEFAULT_ADMISSION_AGING};
+        params.forecast.method = FORECAST_NONE;
+        params.hysteresis = {mode == BENCH_HYSTERESIS,
+            DEFAULT_HYSTERESIS_GROW, DEFAULT_HYSTERESIS_SHRINK,
+            DEFAULT_HYSTERESIS_MAX_HOLD, DEFAULT_RECONF_COST,
+            DEFAULT_RECONF_ALPHA};
+        params.overcommit = {mode == BENCH_OVERCOMMIT,
+            DEFAULT_OVERCOMMIT_RISK, DEFAULT_OVERCOMMIT_MAX_RATIO,
+            DEFAULT_OVERCOMMIT_RECLAIM};
+        // One watt per application at the capacity
+        params.power.budget = (mode == BENCH_POWER) ? nr_apps : 0;
+        params.power.gain = DEFAULT_POWER_GAIN;
+        params.power.min_ratio = DEFAULT_POWER_MIN_RATIO;
+        params.power.shrink = POWER_SHRINK_EFFICIENCY;
+        params.burst.reserve = (mode == BENCH_BURST) ? total_capacity / 10 : 0;
+        params.burst.earn = DEFAULT_BURST_EARN;
+        params.burst.max_credit = DEFAULT_BURST_MAX_CREDIT;
+        params.burst.step = DEFAULT_BURST_STEP;
+        if (mode != BENCH_GROUPS)
+            return;
+        for (uint32_t g = 0; g < BENCH_GROUPS_COUNT; ++g)
+            params.groups.groups.push_back({"group" + std::to_string(g),
+                total_capacity / (2 * BENCH_GROUPS_COUNT),
+                total_capacity / 2, float(g + 1)});
+    }
+
+    void NewApplication(BenchApp_t & app) {
+        app.uid = next_uid++;
+        app.running = false;
+        app.priority = gen() % 5;
+        app.quota = 0;
+        app.used = 0;
+        app.demand = 10 + gen() % 120;
+    }
+
+    void Schedule() {
+        // Init: ResourceAccounter stand-in
+        ctrl_states.BeginCycle();
+        uint64_t booked = 0;
+        uint64_t used = 0;
+        for (auto const & app : apps) {
+            if (!app.running)
+                continue;
+            booked += app.quota;
+            used += app.used;
+        }
+        uint64_t available_cpu = (total_capacity > booked) ?
+            total_capacity - booked : 0;
+        placement.Reset(domain_ids, domain_capacities);
+        engine.Begin(params, ctrl_states.Cycle(), available_cpu,
+            total_capacity, BENCH_PERIOD_MS);
+
+        // Phase 1: collect and control actions
+        infos.clear();
+        for (auto & app : apps) {
+            BenchInfo_t info;
+            info.app = &app;
+            info.uid = app.uid;
+            info.priority = app.priority;
+            info.weight = 1.0;
+            info.prev_quota = app.quota;
+            info.prev_used = app.used;
+            info.prev_delta = app.quota - app.used;
+            info.next_quota = 0;
+            info.booked = 0;
+            info.running = app.running;
+            info.skip = false;
+            info.reset = false;
+            info.held = false;
+            info.share = 0;
+            info.demand = 0;
+            info.grant = 0;
+            info.gains = &params.pid;
+            info.params = params.pid;
+            info.throttle = {false, 0, 0};
+            info.energy = 0;
+            info.latency = (mode == BENCH_BURST) && (app.uid % 4 == 0);
+            info.prev_burst = 0;
+            info.burst = 0;
+            info.reclaimed = 0;
+            info.group = app.uid % BENCH_GROUPS_COUNT;
+            bool created;
+            ctrl_states.Get(app.uid, created);
+            infos.push_back(info);
+        }
+        cycle_apps.clear();
+        for (auto & info : infos) {
+            info.state = ctrl_states.Find(info.uid);
+            // Overcommit: only a share of the quota assigned has been booked
+            if (params.overcommit.enabled && info.running) {
+                info.prev_quota = info.state->last_quota;
+                info.prev_delta = info.prev_quota - info.prev_used;
+            }
+            engine.Collect(info);
+            cycle_apps.push_back(&info);
+        }
+        engine.Control(cycle_apps);
+
+        // Phase 2: budget reconciliation. Power meter stand-in: 1.5 W per
+        // application using its share of the capacity
+        PowerSample_t power = {true, 0,
+            1.5 * used / BENCH_CAPACITY_PER_APP};
+        engine.Reconcile(cycle_apps, power);
+
+        // Phase 3: CPU domain placement of the quotas to book, as in
+        // AdaptiveCPUSchedPol::ScaleBookings
+        if (params.overcommit.enabled)
+            OvercommitBookings(cycle_apps, total_capacity);
+        else {
+            for (auto & info : infos)
+                info.booked = info.next_quota;
+        }
+        for (auto & info : infos) {
+            if (info.skip)
+                continue;
+            int32_t prev_binding = info.running ?
+                info.state->last_binding : CTRL_NO_BINDING;
+            placement.Candidates(info.booked, prev_binding, cpu_ids);
+            int32_t binding = cpu_ids.empty() ? CTRL_NO_BINDING : cpu_ids[0];
+            placement.Commit(binding, info.booked, prev_binding);
+            info.state->last_binding = binding;
+            info.app->quota = info.booked;
+            info.app->running = true;
+        }
+
+        ctrl_states.Evict();
+    }
+
+    /**
+     * Execution with the new quotas: the usage is bounded by the quota,
+     * some applications change their demand, and the not running ones are
+     * replaced by new applications, keeping the running percentage
+     */
+    void Execute() {
+        uint32_t nr_replaced = apps.size() * (100 - running_pct) / 100;
+        for (auto & app : apps) {
+            if (gen() % 16 == 0)
+                app.demand = 10 + gen() % 120;
+            app.used = std::min(app.demand, app.quota);
+        }
+        for (uint32_t i = 0; i < nr_replaced; ++i)
+            NewApplication(apps[gen() % apps.size()]);
+    }
+
+};
+
+static void BM_Schedule(benchmark::State & state, BenchMode_t mode) {
+    uint32_t nr_apps = state.range(0);
+    uint32_t nr_domains = state.range(1);
+    uint32_t running_pct = state.range(2);
+    BenchScheduler sched(nr_apps, nr_domains, running_pct, mode);
+
+    uint64_t allocs = nr_allocs.load(std::memory_order_relaxed);
+    for (auto _ : state)
+        sched.Cycle();
+    allocs = nr_allocs.load(std::memory_order_relaxed) - allocs;
+
+    state.counters["allocs/cycle"] = benchmark::Counter(
+        allocs, benchmark::Counter::kAvgIterations);
+    state.counters["allocs/app"] = benchmark::Counter(
+        double(allocs) / nr_apps, benchmark::Counter::kAvgIterations);
+    state.counters["t/app"] = benchmark::Counter(
+        double(state.iterations()) * nr_apps,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+static void ScheduleArgs(benchmark::internal::Benchmark * b) {
+    b->ArgNames({"apps", "domains", "running%"})
+        ->ArgsProduct({{10, 100, 1000, 10000}, {1, 16, 256}, {100, 90, 50}})
+        ->Unit(benchmark::kMicrosecond)
+        ->UseRealTime();
+}
+
+BENCHMARK_CAPTURE(BM_Schedule, greedy, BENCH_GREEDY)->Apply(ScheduleArgs);
+BENCHMARK_CAPTURE(BM_Schedule, batch, BENCH_BATCH)->Apply(ScheduleArgs);
+BENCHMARK_CAPTURE(BM_Schedule, fair, BENCH_FAIR)->Apply(ScheduleArgs);
+BENCHMARK_CAPTURE(BM_Schedule, admission, BENCH_ADMISSION)
+    ->Apply(ScheduleArgs);
+BENCHMARK_CAPTURE(BM_Schedule, groups, BENCH_GROUPS)->Apply(ScheduleArgs);
+BENCHMARK_CAPTURE(BM_Schedule, hysteresis, BENCH_HYSTERESIS)
+    ->Apply(ScheduleArgs);
+BENCHMARK_CAPTURE(BM_Schedule, overcommit, BENCH_OVERCOMMIT)
+    ->Apply(ScheduleArgs);
+BENCHMARK_CAPTURE(BM_Schedule, power, BENCH_POWER)->Apply(ScheduleArgs);
+BENCHMARK_CAPTURE(BM_Schedule, burst, BENCH_BURST)->Apply(ScheduleArgs);
+
+/*
+ * Baseline storage and comparison
+ */
+
+struct BenchResult_t
+{
+    double ns;
+    double allocs;
+};
+
+typedef std::map<std::string, BenchResult_t> BenchResults_t;
+
+/** Console output, keeping the results of each benchmark */
+class BaselineReporter : public benchmark::ConsoleReporter {
+
+public:
+
+    BenchResults_t results;
+
+    void ReportRuns(std::vector<Run> const & runs) override {
+        for (auto const & run : runs) {
+            if (run.error_occurred || run.run_type != Run::RT_Iteration)
+                continue;
+            BenchResult_t & r(results[run.benchmark_name()]);
+            r.ns = run.GetAdjustedRealTime() * 1e9 /
+                benchmark::GetTimeUnitMultiplier(run.time_unit);
+            auto it = run.counters.find("allocs/cycle");
+            r.allocs = (it != run.counters.end()) ? it->second.value : 0;
+        }
+        ConsoleReporter::ReportRuns(runs);
+    }
+
+};
+
+static bool SaveBaseline(std::string const & path,
+        BenchResults_t const & results) {
+    std::ofstream out(path);
+    if (!out.is_open())
+        return false;
+    out << "# benchmark ns/cycle allocs/cycle\n";
+    for (auto const & r : results)
+        out << r.first << " " << r.second.ns << " " << r.second.allocs << "\n";
+    return out.good();
+}
+
+static bool LoadBaseline(std::string const & path, BenchResults_t & results) {
+    std::ifstream in(path);
+    if (!in.is_open())
+        return false;
+    std::string name;
+    BenchResult_t r;
+    while (in >> name) {
+        if (name[0] == '#') {
+            std::getline(in, name);
+            continue;
+        }
+        if (!(in >> r.ns >> r.allocs))
+            return false;
+        results[name] = r;
+    }
+    return true;
+}
+
+/**
+ * @return The number of regressions: slower than the tolerance, or more
+ * allocations
+ */
+static int CompareBaseline(BenchResults_t const & baseline,
+        BenchResults_t const & results, double tolerance) {
+    int regressions = 0;
+    printf("\n%-50s %12s %12s %8s %10s %10s\n", "Benchmark", "base ns",
+        "ns", "delta", "base alloc", "alloc");
+    for (auto const & r : results) {
+        auto it = baseline.find(r.first);
+        if (it == baseline.end()) {
+            printf("%-50s %12s %12.0f %8s %10s %10.1f\n", r.first.c_str(),
+                "-", r.second.ns, "new", "-", r.second.allocs);
+            continue;
+        }
+        BenchResult_t const & b(it->second);
+        double delta = b.ns > 0 ? 100.0 * (r.second.ns - b.ns) / b.ns : 0;
+        bool regression = delta > tolerance ||
+            r.second.allocs > b.allocs + 0.5;
+        printf("%-50s %12.0f %12.0f %+7.1f%% %10.1f %10.1f%s\n",
+            r.first.c_str(), b.ns, r.second.ns, delta, b.allocs,
+            r.second.allocs, regression ? "  REGRESSION" : "");
+        if (regression)
+            ++regressions;
+    }
+    return regressions;
+}
+
+int main(int argc, char * argv[]) {
+    std::string baseline_file;
+    std::string save_file;
+    double tolerance = BENCH_DEFAULT_TOLERANCE;
+
+    // Own options first, the others go to Google Benchmark
+    int nr_args = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg.compare(0, 16, "--acpu_baseline=") == 0)
+            baseline_file = arg.substr(16);
+        else if (arg.compare(0, 21, "--acpu_save_baseline=") == 0)
+            save_file = arg.substr(21);
+        else if (arg.compare(0, 17, "--acpu_tolerance=") == 0)
+            tolerance = std::strtod(arg.c_str() + 17, nullptr);
+        else
+            argv[nr_args++] = argv[i];
+    }
+    argc = nr_args;
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return EXIT_FAILURE;
+
+    BenchResults_t baseline;
+    if (!baseline_file.empty() && !LoadBaseline(baseline_file, baseline)) {
+        fprintf(stderr, "Cannot read the baseline [%s]\n",
+            baseline_file.c_str());
+        return EXIT_FAILURE;
+    }
+
+    BaselineReporter reporter;
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+
+    if (!save_file.empty() && !SaveBaseline(save_file, reporter.results)) {
+        fprintf(stderr, "Cannot write the baseline [%s]\n", save_file.c_str());
+        return EXIT_FAILURE;
+    }
+    if (!baseline_file.empty() &&
+            CompareBaseline(baseline, reporter.results, tolerance) > 0)
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_burst.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "adaptiveCPU_controller.h"
+#include "adaptiveCPU_groups.h"
+
+namespace bbque { namespace plugins {
+
+void ParseBurstClass(
+        std::string const & spec,
+        std::unordered_set<std::string> & members,
+        std::vector<std::string> & errors) {
+    std::istringstream entries(spec);
+    std::string entry;
+
+    members.clear();
+    while (std::getline(entries, entry, ';')) {
+        if (entry.empty())
+            continue;
+        bool app = entry.compare(0, sizeof(GROUP_APP_PREFIX) - 1,
+            GROUP_APP_PREFIX) == 0;
+        bool recipe = entry.compare(0, sizeof(GROUP_RECIPE_PREFIX) - 1,
+            GROUP_RECIPE_PREFIX) == 0;
+        if (!app && !recipe) {
+            errors.push_back(entry);
+            continue;
+        }
+        members.insert(entry);
+    }
+}
+
+bool InBurstClass(
+        BurstParams_t const & params,
+        std::string const & name,
+        std::string const & recipe) {
+    if (params.members.empty())
+        return false;
+    if (params.members.count(GROUP_APP_PREFIX + name))
+        return true;
+    return !recipe.empty() &&
+        params.members.count(GROUP_RECIPE_PREFIX + recipe);
+}
+
+void BurstReset(BurstState_t & bs) {
+    bs.credit = 0;
+    bs.borrowed = 0;
+}
+
+void BurstEarn(
+        BurstState_t & bs,
+        BurstParams_t const & params,
+        uint64_t quota,
+        uint64_t used) {
+    if (used + THRESHOLD >= quota)
+        return;
+    uint64_t earned = params.earn * (quota - used);
+    bs.credit = std::min(bs.credit + earned, params.max_credit);
+}
+
+uint64_t BurstDemand(
+        BurstState_t const & bs,
+        BurstParams_t const & params,
+        uint64_t quota,
+        uint64_t used,
+        uint64_t next_quota) {
+    uint64_t burst;
+    if (used + THRESHOLD >= quota) {
+        // Saturated: the burst grows
+        burst = bs.borrowed + params.step;
+    }
+    else {
+        // Paid back: only the usage the controller quota does not cover
+        burst = (used > next_quota) ?
+            std::min(used - next_quota, bs.borrowed) : 0;
+    }
+    return std::min(burst, bs.credit);
+}
+
+void BurstDraw(BurstState_t & bs, uint64_t burst) {
+    bs.credit -= std::min(burst, bs.credit);
+    bs.borrowed = burst;
+}
+
+} // namespace plugins
+
+} // namespace bbque
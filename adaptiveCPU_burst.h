@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_BURST_H_
+#define BBQUE_ADAPTIVE_CPU_BURST_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#define DEFAULT_BURST_EARN 1.0
+#define DEFAULT_BURST_MAX_CREDIT 2000
+#define DEFAULT_BURST_STEP 100
+
+/** Recipe plugin attribute putting an application in the latency class */
+#define BURST_RECIPE_NS "adaptive_cpu"
+#define BURST_RECIPE_KEY "latency_class"
+#define BURST_RECIPE_VALUE "burst"
+
+/*
+ * Burst credits of the latency-sensitive applications.
+ *
+ * A latency-class application idle for a while and then bursting waits
+ * several cycles for the PID controller to ramp its quota up by neg_delta
+ * steps. Instead, it earns credits while it uses less than its quota, and
+ * it spends them to draw quota from a node-wide reserve, carved out of the
+ * budget not booked, as soon as its usage saturates the quota.
+ *
+ * Credits are token-bucket like, in [%CPU * cycle]: the unused quota of
+ * each cycle is earned (times the earn rate), up to max_credit, and each
+ * cycle the burst quota is held costs as much. While saturated the burst
+ * grows by step each cycle. The controller keeps running on the quota
+ * without the burst, so that it ramps up meanwhile; once the usage is not
+ * saturated anymore, the burst is paid back down to the usage not covered
+ * by the controller quota.
+ */
+
+namespace bbque { namespace plugins {
+
+/** Burst credits parameters */
+struct BurstParams_t
+{
+    /** Node-wide reserve [%CPU] (0 = disabled) */
+    uint64_t reserve;
+    /** Latency class members: "app:<name>" or "recipe:<name>" */
+    std::string class_spec;
+    std::unordered_set<std::string> members;
+    /** Credits earned per unit of quota not used */
+    float earn;
+    /** Upper bound of the credits of an application */
+    uint64_t max_credit;
+    /** Burst growth per saturated cycle */
+    uint64_t step;
+};
+
+/** Burst credits of an application */
+struct BurstState_t
+{
+    uint64_t credit;
+    /** Burst quota drawn from the reserve in the last cycle */
+    uint64_t borrowed;
+};
+
+/**
+* @brief Parse the latency class members ("app:<name>;recipe:<name>")
+*
+* @param errors Filled with the invalid entries
+*/
+void ParseBurstClass(
+        std::string const & spec,
+        std::unordered_set<std::string> & members,
+        std::vector<std::string> & errors);
+
+/**
+* @brief The application is configured in the latency class
+*/
+bool InBurstClass(
+        BurstParams_t const & params,
+        std::string const & name,
+        std::string const & recipe);
+
+void BurstReset(BurstState_t & bs);
+
+/**
+* @brief Earn the credits of the last cycle
+*
+* @param quota The quota of the last cycle, without the burst
+* @param used The usage of the last cycle
+*/
+void BurstEarn(
+        BurstState_t & bs,
+        BurstParams_t const & params,
+        uint64_t quota,
+        uint64_t used);
+
+/**
+* @brief The burst quota to draw in this cycle
+*
+* @param quota The quota of the last cycle, burst included
+* @param used The usage of the last cycle
+* @param next_quota The quota assigned by the controller in this cycle
+*
+* @return The burst, bounded by the credits
+*/
+uint64_t BurstDemand(
+        BurstState_t const & bs,
+        BurstParams_t const & params,
+        uint64_t quota,
+        uint64_t used,
+        uint64_t next_quota);
+
+/**
+* @brief Account the burst quota drawn in this cycle
+*/
+void BurstDraw(BurstState_t & bs, uint64_t burst);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_BURST_H_
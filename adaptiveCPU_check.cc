@@ -0,0 +1,438 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks of the AdaptiveCPU building blocks the simulator cannot exercise.
+ *
+ * The readers of the kernel interfaces are checked over fake file trees,
+ * built in a temporary directory with the counters of successive readings:
+ * - throttling input (see ThrottleUpdate): the cpu.stat and cpu.pressure
+ *   files of a cgroup v2 directory, and the slack computed from them;
+ * - power capping input (see PowerMeter): the package zones of a powercap
+ *   tree, and the energy read from their counters.
+ *
+ * The batch control step kernels (see PIDBatch) supported by the CPU are
+ * checked against PIDStep on random inputs, including the saturation, the
+ * admissible range and the bounds of the 32-bit lanes.
+ *
+ * Each failed check is reported on the standard error, and the exit status
+ * is not zero if any check failed.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "adaptiveCPU_batch.h"
+#include "adaptiveCPU_controller.h"
+#include "adaptiveCPU_power.h"
+#include "adaptiveCPU_throttle.h"
+
+/** Wait between two readings [us]: the reading timestamps must differ */
+#define CHECK_READING_WAIT_US 1000
+/** A counter increment much longer than the wait between the readings */
+#define CHECK_LONG_USEC 3600000000ULL
+/** Applications of the batch check, and the chunk of each Run() */
+#define CHECK_BATCH_APPS 4099
+#define CHECK_BATCH_CHUNK 61
+/** Bound of the 32-bit lanes of the SIMD kernels */
+#define CHECK_LANE_LIMIT (1LL << 28)
+
+#define CHECK(cond) Check((cond), #cond, __LINE__)
+
+using namespace bbque::plugins;
+
+static uint32_t nr_checks = 0;
+static uint32_t nr_failures = 0;
+
+static void Check(bool ok, char const * what, int line) {
+    ++nr_checks;
+    if (ok)
+        return;
+    ++nr_failures;
+    fprintf(stderr, "line %d: check failed: %s\n", line, what);
+}
+
+static int RemoveEntry(char const * path, struct stat const *, int,
+        struct FTW *) {
+    return remove(path);
+}
+
+/**
+ * A temporary directory, removed with its content
+ */
+class TempTree {
+
+public:
+
+    TempTree() {
+        char const * tmp = getenv("TMPDIR");
+        std::string tmpl(tmp ? tmp : "/tmp");
+        tmpl += "/acpu-check-XXXXXX";
+        if (mkdtemp(&tmpl[0]) != nullptr)
+            root = tmpl;
+    }
+
+    ~TempTree() {
+        if (!root.empty())
+            nftw(root.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    inline bool Valid() const { return !root.empty(); }
+
+    inline std::string const & Root() const { return root; }
+
+    bool MakeDir(std::string const & rel) {
+        return mkdir((root + "/" + rel).c_str(), 0755) == 0;
+    }
+
+    bool Write(std::string const & rel, std::string const & text) {
+        std::ofstream out(root + "/" + rel);
+        out << text;
+        return static_cast<bool>(out);
+    }
+
+    void Remove(std::string const & rel) {
+        remove((root + "/" + rel).c_str());
+    }
+
+private:
+
+    std::string root;
+
+};
+
+/* Throttling input: cgroup v2 CPU controller files */
+
+static std::string CpuStat(
+        uint64_t nr_periods, uint64_t nr_throttled, uint64_t throttled_usec) {
+    return "usage_usec 1000000\nuser_usec 800000\nsystem_usec 200000\n"
+        "nr_periods " + std::to_string(nr_periods) + "\n"
+        "nr_throttled " + std::to_string(nr_throttled) + "\n"
+        "throttled_usec " + std::to_string(throttled_usec) + "\n";
+}
+
+static std::string CpuPressure(uint64_t some_usec, uint64_t full_usec) {
+    return "some avg10=0.00 avg60=0.00 avg300=0.00 total=" +
+        std::to_string(some_usec) + "\n"
+        "full avg10=0.00 avg60=0.00 avg300=0.00 total=" +
+        std::to_string(full_usec) + "\n";
+}
+
+static ThrottleSample_t Reading(
+        ThrottleState_t & ts, std::string const & cgroup) {
+    usleep(CHECK_READING_WAIT_US);
+    return ThrottleUpdate(ts, cgroup);
+}
+
+static void CheckThrottle(TempTree & tree) {
+    ThrottleParams_t params = {true, tree.Root(), "bbque/{id}",
+        DEFAULT_THROTTLE_GAIN, DEFAULT_THROTTLE_MAX_STALL,
+        DEFAULT_THROTTLE_MIN_STALL, DEFAULT_THROTTLE_MAX_STEP};
+    std::string cgroup(CgroupPath(params, "1:app:0", "app", 1, 1));
+    CHECK(cgroup == tree.Root() + "/bbque/1:app:0");
+    CHECK(tree.MakeDir("bbque") && tree.MakeDir("bbque/1:app:0"));
+
+    ThrottleState_t ts;
+    ThrottleReset(ts);
+
+    // No cgroup files: the slack is used as it is
+    ThrottleSample_t sample(Reading(ts, cgroup));
+    CHECK(!sample.valid && !ts.valid);
+    CHECK(ThrottleDelta(sample, params, DEFAULT_NEG_DELTA, 100) ==
+        DEFAULT_NEG_DELTA);
+
+    // First reading, cpu.pressure missing (PSI disabled)
+    CHECK(tree.Write("bbque/1:app:0/cpu.stat", CpuStat(100, 0, 0)));
+    sample = Reading(ts, cgroup);
+    CHECK(!sample.valid && ts.valid);
+    CHECK(ts.nr_periods == 100 && ts.stall_usec == 0);
+
+    // Saturated, neither throttled nor stalled: the quota fits
+    CHECK(tree.Write("bbque/1:app:0/cpu.stat", CpuStat(200, 0, 0)));
+    sample = Reading(ts, cgroup);
+    CHECK(sample.valid);
+    CHECK(sample.throttled_periods == 0 && sample.stall == 0);
+    CHECK(ThrottleDelta(sample, params, DEFAULT_NEG_DELTA, 100) ==
+        ADMISSIBLE_DELTA/2);
+
+    // Throttled in half the periods, for longer than the cycle: the stall
+    // is bounded, and so is the shortfall
+    CHECK(tree.Write("bbque/1:app:0/cpu.stat",
+        CpuStat(300, 50, CHECK_LONG_USEC)));
+    sample = Reading(ts, cgroup);
+    CHECK(sample.valid);
+    CHECK(std::fabs(sample.throttled_periods - 0.5) < 1e-6);
+    CHECK(sample.stall == 1);
+    CHECK(ThrottleDelta(sample, params, DEFAULT_NEG_DELTA, 100) ==
+        -DEFAULT_THROTTLE_MAX_STEP);
+    CHECK(ThrottleDelta(sample, params, DEFAULT_NEG_DELTA, 10) == -90);
+
+    // cpu.pressure appears: only the "some" line counts
+    CHECK(tree.Write("bbque/1:app:0/cpu.pressure", CpuPressure(0, 0)));
+    sample = Reading(ts, cgroup);
+    CHECK(sample.valid && sample.stall == 0);
+    CHECK(tree.Write("bbque/1:app:0/cpu.pressure",
+        CpuPressure(0, CHECK_LONG_USEC)));
+    sample = Reading(ts, cgroup);
+    CHECK(sample.valid && sample.stall == 0);
+    CHECK(ThrottleDelta(sample, params, DEFAULT_NEG_DELTA, 100) ==
+        ADMISSIBLE_DELTA/2);
+    CHECK(tree.Write("bbque/1:app:0/cpu.pressure",
+        CpuPressure(CHECK_LONG_USEC, CHECK_LONG_USEC)));
+    sample = Reading(ts, cgroup);
+    CHECK(sample.valid && sample.throttled_periods == 0);
+    CHECK(sample.stall == 1);
+    CHECK(ThrottleDelta(sample, params, DEFAULT_NEG_DELTA, 10) == -90);
+
+    // Counters reset (cgroup re-created): no sample, then valid again
+    CHECK(tree.Write("bbque/1:app:0/cpu.stat", CpuStat(10, 0, 0)));
+    CHECK(tree.Write("bbque/1:app:0/cpu.pressure", CpuPressure(0, 0)));
+    sample = Reading(ts, cgroup);
+    CHECK(!sample.valid && ts.valid);
+    CHECK(ts.nr_periods == 10 && ts.stall_usec == 0);
+    CHECK(tree.Write("bbque/1:app:0/cpu.stat", CpuStat(20, 0, 0)));
+    sample = Reading(ts, cgroup);
+    CHECK(sample.valid && sample.stall == 0);
+    CHECK(ThrottleDelta(sample, params, DEFAULT_NEG_DELTA, 100) ==
+        ADMISSIBLE_DELTA/2);
+
+    // cpu.stat gone (application exited): no sample, state not valid
+    tree.Remove("bbque/1:app:0/cpu.stat");
+    sample = Reading(ts, cgroup);
+    CHECK(!sample.valid && !ts.valid);
+}
+
+/* Power capping input: powercap tree */
+
+static bool PowerZone(TempTree & tree, std::string const & name,
+        uint64_t energy_uj, uint64_t max_range_uj) {
+    return tree.MakeDir("powercap/" + name) &&
+        tree.Write("powercap/" + name + "/energy_uj",
+            std::to_string(energy_uj) + "\n") &&
+        (max_range_uj == 0 ||
+            tree.Write("powercap/" + name + "/max_energy_range_uj",
+                std::to_string(max_range_uj) + "\n"));
+}
+
+static bool PowerEnergy(TempTree & tree, std::string const & name,
+        uint64_t energy_uj) {
+    return tree.Write("powercap/" + name + "/energy_uj",
+        std::to_string(energy_uj) + "\n");
+}
+
+static PowerSample_t Reading(PowerMeter & meter) {
+    usleep(CHECK_READING_WAIT_US);
+    return meter.Sample();
+}
+
+static void CheckPower(TempTree & tree) {
+    PowerMeter meter;
+    std::string root(tree.Root() + "/powercap");
+
+    // No powercap tree: no zones, no samples
+    CHECK(meter.Open(root) == 0);
+    CHECK(!Reading(meter).valid);
+
+    // Packages only: the sub-zones, the MMIO zones and the zones without
+    // a readable counter are left out
+    CHECK(tree.MakeDir("powercap"));
+    CHECK(PowerZone(tree, "intel-rapl:0", 1000000, 10000000));
+    CHECK(PowerZone(tree, "intel-rapl:1", 500, 0));
+    CHECK(PowerZone(tree, "intel-rapl:0:0", 1000000, 10000000));
+    CHECK(PowerZone(tree, "intel-rapl-mmio:0", 1000000, 10000000));
+    CHECK(tree.MakeDir("powercap/intel-rapl:2"));
+    CHECK(meter.Open(root) == 2);
+    CHECK(meter.Root() == root && meter.ZonesCount() == 2);
+
+    // First reading: no previous counters
+    PowerSample_t sample(Reading(meter));
+    CHECK(!sample.valid);
+
+    // The packages add up, the sub-zones (part of them) do not
+    CHECK(PowerEnergy(tree, "intel-rapl:0", 3000000));
+    CHECK(PowerEnergy(tree, "intel-rapl:1", 1000500));
+    CHECK(PowerEnergy(tree, "intel-rapl:0:0", 9000000));
+    sample = Reading(meter);
+    CHECK(sample.valid);
+    CHECK(std::fabs(sample.energy - 3.0) < 1e-9);
+    CHECK(sample.power > 0 && std::isfinite(sample.power));
+
+    // Wrap-around within max_energy_range_uj
+    CHECK(PowerEnergy(tree, "intel-rapl:0", 1000000));
+    sample = Reading(meter);
+    CHECK(sample.valid);
+    CHECK(std::fabs(sample.energy - 8.0) < 1e-9);
+
+    // Counter decreasing without a range: no sample, and none at the next
+    // reading either (no valid previous reading)
+    CHECK(PowerEnergy(tree, "intel-rapl:1", 0));
+    CHECK(!Reading(meter).valid);
+    CHECK(PowerEnergy(tree, "intel-rapl:1", 2000000));
+    CHECK(!Reading(meter).valid);
+    CHECK(PowerEnergy(tree, "intel-rapl:1", 2500000));
+    sample = Reading(meter);
+    CHECK(sample.valid);
+    CHECK(std::fabs(sample.energy - 0.5) < 1e-9);
+
+    // Counter not readable anymore
+    tree.Remove("powercap/intel-rapl:1/energy_uj");
+    CHECK(!Reading(meter).valid);
+
+    // Opened again: the first reading is not valid
+    CHECK(meter.Open(root) == 1);
+    CHECK(!Reading(meter).valid);
+    CHECK(PowerEnergy(tree, "intel-rapl:0", 2000000));
+    sample = Reading(meter);
+    CHECK(sample.valid);
+    CHECK(std::fabs(sample.energy - 1.0) < 1e-9);
+}
+
+/* Batch control step: SIMD and scalar kernels */
+
+/** Inputs of a control step */
+struct StepInput_t
+{
+    PIDParams_t params;
+    PIDState_t state;
+    uint64_t quota;
+    uint64_t used;
+    int64_t headroom;
+};
+
+static StepInput_t RandomInput(std::mt19937 & gen) {
+    std::uniform_int_distribution<int> kind(0, 5);
+    std::uniform_int_distribution<int64_t> small(-500, 500);
+    std::uniform_int_distribution<uint64_t> quota(0, 2000);
+    std::uniform_real_distribution<float> gain(0, 2);
+    StepInput_t in;
+    in.params = {-(small(gen) & 31), gain(gen), gain(gen), gain(gen)};
+    in.state = {small(gen) * 10, small(gen)};
+    in.quota = quota(gen);
+    in.used = std::uniform_int_distribution<uint64_t>(0, in.quota)(gen);
+    in.headroom = small(gen) / 10;
+
+    switch (kind(gen)) {
+    case 1:
+        // Saturated, or just below the saturation threshold
+        in.used = in.quota + 1 - (gen() % 4);
+        break;
+    case 2: {
+        // Error at the bounds of the admissible range
+        int64_t delta = 2 + gen() % 100;
+        int64_t error = ADMISSIBLE_DELTA/2 - 1 + gen() % 2;
+        if (gen() % 2)
+            error = -error;
+        in.used = in.quota - std::min<uint64_t>(delta, in.quota);
+        delta = in.quota - in.used;
+        if (delta <= THRESHOLD)
+            break;
+        in.headroom = error - ADMISSIBLE_DELTA/2 + delta;
+        break;
+    }
+    case 3: {
+        // Operands at the bounds of the 32-bit lanes
+        int64_t bound = CHECK_LANE_LIMIT - 1 + gen() % 3;
+        switch (gen() % 4) {
+        case 0: in.quota = bound; break;
+        case 1: in.state.ierr = (gen() % 2) ? bound : -bound; break;
+        case 2: in.state.derr = (gen() % 2) ? bound : -bound; break;
+        case 3: in.headroom = (gen() % 2) ? bound : -bound; break;
+        }
+        break;
+    }
+    case 4:
+        // Products at the bound of the 32-bit lanes
+        in.state.ierr = CHECK_LANE_LIMIT - 1 - (gen() % 1000);
+        in.params.ki = 7.5f + gain(gen) / 2;
+        break;
+    case 5:
+        // 64-bit values
+        in.quota = (1ULL << 40) + quota(gen);
+        in.used = quota(gen);
+        in.state.ierr = -(1LL << 36);
+        break;
+    }
+    return in;
+}
+
+static bool SameOutput(PIDOutput_t const & a, PIDOutput_t const & b) {
+    return a.delta == b.delta && a.error == b.error && a.pvar == b.pvar &&
+        a.ivar == b.ivar && a.dvar == b.dvar && a.cv == b.cv &&
+        a.state.ierr == b.state.ierr && a.state.derr == b.state.derr;
+}
+
+static void CheckBatch() {
+    std::mt19937 gen(1);
+    std::vector<StepInput_t> inputs(CHECK_BATCH_APPS);
+    for (auto & in : inputs)
+        in = RandomInput(gen);
+
+    PIDBatch::Kernel_t const kernels[] = {PIDBatch::KERNEL_SCALAR,
+        PIDBatch::KERNEL_SSE, PIDBatch::KERNEL_AVX2};
+    for (PIDBatch::Kernel_t kernel : kernels) {
+        PIDBatch batch;
+        // Not supported by the CPU
+        if (batch.SetKernel(kernel) != kernel)
+            continue;
+        batch.Resize(inputs.size());
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            StepInput_t const & in(inputs[i]);
+            batch.Set(i, in.params, in.state, in.quota, in.used,
+                in.headroom);
+        }
+        // Chunks not aligned to the SIMD blocks, as on the worker pool
+        for (size_t i = 0; i < inputs.size(); i += CHECK_BATCH_CHUNK)
+            batch.Run(i, std::min(inputs.size(), i + CHECK_BATCH_CHUNK));
+
+        uint32_t mismatches = 0;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            StepInput_t const & in(inputs[i]);
+            PIDOutput_t out(PIDStep(in.params, in.state, in.quota, in.used,
+                in.headroom));
+            if (!SameOutput(batch.Output(i), out))
+                ++mismatches;
+        }
+        if (mismatches > 0)
+            fprintf(stderr, "batch kernel %s: %u mismatches\n",
+                PIDBatch::KernelName(kernel), mismatches);
+        CHECK(mismatches == 0);
+    }
+}
+
+int main() {
+    TempTree tree;
+    if (!tree.Valid()) {
+        fprintf(stderr, "Cannot create a temporary directory\n");
+        return EXIT_FAILURE;
+    }
+
+    CheckThrottle(tree);
+    CheckPower(tree);
+    CheckBatch();
+
+    printf("checks: %u, failures: %u\n", nr_checks, nr_failures);
+    return (nr_failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_controller.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace bbque { namespace plugins {
+
+uint64_t InitialQuota(uint64_t quota_not_run_apps) {
+    if (quota_not_run_apps < INITIAL_DEFAULT_QUOTA)
+        return quota_not_run_apps;
+    return INITIAL_DEFAULT_QUOTA;
+}
+
+PIDOutput_t PIDStep(
+        PIDParams_t const & params,
+        PIDState_t const & state,
+        uint64_t prev_quota,
+        uint64_t prev_used,
+        int64_t headroom) {
+    PIDOutput_t out;
+
+    out.delta = static_cast<int64_t>(prev_quota) -
+        static_cast<int64_t>(prev_used);
+
+    //if cpu_usage==quota we push a forfait delta
+    if (static_cast<int64_t>(prev_used) >=
+            static_cast<int64_t>(prev_quota) - THRESHOLD)
+        out.delta = params.neg_delta;
+
+    //PROPORTIONAL CONTROLLER:
+    out.error = ADMISSIBLE_DELTA/2 + headroom - out.delta;
+
+    //we are in the admissible range
+    if (std::llabs(out.error) < ADMISSIBLE_DELTA/2)
+        out.error = 0;
+
+    out.pvar = params.kp * out.error;
+
+    //INTEGRAL CONTROLLER
+    out.state.ierr = state.ierr + out.error;
+    out.ivar = params.ki * out.state.ierr;
+
+    //DERIVATIVE CONTROLLER
+    out.dvar = params.kd * (out.error - state.derr);
+    out.state.derr = out.error;
+
+    //Compute control variable
+    out.ffvar = 0;
+    out.cv = out.pvar + out.ivar + out.dvar;
+
+    return out;
+}
+
+PIDOutput_t GoalGapStep(
+        PIDParams_t const & params,
+        PIDState_t const & state,
+        PIDState_t & ggap_state,
+        uint64_t prev_quota,
+        uint64_t prev_used,
+        int32_t ggap_percent,
+        bool valid,
+        int32_t deadband,
+        int64_t headroom) {
+    PIDOutput_t out = PIDStep(params, state, prev_quota, prev_used, headroom);
+    GoalGapAdjust(params, ggap_state, out, prev_quota, ggap_percent, valid,
+        deadband);
+    return out;
+}
+
+void GoalGapAdjust(
+        PIDParams_t const & params,
+        PIDState_t & ggap_state,
+        PIDOutput_t & out,
+        uint64_t prev_quota,
+        int32_t ggap_percent,
+        bool valid,
+        int32_t deadband) {
+    if (!valid)
+        return;
+
+    // Goal met: only give back the unused quota
+    if (std::abs(ggap_percent) <= deadband) {
+        ggap_state = {0, 0};
+        out.cv = std::min<int64_t>(out.cv, 0);
+        return;
+    }
+
+    int64_t error = static_cast<int64_t>(prev_quota) * ggap_percent / 100;
+    int64_t pvar = params.kp * error;
+    int64_t ierr = ggap_state.ierr + error;
+    int64_t ivar = params.ki * ierr;
+    int64_t dvar = params.kd * (error - ggap_state.derr);
+    int64_t cv = pvar + ivar + dvar;
+    ggap_state = {ierr, error};
+
+    out.error = error;
+    out.pvar = pvar;
+    out.ivar = ivar;
+    out.dvar = dvar;
+    out.cv = (ggap_percent > 0) ? std::max(cv, out.cv) : std::min(cv, out.cv);
+}
+
+bool ApplyControl(
+        uint64_t prev_quota,
+        int64_t cv,
+        uint64_t & available_cpu,
+        uint64_t & next_quota) {
+
+    //check available cpu
+    if (cv > 0) {
+        uint64_t inc = static_cast<uint64_t>(cv);
+        if (inc > available_cpu)
+            inc = available_cpu;
+        next_quota = prev_quota + inc;
+        available_cpu -= inc;
+        return false;
+    }
+
+    uint64_t dec = static_cast<uint64_t>(-cv);
+    if (dec <= prev_quota) {
+        next_quota = prev_quota - dec;
+        available_cpu += dec;
+        return false;
+    }
+
+    //reset in case of fault: the previous quota is given back first
+    available_cpu += prev_quota;
+    next_quota = (available_cpu > INITIAL_DEFAULT_QUOTA) ?
+        INITIAL_DEFAULT_QUOTA : available_cpu;
+    available_cpu -= next_quota;
+    return true;
+}
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_CONTROLLER_H_
+#define BBQUE_ADAPTIVE_CPU_CONTROLLER_H_
+
+#include <cstdint>
+
+#define INITIAL_DEFAULT_QUOTA 150
+#define MIN_ASSIGNABLE_QUOTA 10
+#define ADMISSIBLE_DELTA 10
+#define THRESHOLD 1
+
+#define DEFAULT_NEG_DELTA -5
+#define DEFAULT_KP 0.6
+#define DEFAULT_KI 0.3
+#define DEFAULT_KD 0.1
+
+/** Goal gap [%] considered as goal met */
+#define DEFAULT_GGAP_DEADBAND 5
+
+/*
+ * The control law is kept free of any BarbequeRTRM type, so that the very
+ * same code can be driven by the policy and by the offline tools
+ * (e.g., the trace-replay simulator).
+ */
+
+namespace bbque { namespace plugins {
+
+/** Primary error signal of the controller */
+typedef enum ControlMode {
+    /** CPU slack (quota - usage) */
+    CONTROL_SLACK = 0,
+    /** Application goal gap, with the CPU slack as secondary constraint */
+    CONTROL_GGAP
+} ControlMode_t;
+
+/** Parameters of the CPU quota controller */
+struct PIDParams_t
+{
+    int64_t neg_delta;
+    float kp;
+    float ki;
+    float kd;
+};
+
+/** Per-application memory of the controller */
+struct PIDState_t
+{
+    int64_t ierr;
+    int64_t derr;
+};
+
+/** Outcome of a single controller step */
+struct PIDOutput_t
+{
+    /** Observed slack (quota - usage), or neg_delta if saturated */
+    int64_t delta;
+    int64_t error;
+    int64_t pvar;
+    int64_t ivar;
+    int64_t dvar;
+    /** Feed-forward action (predictive mode) */
+    int64_t ffvar;
+    /** Control variable, i.e. the requested quota variation */
+    int64_t cv;
+    /** Controller memory to keep for the next step */
+    PIDState_t state;
+};
+
+/**
+ * @brief Quota assigned to an application entering the scheduling
+ *
+ * @param quota_not_run_apps The fair share of the available CPU among the
+ * not running applications
+ */
+uint64_t InitialQuota(uint64_t quota_not_run_apps);
+
+/**
+ * @brief Compute the PID control step of an application
+ *
+ * @param params Controller parameters
+ * @param state Controller memory of the application
+ * @param prev_quota CPU quota assigned in the previous cycle
+ * @param prev_used CPU usage observed in the previous cycle
+ * @param headroom Slack to keep in addition to the admissible one
+ */
+PIDOutput_t PIDStep(
+        PIDParams_t const & params,
+        PIDState_t const & state,
+        uint64_t prev_quota,
+        uint64_t prev_used,
+        int64_t headroom = 0);
+
+/**
+ * @brief Compute the goal gap control step of an application
+ *
+ * The goal gap (positive if the application is missing its goal) is turned
+ * into a quota error proportional to the previous quota, and regulated by
+ * a PID with its own memory. The slack control step acts as a constraint:
+ * - goal missed: the quota grows by the largest of the two actions, even if
+ *   the application is not saturating its quota;
+ * - goal exceeded: the quota shrinks by the largest of the two actions;
+ * - goal met (within the dead band): only the unused quota is released.
+ * Invalid goal gap samples are ignored, and the slack control is used.
+ *
+ * @param params Controller parameters
+ * @param state Slack controller memory of the application
+ * @param ggap_state Goal gap controller memory of the application (updated)
+ * @param prev_quota CPU quota assigned in the previous cycle
+ * @param prev_used CPU usage observed in the previous cycle
+ * @param ggap_percent Goal gap reported by the application
+ * @param valid The goal gap sample is valid
+ * @param deadband Goal gap considered as goal met
+ * @param headroom Slack to keep in addition to the admissible one
+ */
+PIDOutput_t GoalGapStep(
+        PIDParams_t const & params,
+        PIDState_t const & state,
+        PIDState_t & ggap_state,
+        uint64_t prev_quota,
+        uint64_t prev_used,
+        int32_t ggap_percent,
+        bool valid,
+        int32_t deadband,
+        int64_t headroom = 0);
+
+/**
+ * @brief Apply the goal gap control to the outcome of a slack control step
+ *
+ * GoalGapStep is PIDStep followed by this function: it allows to compute
+ * the slack control steps in batch (see PIDBatch).
+ *
+ * @param params Controller parameters
+ * @param ggap_state Goal gap controller memory of the application (updated)
+ * @param out The slack control step outcome (updated)
+ * @param prev_quota CPU quota assigned in the previous cycle
+ * @param ggap_percent Goal gap reported by the application
+ * @param valid The goal gap sample is valid
+ * @param deadband Goal gap considered as goal met
+ */
+void GoalGapAdjust(
+        PIDParams_t const & params,
+        PIDState_t & ggap_state,
+        PIDOutput_t & out,
+        uint64_t prev_quota,
+        int32_t ggap_percent,
+        bool valid,
+        int32_t deadband);
+
+/**
+ * @brief Apply a control variable to the previous quota
+ *
+ * The available CPU budget is updated accordingly. Positive variations are
+ * clamped to the available budget.
+ *
+ * @param prev_quota CPU quota assigned in the previous cycle
+ * @param cv The control variable
+ * @param available_cpu The available CPU budget (updated)
+ * @param next_quota The resulting quota
+ *
+ * @return true if the quota has been reset to INITIAL_DEFAULT_QUOTA, since
+ * the control variable required a negative quota
+ */
+bool ApplyControl(
+        uint64_t prev_quota,
+        int64_t cv,
+        uint64_t & available_cpu,
+        uint64_t & next_quota);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_CONTROLLER_H_
@@ -0,0 +1,663 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_cycle.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace bbque { namespace plugins {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double ElapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+        Clock::now() - start).count();
+}
+
+} // namespace
+
+ControlInput_t LawInput(CycleApp_t const & app, PIDParams_t const & params) {
+    ProfileSample_t const & sample(app.state->last_sample);
+    return {app.uid, app.prev_quota, app.prev_used, sample.ggap_percent,
+        sample.is_valid, params};
+}
+
+uint64_t OvercommitBookings(
+        std::vector<CycleApp_t *> const & apps, uint64_t capacity) {
+    uint64_t assigned = 0;
+    for (CycleApp_t const * app : apps) {
+        if (!app->skip)
+            assigned += app->next_quota;
+    }
+
+    for (CycleApp_t * app : apps) {
+        app->booked = app->next_quota;
+        if (assigned > capacity)
+            app->booked = app->next_quota * capacity / assigned;
+    }
+    return assigned;
+}
+
+CycleEngine::CycleEngine():
+        cfg(nullptr),
+        active_law(nullptr),
+        cycle(0),
+        available_cpu(0),
+        capacity(0),
+        period_ms(0),
+        power_cap(0),
+        burst_pool(0),
+        stats() {
+}
+
+void CycleEngine::Begin(
+        PolicyParams_t const & params,
+        uint32_t _cycle,
+        uint64_t available,
+        uint64_t _capacity,
+        double _period_ms) {
+    cfg = &params;
+    cycle = _cycle;
+    available_cpu = available;
+    capacity = _capacity;
+    period_ms = _period_ms;
+    burst_pool = 0;
+    stats = CycleStats_t();
+}
+
+void CycleEngine::Collect(CycleApp_t & app) {
+    app.pid_in = app.state->pid;
+    app.ggap_in = app.state->ggap_pid;
+    app.reconf_in = app.state->reconf;
+
+    // Burst quota given back to the reserve: the controller runs without it
+    BurstState_t & bs(app.state->burst);
+    if (!app.latency)
+        bs.borrowed = 0;
+    app.burst_in = bs;
+    if (app.running && bs.borrowed > 0) {
+        app.prev_burst = std::min(bs.borrowed, app.prev_quota);
+        app.prev_quota -= app.prev_burst;
+        app.prev_delta = app.prev_quota - app.prev_used;
+        available_cpu += app.prev_burst;
+    }
+}
+
+void CycleEngine::Control(std::vector<CycleApp_t *> const & apps) {
+    if (active_law) {
+        ComputeLawActions(apps);
+        return;
+    }
+
+    if (cfg->batch)
+        batch.Resize(apps.size());
+
+    // Pure controller math: each item only reads its own inputs and state,
+    // and writes its own control action
+    workers.ParallelFor(apps.size(), cfg->parallel_chunk,
+        [this, &apps](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                CycleApp_t & app(*apps[i]);
+                if (!app.running)
+                    continue;
+                PIDParams_t params(*app.gains);
+                if (cfg->autotune) {
+                    TunerState_t & ts(app.state->tuner);
+                    TunerObserve(ts,
+                        static_cast<int64_t>(app.prev_quota) -
+                            static_cast<int64_t>(app.prev_used),
+                        app.prev_used);
+                    TunerGains(ts, *app.gains, cfg->tuner_bounds, params);
+                }
+                // Measured throttling: saturated quota slack
+                if (cfg->throttle.enabled) {
+                    app.throttle = ThrottleUpdate(app.state->throttle,
+                        app.cgroup);
+                    params.neg_delta = ThrottleDelta(app.throttle,
+                        cfg->throttle, params.neg_delta, app.prev_used);
+                }
+                // Predictive mode: slack headroom and feed-forward action
+                ForecastOutput_t fo = {false, 0, 0, 0, 0};
+                if (cfg->forecast.method != FORECAST_NONE)
+                    fo = ForecastStep(app.state->forecast, cfg->forecast,
+                        app.prev_quota, app.prev_used);
+                if (cfg->batch) {
+                    // The slack control step of the chunk is computed below
+                    batch.Set(i, params, app.state->pid,
+                        app.prev_quota, app.prev_used, fo.headroom);
+                    app.ctrl.ffvar = fo.ff;
+                    continue;
+                }
+                CompleteControlAction(app, params,
+                    PIDStep(params, app.state->pid,
+                        app.prev_quota, app.prev_used, fo.headroom),
+                    fo.ff);
+            }
+            if (!cfg->batch)
+                return;
+
+            batch.Run(begin, end);
+            for (size_t i = begin; i < end; ++i) {
+                CycleApp_t & app(*apps[i]);
+                if (!app.running)
+                    continue;
+                PIDParams_t params = {batch.neg_delta[i],
+                    batch.kp[i], batch.ki[i], batch.kd[i]};
+                CompleteControlAction(app, params, batch.Output(i),
+                    app.ctrl.ffvar);
+            }
+        });
+}
+
+void CycleEngine::CompleteControlAction(
+        CycleApp_t & app,
+        PIDParams_t const & params,
+        PIDOutput_t const & out,
+        int64_t ff) {
+    app.params = params;
+    app.ctrl = out;
+    if (cfg->control_mode == CONTROL_GGAP) {
+        ProfileSample_t const & sample(app.state->last_sample);
+        GoalGapAdjust(params, app.state->ggap_pid, app.ctrl,
+            app.prev_quota, sample.ggap_percent, sample.is_valid,
+            cfg->ggap_deadband);
+    }
+    app.ctrl.ffvar = ff;
+    app.ctrl.cv += ff;
+    app.demand = app.ctrl.cv;
+    app.grant = app.demand;
+}
+
+void CycleEngine::ComputeLawActions(std::vector<CycleApp_t *> const & apps) {
+    for (CycleApp_t * app : apps) {
+        if (!app->running)
+            continue;
+        app->params = *app->gains;
+        app->ctrl = active_law->Step(LawInput(*app, app->params), cycle);
+        app->demand = app->ctrl.cv;
+        app->grant = app->demand;
+    }
+    // Applications not running anymore: memory dropped
+    active_law->Purge(cycle);
+}
+
+void CycleEngine::Reconcile(
+        std::vector<CycleApp_t *> const & apps,
+        PowerSample_t const & power) {
+    // Applications visited group by group
+    order.assign(apps.begin(), apps.end());
+    if (!cfg->groups.groups.empty())
+        std::stable_sort(order.begin(), order.end(),
+            [](CycleApp_t const * a, CycleApp_t const * b) {
+                return a->group < b->group;
+            });
+
+    if (cfg->overcommit.enabled)
+        SizeOvercommit();
+    if (cfg->power.budget > 0)
+        LimitPower(power);
+    if (cfg->burst.reserve > 0)
+        CarveBurstReserve();
+    if (!cfg->groups.groups.empty())
+        ReconcileGroups();
+    else if (cfg->fair_allocation)
+        ReconcileFair(0, order.size());
+    else
+        ReconcileGreedy(0, order.size());
+    if (cfg->overcommit.enabled)
+        ReclaimOvercommit();
+    if (cfg->power.budget > 0)
+        ReclaimPower();
+    if (cfg->burst.reserve > 0)
+        GrantBursts();
+}
+
+void CycleEngine::ComputeQuota(CycleApp_t & app) {
+    if (!app.running) {
+        app.next_quota = app.share;
+
+        //Set initial integral and derivative errors
+        app.state->pid = {0, 0};
+        app.state->ggap_pid = {0, 0};
+        TunerReset(app.state->tuner);
+        ForecastReset(app.state->forecast);
+        ThrottleReset(app.state->throttle);
+        ReconfReset(app.state->reconf);
+        UsageReset(app.state->usage);
+        BurstReset(app.state->burst);
+        app.state->last_quota = app.next_quota;
+        app.state->last_error = 0;
+        app.state->last_cv = 0;
+
+        available_cpu -= app.next_quota;
+        return;
+    }
+
+    PIDOutput_t & out(app.ctrl);
+    app.prev_delta = out.delta;
+    admission.RecordUsage(app.uid, app.prev_used);
+
+    //update quota and available cpu
+    app.reset = ApplyControl(app.prev_quota, app.grant,
+        available_cpu, app.next_quota);
+
+    // Reconfiguration cost: the change is held until worth it
+    if (cfg->hysteresis.enabled && !app.reset) {
+        int64_t change = static_cast<int64_t>(app.next_quota) -
+            static_cast<int64_t>(app.prev_quota);
+        if (HysteresisFilter(app.state->reconf, cfg->hysteresis,
+                change, period_ms) != change) {
+            available_cpu += change;
+            app.next_quota = app.prev_quota;
+            app.held = true;
+        }
+    }
+
+    if (cfg->autotune) {
+        int64_t applied = static_cast<int64_t>(app.next_quota) -
+            static_cast<int64_t>(app.prev_quota);
+        // Anti-windup: do not integrate while the quota is saturated
+        if (applied != app.demand)
+            out.state.ierr = app.state->pid.ierr;
+        int64_t ierr_limit = cfg->ierr_limit;
+        if (ierr_limit > 0)
+            out.state.ierr = std::max(-ierr_limit,
+                std::min(out.state.ierr, ierr_limit));
+        app.state->tuner.last_u = applied;
+    }
+
+    //Update errors and expected delta: a reset starts the controller over,
+    //as for a new application, not to wind up again to a negative quota
+    app.state->pid = out.state;
+    if (app.reset) {
+        app.state->pid = {0, 0};
+        app.state->ggap_pid = {0, 0};
+    }
+    app.state->last_quota = app.next_quota;
+    app.state->last_error = out.error;
+    app.state->last_cv = out.cv;
+}
+
+void CycleEngine::ReconcileGreedy(size_t begin, size_t end) {
+    // Applications visiting order: running first, then the not running
+    // ones sharing what remains
+    Clock::time_point start = Clock::now();
+    uint64_t reserve = 0;
+    if (cfg->admission_queue) {
+        reserve = std::min(AdmissionReserve(begin, end), available_cpu);
+        available_cpu -= reserve;
+    }
+    uint32_t not_run = 0;
+    for (size_t i = begin; i < end; ++i) {
+        if (order[i]->running)
+            ComputeQuota(*order[i]);
+        else
+            ++not_run;
+    }
+    available_cpu += reserve;
+    stats.run_pass_ms += ElapsedMs(start);
+    start = Clock::now();
+
+    if (cfg->admission_queue) {
+        // The running applications hold the quota of the waiting ones
+        uint64_t min_quota = AdmissionReserve(begin, end);
+        if (available_cpu < min_quota)
+            available_cpu += ReclaimQuota(begin, end,
+                min_quota - available_cpu);
+        AdmitApplications(begin, end);
+        stats.not_run_pass_ms += ElapsedMs(start);
+        return;
+    }
+
+    //Fair alternative among not running applications
+    uint64_t quota_not_run_apps = 0;
+    if (not_run != 0)
+        quota_not_run_apps = available_cpu / not_run;
+
+    for (size_t i = begin; i < end; ++i) {
+        CycleApp_t & app(*order[i]);
+        if (app.running)
+            continue;
+        if (quota_not_run_apps == 0) {
+            app.skip = true;
+            continue;
+        }
+        app.share = InitialQuota(quota_not_run_apps);
+        ComputeQuota(app);
+    }
+    stats.not_run_pass_ms += ElapsedMs(start);
+}
+
+uint64_t CycleEngine::AdmissionReserve(size_t begin, size_t end) {
+    candidates.clear();
+    for (size_t i = begin; i < end; ++i) {
+        CycleApp_t const & app(*order[i]);
+        if (!app.running)
+            candidates.push_back({app.uid, app.priority});
+    }
+    return admission.Reserve(candidates, cfg->admission, begin == 0);
+}
+
+void CycleEngine::AdmitApplications(size_t begin, size_t end) {
+    candidates.clear();
+    selected.clear();
+    for (size_t i = begin; i < end; ++i) {
+        CycleApp_t & app(*order[i]);
+        if (app.running)
+            continue;
+        candidates.push_back({app.uid, app.priority});
+        selected.push_back(&app);
+    }
+
+    // The groups are admitted in turn, the first one starting the cycle
+    admission.Admit(candidates, cfg->admission, available_cpu, grants,
+        begin == 0);
+
+    for (size_t i = 0; i < selected.size(); ++i) {
+        CycleApp_t & app(*selected[i]);
+        if (grants[i] == 0) {
+            app.skip = true;
+            continue;
+        }
+        app.share = grants[i];
+        ComputeQuota(app);
+    }
+}
+
+void CycleEngine::ReconcileFair(size_t begin, size_t end) {
+    double not_run_ms = 0;
+    Clock::time_point start = Clock::now();
+
+    // Quota decreases first: they return budget to the pool
+    demands.clear();
+    selected.clear();
+    for (size_t i = begin; i < end; ++i) {
+        CycleApp_t & app(*order[i]);
+        if (app.running && app.ctrl.cv <= 0) {
+            ComputeQuota(app);
+            continue;
+        }
+        Demand_t d;
+        d.weight = app.weight;
+        if (app.running) {
+            d.base = app.prev_quota;
+            d.request = app.ctrl.cv;
+            d.floor = 0;
+        }
+        else {
+            d.base = 0;
+            d.request = INITIAL_DEFAULT_QUOTA;
+            d.floor = MIN_ASSIGNABLE_QUOTA;
+        }
+        demands.push_back(d);
+        selected.push_back(&app);
+    }
+
+    // Max-min fair division of what is available
+    WaterFill(demands, available_cpu, grants);
+
+    for (size_t i = 0; i < selected.size(); ++i) {
+        CycleApp_t & app(*selected[i]);
+        if (app.running) {
+            app.grant = grants[i];
+            ComputeQuota(app);
+            continue;
+        }
+        Clock::time_point app_start = Clock::now();
+        if (grants[i] == 0) {
+            app.skip = true;
+        }
+        else {
+            app.share = grants[i];
+            ComputeQuota(app);
+        }
+        not_run_ms += ElapsedMs(app_start);
+    }
+
+    // The water-filling serves both: accounted to the running applications
+    stats.run_pass_ms += ElapsedMs(start) - not_run_ms;
+    stats.not_run_pass_ms += not_run_ms;
+}
+
+void CycleEngine::ReconcileGroups() {
+    auto const & specs(cfg->groups.groups);
+    group_demands.assign(specs.size(), {0, 0});
+
+    // Level 1: the capacity includes the quotas held by the applications
+    uint64_t group_capacity = available_cpu;
+    for (CycleApp_t const * app : order) {
+        GroupDemand_t & demand(group_demands[app->group]);
+        if (app->running) {
+            demand.held += app->prev_quota;
+            demand.request += app->ctrl.cv;
+            group_capacity += app->prev_quota;
+        }
+        else {
+            demand.request += INITIAL_DEFAULT_QUOTA;
+        }
+    }
+    GroupBudgets(specs, group_demands, group_capacity, group_budgets);
+
+    // Level 2: each group visited within its budget. The budget not booked
+    // can be transiently negative: a group can be granted the quota that
+    // another one is giving back later in the loop.
+    groups.assign(specs.size(), {0, 0, 0, 0, 0});
+    int64_t pool = available_cpu;
+    size_t begin = 0;
+    for (size_t g = 0; g < specs.size(); ++g) {
+        size_t end = begin;
+        while (end < order.size() && order[end]->group == g)
+            ++end;
+        if (begin == end)
+            continue;
+
+        uint64_t budget = group_budgets[g].budget;
+        uint64_t held = group_demands[g].held;
+        available_cpu = (budget > held) ? budget - held : 0;
+        if (cfg->fair_allocation)
+            ReconcileFair(begin, end);
+        else
+            ReconcileGreedy(begin, end);
+
+        uint64_t assigned = 0;
+        for (size_t i = begin; i < end; ++i)
+            assigned += order[i]->next_quota;
+        // Budget lent in the previous cycles and now claimed back
+        if (assigned > budget)
+            assigned -= ReclaimQuota(begin, end, assigned - budget);
+        pool += static_cast<int64_t>(held) - static_cast<int64_t>(assigned);
+
+        groups[g] = {static_cast<uint32_t>(end - begin), held, budget,
+            group_budgets[g].borrowed, assigned};
+        begin = end;
+    }
+    available_cpu = (pool > 0) ? pool : 0;
+}
+
+uint64_t CycleEngine::ReclaimQuota(size_t begin, size_t end, uint64_t amount) {
+    reclaims.clear();
+    selected.clear();
+    for (size_t i = begin; i < end; ++i) {
+        CycleApp_t & app(*order[i]);
+        if (!app.running || app.skip)
+            continue;
+        reclaims.push_back({app.priority, app.next_quota,
+            MIN_ASSIGNABLE_QUOTA});
+        selected.push_back(&app);
+    }
+
+    uint64_t reclaimed = Reclaim(reclaims, amount, grants);
+    for (size_t i = 0; i < selected.size(); ++i) {
+        CycleApp_t & app(*selected[i]);
+        app.next_quota -= grants[i];
+        app.reclaimed += grants[i];
+        app.state->last_quota = app.next_quota;
+    }
+    stats.not_reclaimed += amount - reclaimed;
+    return reclaimed;
+}
+
+void CycleEngine::SizeOvercommit() {
+    usage_demands.clear();
+    for (CycleApp_t * app : order) {
+        if (!app->running)
+            continue;
+        UsageHistory_t & uh(app->state->usage);
+        UsageObserve(uh, app->prev_used);
+        usage_demands.push_back(
+            UsageDemand(uh, cfg->overcommit.risk, app->prev_quota));
+        stats.used += app->prev_used;
+    }
+
+    if (capacity == 0)
+        return;
+    OvercommitBudget_t & budget(stats.overcommit);
+    budget = OvercommitBudget(usage_demands, capacity, cfg->overcommit);
+    stats.overcommit_pressure =
+        (stats.used >= cfg->overcommit.reclaim * capacity);
+    if (stats.overcommit_pressure)
+        budget.limit = capacity;
+
+    // The quotas held can already exceed the capacity
+    available_cpu = (budget.limit > budget.quota) ?
+        budget.limit - budget.quota : 0;
+}
+
+void CycleEngine::ReclaimOvercommit() {
+    if (!stats.overcommit_pressure)
+        return;
+
+    uint64_t assigned = 0;
+    for (CycleApp_t const * app : order) {
+        if (!app->skip)
+            assigned += app->next_quota;
+    }
+    if (assigned <= capacity)
+        return;
+
+    stats.overcommit_excess = assigned - capacity;
+    available_cpu += ReclaimQuota(0, order.size(), stats.overcommit_excess);
+}
+
+void CycleEngine::LimitPower(PowerSample_t const & power) {
+    if (power_cap == 0)
+        power_cap = capacity;
+
+    uint64_t used = 0;
+    uint64_t held = 0;
+    for (CycleApp_t const * app : order) {
+        if (!app->running)
+            continue;
+        used += app->prev_used;
+        held += app->prev_quota;
+    }
+
+    // Not valid at the first reading: the cap of the last cycle is kept
+    if (power.valid) {
+        power_cap = PowerCap(power_cap, capacity, cfg->power, power.power);
+        for (CycleApp_t * app : order) {
+            if (app->running && used > 0)
+                app->energy = power.energy * app->prev_used / used;
+        }
+    }
+    power_cap = std::min(power_cap, capacity);
+
+    uint64_t cap_available = (power_cap > held) ? power_cap - held : 0;
+    available_cpu = std::min(available_cpu, cap_available);
+    stats.power_held = held;
+}
+
+void CycleEngine::ReclaimPower() {
+    power_apps.clear();
+    selected.clear();
+    uint64_t assigned = 0;
+    for (CycleApp_t * app : order) {
+        if (app->skip)
+            continue;
+        assigned += app->next_quota;
+        if (!app->running)
+            continue;
+        ProfileSample_t const & sample(app->state->last_sample);
+        power_apps.push_back({app->priority, app->next_quota,
+            app->prev_used, sample.ggap_percent, sample.is_valid});
+        selected.push_back(app);
+    }
+    if (assigned <= power_cap)
+        return;
+
+    stats.power_excess = assigned - power_cap;
+    PowerCandidates(power_apps, cfg->power.shrink, MIN_ASSIGNABLE_QUOTA,
+        reclaims);
+    uint64_t reclaimed = Reclaim(reclaims, stats.power_excess, grants);
+    for (size_t i = 0; i < selected.size(); ++i) {
+        CycleApp_t & app(*selected[i]);
+        app.next_quota -= grants[i];
+        app.reclaimed += grants[i];
+        app.state->last_quota = app.next_quota;
+    }
+    available_cpu += reclaimed;
+    stats.not_reclaimed += stats.power_excess - reclaimed;
+}
+
+void CycleEngine::CarveBurstReserve() {
+    burst_pool = std::min(cfg->burst.reserve, available_cpu);
+    available_cpu -= burst_pool;
+    stats.burst_reserve = burst_pool;
+}
+
+void CycleEngine::GrantBursts() {
+    selected.clear();
+    for (CycleApp_t * app : order) {
+        if (!app->latency || !app->running || app->skip)
+            continue;
+        BurstEarn(app->state->burst, cfg->burst, app->prev_quota,
+            app->prev_used);
+        selected.push_back(app);
+    }
+
+    // Priority 0 is the highest one
+    std::stable_sort(selected.begin(), selected.end(),
+        [](CycleApp_t const * a, CycleApp_t const * b) {
+            return a->priority < b->priority;
+        });
+
+    for (CycleApp_t * app : selected) {
+        BurstState_t & bs(app->state->burst);
+        uint64_t burst = std::min(burst_pool, BurstDemand(bs, cfg->burst,
+            app->prev_quota + app->prev_burst, app->prev_used,
+            app->next_quota));
+        BurstDraw(bs, burst);
+        if (burst == 0)
+            continue;
+        if (app->prev_burst == 0)
+            ++stats.bursts;
+        app->burst = burst;
+        app->next_quota += burst;
+        app->state->last_quota = app->next_quota;
+        burst_pool -= burst;
+    }
+
+    available_cpu += burst_pool;
+    burst_pool = 0;
+}
+
+} // namespace plugins
+
+} // namespace bbque
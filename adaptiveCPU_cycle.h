@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_CYCLE_H_
+#define BBQUE_ADAPTIVE_CPU_CYCLE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "adaptiveCPU_admission.h"
+#include "adaptiveCPU_allocator.h"
+#include "adaptiveCPU_batch.h"
+#include "adaptiveCPU_controller.h"
+#include "adaptiveCPU_groups.h"
+#include "adaptiveCPU_laws.h"
+#include "adaptiveCPU_overcommit.h"
+#include "adaptiveCPU_params.h"
+#include "adaptiveCPU_power.h"
+#include "adaptiveCPU_state.h"
+#include "adaptiveCPU_workers.h"
+
+/*
+ * Control and budget reconciliation phases of the scheduling cycle.
+ *
+ * The first two phases of AdaptiveCPUSchedPol::ScheduleApplications do not
+ * depend on the framework: given the applications to schedule (booked
+ * quota, usage, profile and controller state), the budget not booked and
+ * the CPU capacity, they compute the control actions and the quota of each
+ * application, in every configured mode (greedy, admission queue, fair,
+ * groups, hysteresis, overcommit, power capping, burst credits). The
+ * policy, the simulator (synthetic workloads and replay of the recordings)
+ * and the microbenchmarks run the very same code.
+ *
+ * The framework parts stay with the caller: collecting the applications,
+ * reading the power counters, placing and binding the quotas, logging and
+ * metrics (from the outcome of each application and from the cycle
+ * statistics).
+ */
+
+namespace bbque { namespace plugins {
+
+/** An application in the scheduling cycle: inputs and decisions */
+struct CycleApp_t
+{
+    uint32_t uid;
+    /** Application priority (0 is the highest) */
+    uint32_t priority;
+    /** Weight in the fair allocation (1 if not weighted) */
+    float weight;
+    /** Cgroup of the application (throttling input) */
+    std::string cgroup;
+    uint64_t prev_quota;
+    uint64_t prev_used;
+    int64_t prev_delta;
+    uint64_t next_quota;
+    /** Quota to book on the ResourceAccounter (see OvercommitBookings()) */
+    uint64_t booked;
+    bool running;
+    /** Not enough resources to schedule the application */
+    bool skip;
+    /** The quota has been reset to INITIAL_DEFAULT_QUOTA */
+    bool reset;
+    /** The quota change has been held by the hysteresis */
+    bool held;
+    /** Initial quota granted to a not running application */
+    uint64_t share;
+    /** Control action computed for the application */
+    PIDOutput_t ctrl;
+    /** Quota variation requested by the controller */
+    int64_t demand;
+    /** Quota variation granted by the budget allocation (the request,
+     * unless the fair allocation clipped it) */
+    int64_t grant;
+    /** Controller state of the application (owned by the caller) */
+    AppCtrlState_t * state;
+    /** Controller parameters of the application (owned by the caller) */
+    PIDParams_t const * gains;
+    /** Controller parameters used in the cycle (tuned gains, throttling) */
+    PIDParams_t params;
+    /** Throttling measured since the last cycle */
+    ThrottleSample_t throttle;
+    /** Energy attributed in the last cycle [J] (power capping) */
+    float energy;
+    /** Latency class: burst quota of the last cycle (not in prev_quota)
+     * and of this one (in next_quota) */
+    bool latency;
+    uint64_t prev_burst;
+    uint64_t burst;
+    /** Quota reclaimed after the allocation (groups, overcommit, power) */
+    uint64_t reclaimed;
+    /** Budget group of the application */
+    uint32_t group;
+    /** Controller memory, burst credits and held quota change before the
+     * cycle (recording) */
+    PIDState_t pid_in;
+    PIDState_t ggap_in;
+    BurstState_t burst_in;
+    ReconfState_t reconf_in;
+};
+
+/** Outcome of a group in the cycle */
+struct CycleGroup_t
+{
+    /** Applications of the group in the cycle */
+    uint32_t apps;
+    /** Quotas held by the applications of the group */
+    uint64_t held;
+    uint64_t budget;
+    /** Budget beyond the guaranteed one, lent by the other groups */
+    uint64_t borrowed;
+    uint64_t assigned;
+};
+
+/** Statistics of the budget reconciliation */
+struct CycleStats_t
+{
+    /** Time of the quota assignment of the running and of the not running
+     * applications [ms] */
+    double run_pass_ms;
+    double not_run_pass_ms;
+    /** Overcommit: usage, sizing, and usage close to the capacity */
+    uint64_t used;
+    OvercommitBudget_t overcommit;
+    bool overcommit_pressure;
+    /** Quota beyond the capacity (overcommit) or the cap (power) to
+     * reclaim */
+    uint64_t overcommit_excess;
+    uint64_t power_excess;
+    /** Quota that could not be reclaimed */
+    uint64_t not_reclaimed;
+    /** Power capping: quotas held by the running applications */
+    uint64_t power_held;
+    /** Burst reserve carved, and bursts started */
+    uint64_t burst_reserve;
+    uint32_t bursts;
+};
+
+/**
+ * @brief The inputs of a control law for an application
+ */
+ControlInput_t LawInput(CycleApp_t const & app, PIDParams_t const & params);
+
+/**
+ * @brief Overcommit: the quotas to book
+ *
+ * The ResourceAccounter refuses the bookings beyond the capacity. If the
+ * quotas assigned exceed it, each application books its share of the
+ * capacity; the quotas assigned are kept in the controller state.
+ *
+ * @param apps The applications of the cycle
+ * @param capacity The CPU capacity
+ *
+ * @return The quotas assigned in total
+ */
+uint64_t OvercommitBookings(
+        std::vector<CycleApp_t *> const & apps, uint64_t capacity);
+
+/**
+ * @class CycleEngine
+ *
+ * Control actions and budget reconciliation of a scheduling cycle. The
+ * engine owns the worker pool, the batch buffers and the admission queue;
+ * the controller state of the applications is owned by the caller.
+ *
+ * A cycle is run as:
+ * 1. Begin(), with the budget not booked;
+ * 2. Collect() on each application, once its inputs are set;
+ * 3. Control(): the control actions of the running applications;
+ * 4. Reconcile(): the quota of each application.
+ */
+class CycleEngine {
+
+public:
+
+    CycleEngine();
+
+    /**
+    * @brief Start a cycle
+    *
+    * @param params The policy parameters, valid until the end of the cycle
+    * @param cycle The scheduling cycle
+    * @param available The CPU budget not booked
+    * @param capacity The CPU capacity
+    * @param period_ms The time elapsed since the previous cycle
+    */
+    void Begin(
+        PolicyParams_t const & params,
+        uint32_t cycle,
+        uint64_t available,
+        uint64_t capacity,
+        double period_ms);
+
+    /**
+    * @brief The active control law (nullptr = built-in control step)
+    */
+    inline void SetControlLaw(ControlLaw * law) { active_law = law; }
+
+    /**
+    * @brief Account an application of the cycle: the controller memory is
+    * saved, and the burst quota of the last cycle is given back to the
+    * reserve, the controller running without it
+    */
+    void Collect(CycleApp_t & app);
+
+    /**
+    * @brief Phase 1: compute the control actions on the worker pool, or by
+    * the active control law (serially: the law memory is shared)
+    */
+    void Control(std::vector<CycleApp_t *> const & apps);
+
+    /**
+    * @brief Phase 2: assign the quotas according to the available budget
+    *
+    * @param power The node power of the last cycle (power capping)
+    */
+    void Reconcile(
+        std::vector<CycleApp_t *> const & apps,
+        PowerSample_t const & power);
+
+    /**
+    * @brief The CPU budget not booked
+    */
+    inline uint64_t Available() const { return available_cpu; }
+
+    /**
+    * @brief Power capping: quota cap (0 = not set yet)
+    */
+    inline uint64_t QuotaCap() const { return power_cap; }
+
+    inline void SetQuotaCap(uint64_t cap) { power_cap = cap; }
+
+    inline CycleStats_t const & Stats() const { return stats; }
+
+    /**
+    * @brief The outcome of each group in the last cycle
+    */
+    inline std::vector<CycleGroup_t> const & Groups() const {
+        return groups;
+    }
+
+    inline WorkerPool & Workers() { return workers; }
+
+    inline PIDBatch & Batch() { return batch; }
+
+    inline AdmissionQueue const & Admission() const { return admission; }
+
+private:
+
+    /** Parameters of the current cycle */
+    PolicyParams_t const * cfg;
+
+    /** Active control law, if any (not owned) */
+    ControlLaw * active_law;
+
+    uint32_t cycle;
+
+    uint64_t available_cpu;
+
+    uint64_t capacity;
+
+    double period_ms;
+
+    /** Power capping: quota cap */
+    uint64_t power_cap;
+
+    /** Burst reserve not drawn yet in the cycle */
+    uint64_t burst_pool;
+
+    CycleStats_t stats;
+
+    std::vector<CycleGroup_t> groups;
+
+    /** Worker threads computing the control actions */
+    WorkerPool workers;
+
+    /** Inputs and outcomes of the batch slack control steps */
+    PIDBatch batch;
+
+    /** Admission of the not running applications */
+    AdmissionQueue admission;
+
+    /** Applications in the visiting order of the reconciliation */
+    std::vector<CycleApp_t *> order;
+
+    /** Scratch buffers of the reconciliation, kept across the cycles */
+    std::vector<CycleApp_t *> selected;
+    std::vector<AdmissionCandidate_t> candidates;
+    std::vector<Demand_t> demands;
+    std::vector<GroupDemand_t> group_demands;
+    std::vector<GroupBudget_t> group_budgets;
+    std::vector<ReclaimCandidate_t> reclaims;
+    std::vector<OvercommitDemand_t> usage_demands;
+    std::vector<PowerApp_t> power_apps;
+    std::vector<uint64_t> grants;
+
+    void CompleteControlAction(
+        CycleApp_t & app,
+        PIDParams_t const & params,
+        PIDOutput_t const & out,
+        int64_t ff);
+
+    void ComputeLawActions(std::vector<CycleApp_t *> const & apps);
+
+    /**
+    * @brief Assign the quota of an application from its control action,
+    * or its initial quota if not running
+    */
+    void ComputeQuota(CycleApp_t & app);
+
+    /**
+    * @brief Visiting order allocation (first come, first served)
+    *
+    * The not running applications share what the running ones left either
+    * by priority through the admission queue, or in equal parts. With the
+    * admission queue, the minimum viable quota of a candidate waiting for
+    * long is set aside first, and reclaimed from the running applications
+    * (lowest priority first) if they are holding it.
+    *
+    * @param begin, end The range of applications to visit
+    */
+    void ReconcileGreedy(size_t begin, size_t end);
+
+    /**
+    * @brief Admit the not running applications by priority, with aging,
+    * while a viable quota can be granted
+    */
+    void AdmitApplications(size_t begin, size_t end);
+
+    /**
+    * @brief The budget to set aside for the admission of the not running
+    * applications (see AdmissionQueue::Reserve())
+    */
+    uint64_t AdmissionReserve(size_t begin, size_t end);
+
+    /**
+    * @brief Max-min fair (water-filling) allocation
+    *
+    * Quota decreases are applied first. Then the quota increments of the
+    * running applications and the initial quota of the not running ones
+    * are divided by water-filling. Not running applications are admitted
+    * only if they can get at least MIN_ASSIGNABLE_QUOTA.
+    */
+    void ReconcileFair(size_t begin, size_t end);
+
+    /**
+    * @brief Two-level allocation
+    *
+    * The budget is divided among the groups of applications first (see
+    * GroupBudgets()). Then the applications of each group are visited by
+    * the greedy or the fair allocation, within the group budget, and the
+    * quota held beyond the budget is reclaimed.
+    */
+    void ReconcileGroups();
+
+    /**
+    * @brief Reduce the quotas of the applications, lowest priority first
+    *
+    * @return The quota reclaimed
+    */
+    uint64_t ReclaimQuota(size_t begin, size_t end, uint64_t amount);
+
+    /**
+    * @brief Overcommit: size the budget of the cycle from the usage
+    * percentiles of the running applications (see OvercommitBudget())
+    */
+    void SizeOvercommit();
+
+    /**
+    * @brief Overcommit: reclaim the quota beyond the capacity, lowest
+    * priority first, if the usage is close to the capacity
+    */
+    void ReclaimOvercommit();
+
+    /**
+    * @brief Power capping: update the quota cap from the node power of the
+    * last cycle, and bound the budget not booked with it
+    *
+    * The energy of the cycle is attributed to the running applications.
+    */
+    void LimitPower(PowerSample_t const & power);
+
+    /**
+    * @brief Power capping: reclaim the quota beyond the cap, from the
+    * applications chosen by the shrinking criterion
+    */
+    void ReclaimPower();
+
+    /**
+    * @brief Burst credits: carve the node-wide reserve out of the budget
+    * not booked
+    */
+    void CarveBurstReserve();
+
+    /**
+    * @brief Burst credits: the latency-class applications earn credits, and
+    * draw burst quota from the reserve (highest priority first). The
+    * reserve not drawn goes back to the budget not booked.
+    */
+    void GrantBursts();
+
+};
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_CYCLE_H_
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_export.h"
+
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static_assert(sizeof(bbque::plugins::ExportHeader_t) == 64,
+    "Export header layout changed: bump EXPORT_VERSION");
+static_assert(sizeof(bbque::plugins::ExportCycle_t) == 80,
+    "Export cycle layout changed: bump EXPORT_VERSION");
+static_assert(sizeof(bbque::plugins::ExportApp_t) == 168,
+    "Export application layout changed: bump EXPORT_VERSION");
+
+namespace bbque { namespace plugins {
+
+StateExporter::StateExporter():
+        header(nullptr),
+        shm_cycle(nullptr),
+        shm_apps(nullptr),
+        map_size(0) {
+    memset(&cycle, 0, sizeof(cycle));
+}
+
+StateExporter::~StateExporter() {
+    Close();
+}
+
+bool StateExporter::Open(std::string const & _name, uint32_t capacity) {
+    Close();
+    if (_name.empty() || capacity == 0)
+        return false;
+    name = (_name[0] == '/') ? _name : "/" + _name;
+
+    size_t size = sizeof(ExportHeader_t) + sizeof(ExportCycle_t) +
+        capacity * sizeof(ExportApp_t);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void * mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    header = new (mem) ExportHeader_t();
+    header->magic = EXPORT_MAGIC;
+    header->version = EXPORT_VERSION;
+    header->header_size = sizeof(ExportHeader_t);
+    header->app_size = sizeof(ExportApp_t);
+    header->capacity = capacity;
+    header->pid = getpid();
+    header->sequence.store(0, std::memory_order_release);
+    shm_cycle = reinterpret_cast<ExportCycle_t *>(header + 1);
+    shm_apps = reinterpret_cast<ExportApp_t *>(shm_cycle + 1);
+    map_size = size;
+
+    memset(&cycle, 0, sizeof(cycle));
+    apps.assign(capacity, ExportApp_t());
+    return true;
+}
+
+void StateExporter::Close() {
+    if (header == nullptr)
+        return;
+    munmap(header, map_size);
+    shm_unlink(name.c_str());
+    header = nullptr;
+    shm_cycle = nullptr;
+    shm_apps = nullptr;
+    map_size = 0;
+    apps.clear();
+    apps.shrink_to_fit();
+}
+
+void StateExporter::Publish(size_t nr_apps) {
+    if (header == nullptr)
+        return;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    cycle.timestamp = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+        ts.tv_nsec;
+    cycle.nr_dropped = (nr_apps > apps.size()) ? nr_apps - apps.size() : 0;
+    cycle.nr_apps = nr_apps - cycle.nr_dropped;
+
+    uint64_t seq = header->sequence.load(std::memory_order_relaxed);
+    header->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(shm_cycle, &cycle, sizeof(cycle));
+    memcpy(shm_apps, apps.data(), cycle.nr_apps * sizeof(ExportApp_t));
+    header->sequence.store(seq + 2, std::memory_order_release);
+}
+
+bool StateExporter::Read(
+        ExportHeader_t const * header,
+        size_t size,
+        ExportCycle_t & cycle,
+        std::vector<ExportApp_t> & apps) {
+    if (size < sizeof(ExportHeader_t) + sizeof(ExportCycle_t) ||
+            header->magic != EXPORT_MAGIC ||
+            header->version != EXPORT_VERSION ||
+            header->header_size != sizeof(ExportHeader_t) ||
+            header->app_size != sizeof(ExportApp_t) ||
+            size < sizeof(ExportHeader_t) + sizeof(ExportCycle_t) +
+                header->capacity * sizeof(ExportApp_t))
+        return false;
+
+    ExportCycle_t const * shm_cycle =
+        reinterpret_cast<ExportCycle_t const *>(header + 1);
+    ExportApp_t const * shm_apps =
+        reinterpret_cast<ExportApp_t const *>(shm_cycle + 1);
+    apps.resize(header->capacity);
+
+    for (int i = 0; i < EXPORT_READ_RETRIES; ++i) {
+        uint64_t seq = header->sequence.load(std::memory_order_acquire);
+        if (seq & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(&cycle, shm_cycle, sizeof(cycle));
+        size_t nr_apps = (cycle.nr_apps < header->capacity) ?
+            cycle.nr_apps : header->capacity;
+        memcpy(apps.data(), shm_apps, nr_apps * sizeof(ExportApp_t));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->sequence.load(std::memory_order_relaxed) == seq) {
+            apps.resize(nr_apps);
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_EXPORT_H_
+#define BBQUE_ADAPTIVE_CPU_EXPORT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define EXPORT_MAGIC 0x58504341 // "ACPX"
+#define EXPORT_VERSION 2
+#define DEFAULT_EXPORT_NAME "/bbque-adaptiveCPU"
+#define DEFAULT_EXPORT_APPS 1024
+#define EXPORT_NAME_LEN 32
+/** Attempts of a reader before giving up on a snapshot being rewritten */
+#define EXPORT_READ_RETRIES 1000
+
+/** Application flags */
+#define EXPORT_RUNNING 0x1
+#define EXPORT_SKIPPED 0x2
+#define EXPORT_RESET 0x4
+#define EXPORT_BIND_FAILED 0x8
+#define EXPORT_THROTTLED 0x10
+#define EXPORT_BURST 0x20
+
+/*
+ * Live export of the controller state.
+ *
+ * After each cycle the policy publishes a snapshot of the cycle (timing and
+ * budget totals) and of the controller state of each application (quota,
+ * usage, control terms, gains and binding) into a POSIX shared memory
+ * segment, which bbque-adaptiveCPU-top reads.
+ *
+ * The snapshot is built in private memory during the cycle, and then
+ * copied into the segment under a sequence lock: the sequence number is odd
+ * while the copy is in progress. The writer never waits for the readers. A
+ * reader copies the snapshot and retries if the sequence number was odd or
+ * changed meanwhile.
+ */
+
+namespace bbque { namespace plugins {
+
+/** Segment header */
+struct ExportHeader_t
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t app_size;
+    /** Application slots */
+    uint32_t capacity;
+    /** Sequence lock: odd while the snapshot is being written */
+    std::atomic<uint64_t> sequence;
+    /** Owner of the segment */
+    int32_t pid;
+    uint32_t reserved[9];
+};
+
+/** Cycle snapshot */
+struct ExportCycle_t
+{
+    uint64_t cycle;
+    /** Time of the publication [ns since the epoch] */
+    uint64_t timestamp;
+    /** Time of the cycle and of its phases [ms] */
+    float cycle_ms;
+    float collect_ms;
+    float control_ms;
+    float reconcile_ms;
+    /** CPU budget: total, not booked before and after the cycle */
+    uint64_t total_cpu;
+    uint64_t available_cpu;
+    uint64_t unbooked_cpu;
+    /** Quota assigned to the applications in the cycle */
+    uint64_t booked_cpu;
+    /** Applications exported, running and not scheduled */
+    uint32_t nr_apps;
+    uint32_t nr_running;
+    uint32_t nr_skipped;
+    /** Applications not exported (exceeding the capacity) */
+    uint32_t nr_dropped;
+};
+
+/** Controller state of an application */
+struct ExportApp_t
+{
+    uint32_t uid;
+    int32_t pid;
+    char name[EXPORT_NAME_LEN];
+    /** Application state */
+    uint16_t state;
+    /** EXPORT_* flags */
+    uint16_t flags;
+    uint32_t priority;
+    /** CPU binding domain, or -1 if not bound */
+    int32_t binding;
+    /** Budget group */
+    uint32_t group;
+    uint64_t quota;
+    uint64_t used;
+    uint64_t next_quota;
+    /** Control terms */
+    int64_t error;
+    int64_t pvar;
+    int64_t ivar;
+    int64_t dvar;
+    int64_t ffvar;
+    int64_t cv;
+    /** Controller memory */
+    int64_t ierr;
+    int64_t derr;
+    /** Gains used in the cycle */
+    int32_t neg_delta;
+    float kp;
+    float ki;
+    float kd;
+    /** Fraction of time throttled or stalled (cgroup input) */
+    float stall;
+    /** Energy attributed in the last cycle [J] (power capping) */
+    float energy;
+};
+
+class StateExporter
+{
+public:
+
+    StateExporter();
+
+    ~StateExporter();
+
+    /**
+    * @brief Create the shared memory segment
+    *
+    * @param name The segment name ("/" prefixed if missing)
+    * @param capacity The number of application slots
+    *
+    * @return false if the segment could not be created
+    */
+    bool Open(std::string const & name, uint32_t capacity);
+
+    /**
+    * @brief Remove the segment
+    */
+    void Close();
+
+    bool Enabled() const {
+        return header != nullptr;
+    }
+
+    /**
+    * @brief The cycle snapshot being built
+    */
+    inline ExportCycle_t & Cycle() { return cycle; }
+
+    /**
+    * @brief The slot of an application in the snapshot being built, or
+    * nullptr if exceeding the capacity
+    */
+    inline ExportApp_t * App(size_t i) {
+        return (i < apps.size()) ? &apps[i] : nullptr;
+    }
+
+    /**
+    * @brief Publish the snapshot of the first applications
+    */
+    void Publish(size_t nr_apps);
+
+    /**
+    * @brief Copy a consistent snapshot from a segment
+    *
+    * @param header The segment header
+    * @param size The size of the segment
+    * @param cycle Filled with the cycle snapshot
+    * @param apps Filled with the applications
+    *
+    * @return false if the memory does not hold a valid segment, or if a
+    * consistent snapshot could not be read within EXPORT_READ_RETRIES
+    */
+    static bool Read(
+        ExportHeader_t const * header,
+        size_t size,
+        ExportCycle_t & cycle,
+        std::vector<ExportApp_t> & apps);
+
+private:
+
+    ExportHeader_t * header;
+    ExportCycle_t * shm_cycle;
+    ExportApp_t * shm_apps;
+    size_t map_size;
+    std::string name;
+
+    /** Snapshot being built */
+    ExportCycle_t cycle;
+    std::vector<ExportApp_t> apps;
+
+};
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_EXPORT_H_
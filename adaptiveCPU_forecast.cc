@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_forecast.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "adaptiveCPU_controller.h"
+
+namespace bbque { namespace plugins {
+
+namespace {
+
+void Push(float * window, uint32_t & nr, uint32_t & pos, float value) {
+    window[pos] = value;
+    pos = (pos + 1) % FORECAST_WINDOW;
+    if (nr < FORECAST_WINDOW)
+        ++nr;
+}
+
+void KalmanUpdate(ForecastState_t & fs, ForecastParams_t const & params,
+        float y) {
+    // Prediction: constant velocity model
+    fs.level += fs.trend;
+    float p00 = fs.p00 + 2 * fs.p01 + fs.p11 + params.kalman_q;
+    float p01 = fs.p01 + fs.p11;
+    float p11 = fs.p11 + params.kalman_q;
+
+    // Correction with the usage measurement
+    float s = p00 + params.kalman_r;
+    float k0 = p00 / s;
+    float k1 = p01 / s;
+    float innovation = y - fs.level;
+    fs.level += k0 * innovation;
+    fs.trend += k1 * innovation;
+    fs.p00 = (1 - k0) * p00;
+    fs.p01 = (1 - k0) * p01;
+    fs.p11 = p11 - k1 * p01;
+}
+
+} // namespace
+
+bool ParseForecastMethod(std::string const & name, ForecastMethod_t & method) {
+    if (name == "none")
+        method = FORECAST_NONE;
+    else if (name == "ewma")
+        method = FORECAST_EWMA;
+    else if (name == "holt")
+        method = FORECAST_HOLT;
+    else if (name == "kalman")
+        method = FORECAST_KALMAN;
+    else
+        return false;
+    return true;
+}
+
+char const * ForecastMethodName(ForecastMethod_t method) {
+    switch (method) {
+    case FORECAST_EWMA:
+        return "ewma";
+    case FORECAST_HOLT:
+        return "holt";
+    case FORECAST_KALMAN:
+        return "kalman";
+    default:
+        return "none";
+    }
+}
+
+void ForecastReset(ForecastState_t & fs) {
+    fs.nr_usage = 0;
+    fs.nr_residual = 0;
+    fs.pos_usage = 0;
+    fs.pos_residual = 0;
+    fs.level = 0;
+    fs.trend = 0;
+    fs.p00 = 0;
+    fs.p01 = 0;
+    fs.p11 = 0;
+    fs.forecast = 0;
+}
+
+ForecastOutput_t ForecastStep(
+        ForecastState_t & fs,
+        ForecastParams_t const & params,
+        uint64_t prev_quota,
+        uint64_t prev_used) {
+    ForecastOutput_t out = {false, 0, 0, 0, 0};
+    float y = prev_used;
+
+    // A saturated usage only tells that the demand is not lower
+    bool saturated = static_cast<int64_t>(prev_used) >=
+        static_cast<int64_t>(prev_quota) - THRESHOLD;
+    if (fs.nr_usage > 0) {
+        if (!saturated)
+            Push(fs.residual, fs.nr_residual, fs.pos_residual,
+                y - fs.forecast);
+        else if (fs.forecast > y)
+            y = fs.forecast;
+    }
+
+    if (fs.nr_usage == 0) {
+        fs.level = y;
+        fs.trend = 0;
+        fs.p00 = params.kalman_r;
+        fs.p01 = 0;
+        fs.p11 = params.kalman_r;
+    }
+    else if (params.method == FORECAST_EWMA) {
+        fs.level += params.alpha * (y - fs.level);
+    }
+    else if (params.method == FORECAST_HOLT) {
+        float prev_level = fs.level;
+        fs.level = params.alpha * y +
+            (1 - params.alpha) * (fs.level + fs.trend);
+        fs.trend = params.beta * (fs.level - prev_level) +
+            (1 - params.beta) * fs.trend;
+    }
+    else if (params.method == FORECAST_KALMAN) {
+        KalmanUpdate(fs, params, y);
+    }
+    Push(fs.usage, fs.nr_usage, fs.pos_usage, y);
+
+    // The trend extrapolation is bounded by the range of the window
+    float lo = fs.usage[0];
+    float hi = fs.usage[0];
+    for (uint32_t i = 1; i < fs.nr_usage; ++i) {
+        lo = std::min(lo, fs.usage[i]);
+        hi = std::max(hi, fs.usage[i]);
+    }
+    float forecast = fs.level;
+    if (params.method != FORECAST_EWMA)
+        forecast += fs.trend;
+    fs.forecast = std::min(std::max(forecast, 0.0f), hi + (hi - lo));
+
+    float sum = 0;
+    for (uint32_t i = 0; i < fs.nr_residual; ++i)
+        sum += fs.residual[i] * fs.residual[i];
+
+    out.valid = (fs.nr_usage >= FORECAST_MIN_SAMPLES);
+    out.demand = fs.forecast;
+    out.stddev = fs.nr_residual ? std::sqrt(sum / fs.nr_residual) : 0;
+    if (!out.valid)
+        return out;
+
+    out.headroom = std::min<int64_t>(
+        std::lround(params.confidence * out.stddev), params.max_headroom);
+    // Only the increases are anticipated: a wrong cut throttles the
+    // application, the decreases are left to the feedback action
+    if (fs.forecast > prev_used)
+        out.ff = std::lround(params.ff_gain * (fs.forecast - prev_used));
+    return out;
+}
+
+} // namespace plugins
+
+} // namespace bbque
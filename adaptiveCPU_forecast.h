@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_FORECAST_H_
+#define BBQUE_ADAPTIVE_CPU_FORECAST_H_
+
+#include <cstdint>
+#include <string>
+
+/** Usage samples kept for each application */
+#define FORECAST_WINDOW 16
+/** Samples required before using the forecast */
+#define FORECAST_MIN_SAMPLES 3
+
+#define DEFAULT_FORECAST_ALPHA 0.5
+#define DEFAULT_FORECAST_BETA 0.3
+#define DEFAULT_KALMAN_Q 4.0
+#define DEFAULT_KALMAN_R 100.0
+#define DEFAULT_FORECAST_CONFIDENCE 2.0
+#define DEFAULT_FORECAST_MAX_HEADROOM 50
+#define DEFAULT_FORECAST_FF_GAIN 1.0
+
+/*
+ * CPU usage forecasting for the predictive control mode.
+ *
+ * The next-cycle demand of an application is forecast from its usage by
+ * exponential smoothing, Holt linear trend, or a constant-velocity Kalman
+ * filter. The forecast gives two terms to the PID controller:
+ *
+ * - a feed-forward action, i.e. the expected demand increase, applied
+ *   before the slack reveals it;
+ * - a headroom added to the slack set-point, proportional to the standard
+ *   deviation of the recent one-step forecast errors: predictable
+ *   applications run with the default slack, noisy ones get a margin.
+ *
+ * A saturated usage (usage equal to the quota) is a lower bound of the
+ * demand: it is not allowed to lower the forecast, and it is not taken into
+ * account in the forecast error.
+ */
+
+namespace bbque { namespace plugins {
+
+typedef enum ForecastMethod {
+    FORECAST_NONE = 0,
+    FORECAST_EWMA,
+    FORECAST_HOLT,
+    FORECAST_KALMAN
+} ForecastMethod_t;
+
+/** Forecasting configuration */
+struct ForecastParams_t
+{
+    ForecastMethod_t method;
+    /** Smoothing factors of level (EWMA, Holt) and trend (Holt) */
+    float alpha;
+    float beta;
+    /** Kalman process and measurement noise variances */
+    float kalman_q;
+    float kalman_r;
+    /** Headroom in standard deviations of the forecast error */
+    float confidence;
+    /** Upper bound of the headroom */
+    int64_t max_headroom;
+    /** Gain of the feed-forward action */
+    float ff_gain;
+};
+
+/** Forecasting state of an application */
+struct ForecastState_t
+{
+    /** Sliding window of usage and one-step forecast errors */
+    float usage[FORECAST_WINDOW];
+    float residual[FORECAST_WINDOW];
+    uint32_t nr_usage;
+    uint32_t nr_residual;
+    uint32_t pos_usage;
+    uint32_t pos_residual;
+    /** Level and trend estimates */
+    float level;
+    float trend;
+    /** Kalman covariance of (level, trend) */
+    float p00;
+    float p01;
+    float p11;
+    /** Forecast of the current cycle */
+    float forecast;
+};
+
+/** Outcome of a forecasting step */
+struct ForecastOutput_t
+{
+    /** Enough samples to use the forecast */
+    bool valid;
+    /** Forecast of the next-cycle demand and its error deviation */
+    float demand;
+    float stddev;
+    /** Slack set-point margin */
+    int64_t headroom;
+    /** Feed-forward quota variation */
+    int64_t ff;
+};
+
+/**
+* @brief Parse a forecasting method name (none, ewma, holt, kalman)
+*
+* @return false if the name is unknown
+*/
+bool ParseForecastMethod(std::string const & name, ForecastMethod_t & method);
+
+char const * ForecastMethodName(ForecastMethod_t method);
+
+/**
+* @brief Reset the forecasting state
+*/
+void ForecastReset(ForecastState_t & fs);
+
+/**
+* @brief Observe the usage of the last cycle and forecast the next one
+*
+* @param fs The forecasting state
+* @param params The forecasting configuration
+* @param prev_quota CPU quota assigned in the previous cycle
+* @param prev_used CPU usage observed in the previous cycle
+*/
+ForecastOutput_t ForecastStep(
+        ForecastState_t & fs,
+        ForecastParams_t const & params,
+        uint64_t prev_quota,
+        uint64_t prev_used);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_FORECAST_H_
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_groups.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "adaptiveCPU_allocator.h"
+
+namespace bbque { namespace plugins {
+
+namespace {
+
+bool ParseAssignment(std::string const & item, GroupSpec_t & spec) {
+    size_t eq = item.find('=');
+    if (eq == std::string::npos)
+        return false;
+
+    std::string key(item.substr(0, eq));
+    char const * value = item.c_str() + eq + 1;
+    char * end;
+    if (key == "weight") {
+        spec.weight = std::strtof(value, &end);
+    }
+    else {
+        uint64_t v = std::strtoull(value, &end, 10);
+        if (key == "guaranteed")
+            spec.guaranteed = v;
+        else if (key == "max")
+            spec.max = v;
+        else
+            return false;
+    }
+    return (end != value && *end == '\0');
+}
+
+bool HasPrefix(std::string const & s, char const * prefix, size_t len) {
+    return s.compare(0, len, prefix) == 0;
+}
+
+} // namespace
+
+void ParseGroups(
+        std::string const & groups_spec,
+        std::string const & members_spec,
+        GroupParams_t & params,
+        std::vector<std::string> & errors) {
+    std::istringstream entries(groups_spec);
+    std::string entry;
+
+    params.groups.clear();
+    params.groups.push_back({DEFAULT_GROUP_NAME, 0, GROUP_UNLIMITED, 1.0});
+    params.members.clear();
+    params.by_user = false;
+
+    // "<name>:<assignments>"
+    while (std::getline(entries, entry, ';')) {
+        if (entry.empty())
+            continue;
+
+        size_t sep = entry.find(':');
+        std::string name(entry.substr(0, sep));
+        if (name.empty()) {
+            errors.push_back(entry);
+            continue;
+        }
+
+        GroupSpec_t spec = {name, 0, GROUP_UNLIMITED, 1.0};
+        bool valid = true;
+        if (sep != std::string::npos) {
+            std::istringstream items(entry.substr(sep + 1));
+            std::string item;
+            while (std::getline(items, item, ','))
+                valid &= ParseAssignment(item, spec);
+        }
+        if (!valid || spec.weight <= 0 || spec.guaranteed > spec.max) {
+            errors.push_back(entry);
+            continue;
+        }
+
+        auto it = std::find_if(params.groups.begin(), params.groups.end(),
+            [&name](GroupSpec_t const & g) { return g.name == name; });
+        if (it != params.groups.end())
+            *it = spec;
+        else
+            params.groups.push_back(spec);
+    }
+
+    // "<kind>:<name>=<group>"
+    std::istringstream members(members_spec);
+    while (std::getline(members, entry, ';')) {
+        if (entry.empty())
+            continue;
+
+        size_t eq = entry.rfind('=');
+        std::string key(entry.substr(0, eq));
+        bool user = HasPrefix(key, GROUP_USER_PREFIX,
+            sizeof(GROUP_USER_PREFIX) - 1);
+        if (eq == std::string::npos || !(user ||
+                HasPrefix(key, GROUP_APP_PREFIX,
+                    sizeof(GROUP_APP_PREFIX) - 1) ||
+                HasPrefix(key, GROUP_RECIPE_PREFIX,
+                    sizeof(GROUP_RECIPE_PREFIX) - 1))) {
+            errors.push_back(entry);
+            continue;
+        }
+
+        std::string name(entry.substr(eq + 1));
+        auto it = std::find_if(params.groups.begin(), params.groups.end(),
+            [&name](GroupSpec_t const & g) { return g.name == name; });
+        if (it == params.groups.end()) {
+            errors.push_back(entry);
+            continue;
+        }
+        params.members[key] = it - params.groups.begin();
+        params.by_user |= user;
+    }
+}
+
+uint32_t GroupOf(
+        GroupParams_t const & params,
+        std::string const & name,
+        std::string const & recipe,
+        int64_t user) {
+    if (params.members.empty())
+        return 0;
+
+    auto it = params.members.find(GROUP_APP_PREFIX + name);
+    if (it != params.members.end())
+        return it->second;
+
+    if (!recipe.empty()) {
+        it = params.members.find(GROUP_RECIPE_PREFIX + recipe);
+        if (it != params.members.end())
+            return it->second;
+    }
+
+    if (params.by_user && user >= 0) {
+        it = params.members.find(GROUP_USER_PREFIX + std::to_string(user));
+        if (it != params.members.end())
+            return it->second;
+    }
+    return 0;
+}
+
+int64_t ProcessOwner(int32_t pid) {
+    struct stat st;
+    std::string path("/proc/" + std::to_string(pid));
+    if (pid <= 0 || stat(path.c_str(), &st) != 0)
+        return -1;
+    return st.st_uid;
+}
+
+uint64_t GroupBudgets(
+        std::vector<GroupSpec_t> const & specs,
+        std::vector<GroupDemand_t> const & demands,
+        uint64_t capacity,
+        std::vector<GroupBudget_t> & budgets) {
+    size_t n = specs.size();
+    std::vector<uint64_t> wanted(n);
+    std::vector<Demand_t> claims(n);
+    std::vector<uint64_t> grants;
+
+    // Guaranteed budgets, scaled in proportion if they exceed the capacity
+    for (size_t g = 0; g < n; ++g) {
+        int64_t total = static_cast<int64_t>(demands[g].held) +
+            demands[g].request;
+        wanted[g] = std::min<uint64_t>(std::max<int64_t>(total, 0),
+            specs[g].max);
+        claims[g].base = 0;
+        claims[g].request = std::min(wanted[g], specs[g].guaranteed);
+        claims[g].floor = 0;
+        claims[g].weight = std::max<float>(specs[g].guaranteed, 1);
+    }
+    uint64_t left = WaterFill(claims, capacity, grants);
+
+    budgets.resize(n);
+    for (size_t g = 0; g < n; ++g) {
+        budgets[g].budget = grants[g];
+        claims[g].request = wanted[g] - grants[g];
+        claims[g].weight = specs[g].weight;
+    }
+
+    // Lent budgets: what is left, idle guarantees included
+    left = WaterFill(claims, left, grants);
+    for (size_t g = 0; g < n; ++g) {
+        budgets[g].budget += grants[g];
+        budgets[g].borrowed = (budgets[g].budget > specs[g].guaranteed) ?
+            budgets[g].budget - specs[g].guaranteed : 0;
+    }
+    return left;
+}
+
+uint64_t Reclaim(
+        std::vector<ReclaimCandidate_t> const & candidates,
+        uint64_t amount,
+        std::vector<uint64_t> & cuts) {
+    std::vector<size_t> order(candidates.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+        [&candidates](size_t a, size_t b) {
+            if (candidates[a].priority != candidates[b].priority)
+                return candidates[a].priority > candidates[b].priority;
+            return candidates[a].quota > candidates[b].quota;
+        });
+
+    uint64_t reclaimed = 0;
+    cuts.assign(candidates.size(), 0);
+    for (size_t i : order) {
+        if (reclaimed == amount)
+            break;
+        ReclaimCandidate_t const & c(candidates[i]);
+        uint64_t avail = (c.quota > c.floor) ? c.quota - c.floor : 0;
+        cuts[i] = std::min(avail, amount - reclaimed);
+        reclaimed += cuts[i];
+    }
+    return reclaimed;
+}
+
+} // namespace plugins
+
+} // namespace bbque
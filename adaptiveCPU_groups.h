@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_GROUPS_H_
+#define BBQUE_ADAPTIVE_CPU_GROUPS_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define DEFAULT_GROUP_NAME "default"
+#define GROUP_UNLIMITED UINT64_MAX
+
+/** Prefixes of the group members keys */
+#define GROUP_APP_PREFIX "app:"
+#define GROUP_RECIPE_PREFIX "recipe:"
+#define GROUP_USER_PREFIX "user:"
+
+/*
+ * Two-level (tenant/group) CPU budget allocation.
+ *
+ * The applications are partitioned in groups, by application name, recipe
+ * or user (owner of the process), the unmatched ones falling in the
+ * "default" group. Each group has a guaranteed and a maximum budget.
+ *
+ * At each cycle the node capacity (the budget not booked plus the quotas
+ * held by the visited applications) is divided among the groups:
+ *
+ * 1. each group gets its demand (quotas held plus requested variations),
+ *    up to the guaranteed budget. If the guarantees exceed the capacity,
+ *    they are scaled down in proportion;
+ * 2. the capacity left, including the guaranteed budget not claimed by
+ *    idle groups, is lent to the groups demanding more than their
+ *    guarantee, by max-min fair division (weighted), up to their maximum.
+ *
+ * The per-application controller then runs inside the budget of the
+ * group. The lent budget is computed again at each cycle: once the owner
+ * claims its guarantee back, the borrower budget shrinks, and the quota in
+ * excess is reclaimed from its lowest priority applications.
+ */
+
+namespace bbque { namespace plugins {
+
+/** A group of applications */
+struct GroupSpec_t
+{
+    std::string name;
+    /** Budget granted whenever demanded */
+    uint64_t guaranteed;
+    /** Budget upper bound (GROUP_UNLIMITED if none) */
+    uint64_t max;
+    /** Weight in the division of the lent budget (> 0) */
+    float weight;
+};
+
+/** Groups configuration */
+struct GroupParams_t
+{
+    /** The groups, the default one first */
+    std::vector<GroupSpec_t> groups;
+    /** Group index by "app:<name>", "recipe:<name>" or "user:<uid>" */
+    std::unordered_map<std::string, uint32_t> members;
+    /** Some members are matched by user */
+    bool by_user;
+};
+
+/** Demand of a group in the current cycle */
+struct GroupDemand_t
+{
+    /** Quotas held by the applications of the group */
+    uint64_t held;
+    /** Quota variations requested by the applications of the group */
+    int64_t request;
+};
+
+/** Budget of a group in the current cycle */
+struct GroupBudget_t
+{
+    uint64_t budget;
+    /** Budget beyond the guaranteed one, lent by the other groups */
+    uint64_t borrowed;
+};
+
+/** An application quota that can be reclaimed */
+struct ReclaimCandidate_t
+{
+    /** Application priority (0 is the highest) */
+    uint32_t priority;
+    uint64_t quota;
+    /** The quota is not reduced below this value */
+    uint64_t floor;
+};
+
+/**
+ * @brief Parse the groups configuration
+ *
+ * The groups are a semicolon separated list of entries like
+ * "<name>:guaranteed=<v>,max=<v>,weight=<v>" (all optional: by default
+ * nothing is guaranteed, there is no maximum and the weight is 1). The
+ * "default" group is always defined, and it can be configured as well.
+ *
+ * The members are a semicolon separated list of entries like
+ * "app:<name>=<group>", "recipe:<name>=<group>" or "user:<uid>=<group>".
+ *
+ * @param groups_spec The groups specification
+ * @param members_spec The members specification
+ * @param params Filled with the groups configuration
+ * @param errors Filled with the entries that could not be parsed
+ */
+void ParseGroups(
+        std::string const & groups_spec,
+        std::string const & members_spec,
+        GroupParams_t & params,
+        std::vector<std::string> & errors);
+
+/**
+ * @brief The group of an application
+ *
+ * Matching order: application name, recipe, user.
+ *
+ * @param user The owner of the application process, or -1 if unknown
+ */
+uint32_t GroupOf(
+        GroupParams_t const & params,
+        std::string const & name,
+        std::string const & recipe,
+        int64_t user);
+
+/**
+ * @brief The owner of a process, or -1 if unknown
+ */
+int64_t ProcessOwner(int32_t pid);
+
+/**
+ * @brief Divide the capacity among the groups
+ *
+ * @param specs The groups
+ * @param demands The demand of each group
+ * @param capacity The budget to divide
+ * @param budgets Filled with the budget of each group
+ *
+ * @return The budget not assigned
+ */
+uint64_t GroupBudgets(
+        std::vector<GroupSpec_t> const & specs,
+        std::vector<GroupDemand_t> const & demands,
+        uint64_t capacity,
+        std::vector<GroupBudget_t> & budgets);
+
+/**
+ * @brief Reclaim an amount of quota, lowest priority applications first
+ *
+ * Among applications of the same priority the largest quota is cut first.
+ *
+ * @param candidates The applications
+ * @param amount The quota to reclaim
+ * @param cuts Filled with the quota reclaimed from each application
+ *
+ * @return The quota reclaimed (less than the amount if the floors are hit)
+ */
+uint64_t Reclaim(
+        std::vector<ReclaimCandidate_t> const & candidates,
+        uint64_t amount,
+        std::vector<uint64_t> & cuts);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_GROUPS_H_
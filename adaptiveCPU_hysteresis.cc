@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_hysteresis.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+namespace bbque { namespace plugins {
+
+uint64_t HysteresisNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+void ReconfReset(ReconfState_t & rs) {
+    rs.pending = false;
+    rs.request_time = 0;
+    rs.used_before = 0;
+    rs.ctime_before = 0;
+    rs.cost = -1;
+    rs.samples = 0;
+    rs.direction = 0;
+    rs.accrued = 0;
+    rs.held = 0;
+}
+
+void ReconfRequested(
+        ReconfState_t & rs, uint64_t now, uint64_t used, int32_t ctime_ms) {
+    rs.pending = true;
+    rs.request_time = now;
+    rs.used_before = used;
+    rs.ctime_before = ctime_ms;
+}
+
+bool ReconfObserve(
+        ReconfState_t & rs,
+        HysteresisParams_t const & params,
+        uint64_t now,
+        bool valid,
+        int32_t ctime_ms) {
+    if (!rs.pending || !valid || now <= rs.request_time)
+        return false;
+    rs.pending = false;
+
+    // Throughput dip: cycle time after vs. before the reconfiguration
+    float dip = RECONF_MIN_DIP;
+    if (rs.ctime_before > 0 && ctime_ms > rs.ctime_before)
+        dip = std::max<float>(dip,
+            1.0 - static_cast<float>(rs.ctime_before) / ctime_ms);
+
+    float sample = rs.used_before * (now - rs.request_time) * dip;
+    if (rs.samples == 0)
+        rs.cost = sample;
+    else
+        rs.cost = params.alpha * sample + (1 - params.alpha) * rs.cost;
+    ++rs.samples;
+    return true;
+}
+
+float ReconfCost(ReconfState_t const & rs, HysteresisParams_t const & params) {
+    return (rs.samples > 0) ? rs.cost : params.default_cost;
+}
+
+int64_t HysteresisFilter(
+        ReconfState_t & rs,
+        HysteresisParams_t const & params,
+        int64_t change,
+        double period_ms) {
+    if (change == 0) {
+        rs.direction = 0;
+        rs.accrued = 0;
+        rs.held = 0;
+        return 0;
+    }
+
+    int32_t direction = (change > 0) ? 1 : -1;
+    if (direction != rs.direction) {
+        rs.direction = direction;
+        rs.accrued = 0;
+        rs.held = 0;
+    }
+
+    // Gain foregone by holding the change one more cycle
+    rs.accrued += std::llabs(change) *
+        std::min<double>(period_ms, HYSTERESIS_MAX_PERIOD_MS);
+    ++rs.held;
+
+    float threshold = (direction > 0) ? params.grow : params.shrink;
+    if (rs.accrued >= threshold * ReconfCost(rs, params) ||
+            (params.max_hold > 0 && rs.held > params.max_hold)) {
+        rs.direction = 0;
+        rs.accrued = 0;
+        rs.held = 0;
+        return change;
+    }
+    return 0;
+}
+
+} // namespace plugins
+
+} // namespace bbque
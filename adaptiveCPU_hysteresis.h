@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_HYSTERESIS_H_
+#define BBQUE_ADAPTIVE_CPU_HYSTERESIS_H_
+
+#include <cstdint>
+
+#define DEFAULT_HYSTERESIS_GROW 0.5
+#define DEFAULT_HYSTERESIS_SHRINK 2.0
+#define DEFAULT_HYSTERESIS_MAX_HOLD 10
+#define DEFAULT_RECONF_COST 1000.0
+#define DEFAULT_RECONF_ALPHA 0.3
+/** Throughput dip accounted at least: the sync point is never free */
+#define RECONF_MIN_DIP 0.1
+/** Bound of the time a held change accrues gain in a cycle [ms] */
+#define HYSTERESIS_MAX_PERIOD_MS 10000
+
+/*
+ * Reconfiguration-cost-aware quota hysteresis.
+ *
+ * A quota change is enforced through a new schedule request, i.e., a full
+ * reconfiguration of the application: a sync point, the reconfiguration
+ * callback and the restart of the work loop. For a change of a few percent
+ * of CPU this costs more than it gives.
+ *
+ * The cost of a reconfiguration of each application is estimated (moving
+ * average) from the latency between the schedule request and the next
+ * valid runtime profile, and from the throughput dip observed (cycle time
+ * before and after):
+ *
+ *   cost = usage * latency * max(dip, RECONF_MIN_DIP)    [%CPU * ms]
+ *
+ * The gain of a quota change is the budget it moves over time. A change
+ * requested by the controller is held (the quota is kept) while the gain
+ * foregone, i.e. the change times the time it has been held, is below the
+ * cost times a threshold. Growing and shrinking have separate thresholds:
+ * a starving application should be served earlier than an idle quota be
+ * reclaimed. A held change is applied anyway after a maximum number of
+ * cycles. The hold is restarted when the direction of the change flips.
+ */
+
+namespace bbque { namespace plugins {
+
+/** Hysteresis parameters */
+struct HysteresisParams_t
+{
+    bool enabled;
+    /** Gain/cost ratio to apply a quota increase */
+    float grow;
+    /** Gain/cost ratio to apply a quota decrease */
+    float shrink;
+    /** Cycles a change is held at most (0 = no bound) */
+    uint32_t max_hold;
+    /** Cost estimate of the applications never reconfigured [%CPU * ms] */
+    float default_cost;
+    /** Smoothing factor of the cost estimate */
+    float alpha;
+};
+
+/** Reconfiguration cost and held change of an application */
+struct ReconfState_t
+{
+    /** A reconfiguration has been requested, its cost not yet measured */
+    bool pending;
+    /** Time of the schedule request [ms] */
+    uint64_t request_time;
+    /** Usage and cycle time before the reconfiguration */
+    uint64_t used_before;
+    int32_t ctime_before;
+    /** Cost estimate [%CPU * ms], negative if not measured yet */
+    float cost;
+    uint32_t samples;
+    /** Held change: direction, gain foregone [%CPU * ms] and cycles */
+    int32_t direction;
+    float accrued;
+    uint32_t held;
+};
+
+/**
+ * @brief Monotonic time [ms]
+ */
+uint64_t HysteresisNow();
+
+/**
+ * @brief Reset the reconfiguration state
+ */
+void ReconfReset(ReconfState_t & rs);
+
+/**
+ * @brief Account a reconfiguration requested
+ *
+ * @param now Time of the schedule request [ms]
+ * @param used CPU usage before the reconfiguration
+ * @param ctime_ms Cycle time before the reconfiguration (0 if unknown)
+ */
+void ReconfRequested(
+        ReconfState_t & rs, uint64_t now, uint64_t used, int32_t ctime_ms);
+
+/**
+ * @brief Measure the cost of the pending reconfiguration, once a valid
+ * profile is back
+ *
+ * @return true if a cost sample has been taken
+ */
+bool ReconfObserve(
+        ReconfState_t & rs,
+        HysteresisParams_t const & params,
+        uint64_t now,
+        bool valid,
+        int32_t ctime_ms);
+
+/**
+ * @brief The reconfiguration cost estimate [%CPU * ms]
+ */
+float ReconfCost(ReconfState_t const & rs, HysteresisParams_t const & params);
+
+/**
+ * @brief Filter a quota change
+ *
+ * @param change The quota change requested
+ * @param period_ms Time elapsed since the previous cycle
+ *
+ * @return The change to apply: the requested one, or 0 if held
+ */
+int64_t HysteresisFilter(
+        ReconfState_t & rs,
+        HysteresisParams_t const & params,
+        int64_t change,
+        double period_ms);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_HYSTERESIS_H_
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_laws.h"
+
+#include <cmath>
+#include <sstream>
+
+namespace bbque { namespace plugins {
+
+namespace {
+
+class SlackLaw: public ControlLaw
+{
+public:
+
+    char const * Name() const override { return "slack"; }
+
+    PIDOutput_t Step(ControlInput_t const & in, uint64_t cycle) override {
+        PIDState_t & state(memory.Get(in.uid, cycle));
+        PIDOutput_t out = PIDStep(in.params, state,
+            in.prev_quota, in.prev_used);
+        state = out.state;
+        return out;
+    }
+
+    void Purge(uint64_t cycle) override { memory.Purge(cycle); }
+
+private:
+
+    LawMemory<PIDState_t> memory;
+
+};
+
+class GoalGapLaw: public ControlLaw
+{
+public:
+
+    explicit GoalGapLaw(int32_t deadband): deadband(deadband) {}
+
+    char const * Name() const override { return "ggap"; }
+
+    PIDOutput_t Step(ControlInput_t const & in, uint64_t cycle) override {
+        State_t & state(memory.Get(in.uid, cycle));
+        PIDOutput_t out = GoalGapStep(in.params, state.pid, state.ggap,
+            in.prev_quota, in.prev_used, in.ggap_percent, in.ggap_valid,
+            deadband);
+        state.pid = out.state;
+        return out;
+    }
+
+    void Purge(uint64_t cycle) override { memory.Purge(cycle); }
+
+private:
+
+    struct State_t {
+        PIDState_t pid;
+        PIDState_t ggap;
+    };
+
+    int32_t deadband;
+
+    LawMemory<State_t> memory;
+
+};
+
+class TrackLaw: public ControlLaw
+{
+public:
+
+    char const * Name() const override { return "track"; }
+
+    PIDOutput_t Step(ControlInput_t const & in, uint64_t cycle) override {
+        State_t & state(memory.Get(in.uid, cycle));
+        if (state.samples++ == 0)
+            state.level = in.prev_used;
+        else
+            state.level = TRACK_ALPHA * in.prev_used +
+                (1 - TRACK_ALPHA) * state.level;
+
+        int64_t target = std::lround(state.level * (1 + TRACK_MARGIN));
+        PIDOutput_t out = {};
+        out.delta = static_cast<int64_t>(in.prev_quota) -
+            static_cast<int64_t>(in.prev_used);
+        out.error = target - static_cast<int64_t>(in.prev_quota);
+        out.pvar = out.error;
+        out.cv = out.error;
+        return out;
+    }
+
+    void Purge(uint64_t cycle) override { memory.Purge(cycle); }
+
+private:
+
+    struct State_t {
+        float level;
+        uint32_t samples;
+    };
+
+    LawMemory<State_t> memory;
+
+};
+
+} // namespace
+
+std::unique_ptr<ControlLaw> MakeControlLaw(
+        std::string const & name, int32_t ggap_deadband) {
+    if (name == "slack")
+        return std::unique_ptr<ControlLaw>(new SlackLaw());
+    if (name == "ggap")
+        return std::unique_ptr<ControlLaw>(new GoalGapLaw(ggap_deadband));
+    if (name == "track")
+        return std::unique_ptr<ControlLaw>(new TrackLaw());
+    return nullptr;
+}
+
+bool ParseControlLaws(
+        std::string const & spec,
+        std::vector<std::string> & names,
+        std::string & errors) {
+    std::istringstream iss(spec);
+    std::string name;
+    names.clear();
+    errors.clear();
+    while (std::getline(iss, name, ',')) {
+        size_t first = name.find_first_not_of(" \t");
+        if (first == std::string::npos)
+            continue;
+        name = name.substr(first, name.find_last_not_of(" \t") - first + 1);
+        if (MakeControlLaw(name, 0) == nullptr) {
+            errors += (errors.empty() ? "" : ", ") + name;
+            continue;
+        }
+        names.push_back(name);
+    }
+    return errors.empty();
+}
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_LAWS_H_
+#define BBQUE_ADAPTIVE_CPU_LAWS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "adaptiveCPU_controller.h"
+
+/** The control step built in the policy (gains tuning, forecast, batch) */
+#define CONTROL_LAW_DEFAULT "default"
+
+#define TRACK_ALPHA 0.5
+#define TRACK_MARGIN 0.2
+
+/*
+ * Pluggable control laws.
+ *
+ * A control law turns the inputs of an application (quota and usage of the
+ * last cycle, goal gap, gains) into a quota variation, keeping its own
+ * per-application memory. The policy drives one of them as the active
+ * controller, in place of its built-in control step, and any number of
+ * them as shadow controllers (see ShadowEvaluator).
+ *
+ * Available laws:
+ * - slack: PID on the CPU slack, neg_delta if saturated;
+ * - ggap: PID on the goal gap, the slack as secondary constraint;
+ * - track: usage tracking, the quota follows the smoothed usage plus a
+ *   fixed margin.
+ */
+
+namespace bbque { namespace plugins {
+
+/** Inputs of a control step */
+struct ControlInput_t
+{
+    uint32_t uid;
+    uint64_t prev_quota;
+    uint64_t prev_used;
+    int32_t ggap_percent;
+    bool ggap_valid;
+    /** Gains in use for the application */
+    PIDParams_t params;
+};
+
+class ControlLaw
+{
+public:
+
+    virtual ~ControlLaw() {}
+
+    virtual char const * Name() const = 0;
+
+    /**
+    * @brief Compute the control step of an application
+    *
+    * @param in The inputs of the application
+    * @param cycle The current cycle: the memory of the application is
+    * marked as used
+    *
+    * @return The control outcome, cv being the quota variation
+    */
+    virtual PIDOutput_t Step(ControlInput_t const & in, uint64_t cycle) = 0;
+
+    /**
+    * @brief Forget the applications not stepped since a cycle
+    */
+    virtual void Purge(uint64_t cycle) = 0;
+
+};
+
+/**
+ * @class LawMemory
+ *
+ * Per-application memory of a control law, created at the first step and
+ * dropped once the application is no longer stepped.
+ */
+template <typename T>
+class LawMemory
+{
+public:
+
+    T & Get(uint32_t uid, uint64_t cycle) {
+        Entry_t & entry(entries[uid]);
+        entry.seen = cycle;
+        return entry.value;
+    }
+
+    void Purge(uint64_t cycle) {
+        for (auto it = entries.begin(); it != entries.end(); ) {
+            if (it->second.seen < cycle)
+                it = entries.erase(it);
+            else
+                ++it;
+        }
+    }
+
+private:
+
+    struct Entry_t {
+        T value;
+        uint64_t seen;
+    };
+
+    std::unordered_map<uint32_t, Entry_t> entries;
+
+};
+
+/**
+* @brief Build a control law
+*
+* @param name The law name (slack, ggap, track)
+* @param ggap_deadband Goal gap considered as goal met (ggap)
+*
+* @return The law, or nullptr if the name is unknown
+*/
+std::unique_ptr<ControlLaw> MakeControlLaw(
+        std::string const & name, int32_t ggap_deadband);
+
+/**
+* @brief Parse a comma separated list of law names
+*
+* @param spec The list
+* @param names Filled with the names
+* @param errors Filled with the unknown names
+*
+* @return false if some name is unknown
+*/
+bool ParseControlLaws(
+        std::string const & spec,
+        std::vector<std::string> & names,
+        std::string & errors);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_LAWS_H_
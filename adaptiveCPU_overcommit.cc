@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_overcommit.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bbque { namespace plugins {
+
+void UsageReset(UsageHistory_t & uh) {
+    uh.nr_usage = 0;
+    uh.pos_usage = 0;
+}
+
+void UsageObserve(UsageHistory_t & uh, uint64_t used) {
+    uh.usage[uh.pos_usage] = used;
+    uh.pos_usage = (uh.pos_usage + 1) % OVERCOMMIT_WINDOW;
+    if (uh.nr_usage < OVERCOMMIT_WINDOW)
+        ++uh.nr_usage;
+}
+
+OvercommitDemand_t UsageDemand(
+        UsageHistory_t const & uh, float risk, uint64_t quota) {
+    OvercommitDemand_t d = {quota, false, 0, 0};
+    if (uh.nr_usage < OVERCOMMIT_MIN_SAMPLES)
+        return d;
+
+    float sorted[OVERCOMMIT_WINDOW];
+    std::copy(uh.usage, uh.usage + uh.nr_usage, sorted);
+    float sum = 0;
+    for (uint32_t i = 0; i < uh.nr_usage; ++i)
+        sum += sorted[i];
+
+    // Nearest-rank percentile
+    uint32_t rank = std::ceil((1 - risk) * uh.nr_usage);
+    rank = std::max<uint32_t>(1, std::min(rank, uh.nr_usage));
+    std::nth_element(sorted, sorted + rank - 1, sorted + uh.nr_usage);
+
+    d.valid = true;
+    d.mean = sum / uh.nr_usage;
+    d.high = std::max(sorted[rank - 1], d.mean);
+    return d;
+}
+
+OvercommitBudget_t OvercommitBudget(
+        std::vector<OvercommitDemand_t> const & demands,
+        uint64_t capacity,
+        OvercommitParams_t const & params) {
+    OvercommitBudget_t budget = {0, 0, capacity};
+    double mean = 0;
+    double excess = 0;
+    for (auto const & d : demands) {
+        budget.quota += d.quota;
+        if (!d.valid) {
+            mean += d.quota;
+            continue;
+        }
+        mean += d.mean;
+        excess += (d.high - d.mean) * (d.high - d.mean);
+    }
+    budget.demand = std::ceil(mean + std::sqrt(excess));
+
+    uint64_t max_limit = params.max_ratio * capacity;
+    if (budget.demand < capacity)
+        budget.limit = std::min(max_limit,
+            std::max(capacity, budget.quota + capacity - budget.demand));
+    return budget;
+}
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_OVERCOMMIT_H_
+#define BBQUE_ADAPTIVE_CPU_OVERCOMMIT_H_
+
+#include <cstdint>
+#include <vector>
+
+/** Usage samples kept for each application */
+#define OVERCOMMIT_WINDOW 32
+/** Samples required before the usage replaces the quota as demand */
+#define OVERCOMMIT_MIN_SAMPLES 8
+
+#define DEFAULT_OVERCOMMIT_RISK 0.05
+#define DEFAULT_OVERCOMMIT_MAX_RATIO 1.5
+#define DEFAULT_OVERCOMMIT_RECLAIM 0.9
+
+/*
+ * Statistical overcommit of the CPU budget.
+ *
+ * Most applications use far less than their quota most of the time. In
+ * overcommit mode the sum of the quotas may exceed the capacity, as long as
+ * the combined high-percentile demand of the applications fits.
+ *
+ * The demand of each application is described by the mean and the
+ * (1 - risk) percentile of its usage over the last OVERCOMMIT_WINDOW
+ * cycles. Assuming independent applications, the excess over the mean
+ * adds up in quadrature, as for normal distributions:
+ *
+ *   demand = sum(mean_i) + sqrt(sum((high_i - mean_i)^2))
+ *
+ * The applications without enough samples count their whole quota. The
+ * capacity not covered by the demand can be booked again, up to max_ratio
+ * times the capacity:
+ *
+ *   limit = min(max_ratio * capacity, quotas + capacity - demand)
+ *
+ * When the actual usage of the applications reaches a fraction (reclaim)
+ * of the capacity, the overcommit is suspended and the quota in excess of
+ * the capacity is reclaimed at once from the lowest priority applications.
+ */
+
+namespace bbque { namespace plugins {
+
+/** Overcommit parameters */
+struct OvercommitParams_t
+{
+    bool enabled;
+    /** Probability of the demand exceeding the capacity */
+    float risk;
+    /** Upper bound of the booked quotas over the capacity */
+    float max_ratio;
+    /** Usage over capacity suspending the overcommit */
+    float reclaim;
+};
+
+/** Usage history of an application */
+struct UsageHistory_t
+{
+    float usage[OVERCOMMIT_WINDOW];
+    uint32_t nr_usage;
+    uint32_t pos_usage;
+};
+
+/** Demand of an application */
+struct OvercommitDemand_t
+{
+    uint64_t quota;
+    /** Enough samples: mean and high percentile valid */
+    bool valid;
+    float mean;
+    float high;
+};
+
+/** Outcome of the overcommit sizing */
+struct OvercommitBudget_t
+{
+    /** Sum of the quotas */
+    uint64_t quota;
+    /** Combined high-percentile demand */
+    uint64_t demand;
+    /** Quotas admissible in total */
+    uint64_t limit;
+};
+
+/**
+* @brief Reset the usage history
+*/
+void UsageReset(UsageHistory_t & uh);
+
+/**
+* @brief Observe the usage of the last cycle
+*/
+void UsageObserve(UsageHistory_t & uh, uint64_t used);
+
+/**
+* @brief The demand of an application
+*
+* @param uh The usage history
+* @param risk The percentile of the demand is (1 - risk)
+* @param quota The quota currently held
+*/
+OvercommitDemand_t UsageDemand(
+        UsageHistory_t const & uh, float risk, uint64_t quota);
+
+/**
+* @brief Size the quotas admissible in total
+*
+* @param demands The demand of each application
+* @param capacity The CPU capacity
+* @param params The overcommit parameters
+*/
+OvercommitBudget_t OvercommitBudget(
+        std::vector<OvercommitDemand_t> const & demands,
+        uint64_t capacity,
+        OvercommitParams_t const & params);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_OVERCOMMIT_H_
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_params.h"
+
+#include <cstdlib>
+#include <sstream>
+
+namespace bbque { namespace plugins {
+
+namespace {
+
+bool ParseAssignment(std::string const & item, PIDParams_t & params) {
+    size_t eq = item.find('=');
+    if (eq == std::string::npos)
+        return false;
+
+    std::string key(item.substr(0, eq));
+    char const * value = item.c_str() + eq + 1;
+    char * end;
+    if (key == "neg_delta") {
+        params.neg_delta = std::strtoll(value, &end, 10);
+    }
+    else {
+        float v = std::strtof(value, &end);
+        if (key == "kp")
+            params.kp = v;
+        else if (key == "ki")
+            params.ki = v;
+        else if (key == "kd")
+            params.kd = v;
+        else
+            return false;
+    }
+    return (end != value && *end == '\0');
+}
+
+template <typename T>
+void DiffValue(
+        char const * name, T const & prev, T const & next,
+        std::vector<std::string> & changes) {
+    if (prev == next)
+        return;
+    std::ostringstream ss;
+    ss << name << ": " << prev << " -> " << next;
+    changes.push_back(ss.str());
+}
+
+} // namespace
+
+void ParseGainsOverrides(
+        std::string const & spec,
+        PIDParams_t const & defaults,
+        GainsOverrides_t & overrides,
+        std::vector<std::string> & errors) {
+    std::istringstream entries(spec);
+    std::string entry;
+
+    overrides.clear();
+    while (std::getline(entries, entry, ';')) {
+        if (entry.empty())
+            continue;
+
+        // "<kind>:<name>:<assignments>"
+        size_t sep = entry.rfind(':');
+        std::string key(entry.substr(0, sep));
+        if (sep == std::string::npos ||
+                (key.compare(0, sizeof(OVERRIDE_APP_PREFIX) - 1,
+                    OVERRIDE_APP_PREFIX) != 0 &&
+                 key.compare(0, sizeof(OVERRIDE_RECIPE_PREFIX) - 1,
+                    OVERRIDE_RECIPE_PREFIX) != 0)) {
+            errors.push_back(entry);
+            continue;
+        }
+
+        PIDParams_t params(defaults);
+        std::istringstream items(entry.substr(sep + 1));
+        std::string item;
+        bool valid = true;
+        while (std::getline(items, item, ','))
+            valid &= ParseAssignment(item, params);
+        if (!valid) {
+            errors.push_back(entry);
+            continue;
+        }
+        overrides[key] = params;
+    }
+}
+
+void DiffParams(
+        PolicyParams_t const & prev,
+        PolicyParams_t const & next,
+        std::vector<std::string> & changes) {
+    DiffValue("neg_delta", prev.pid.neg_delta, next.pid.neg_delta, changes);
+    DiffValue("kp", prev.pid.kp, next.pid.kp, changes);
+    DiffValue("ki", prev.pid.ki, next.pid.ki, changes);
+    DiffValue("kd", prev.pid.kd, next.pid.kd, changes);
+    DiffValue("control_mode",
+        prev.control_mode_name, next.control_mode_name, changes);
+    DiffValue("ggap_deadband", prev.ggap_deadband, next.ggap_deadband, changes);
+    DiffValue("controller", prev.controller, next.controller, changes);
+    DiffValue("shadow_controllers",
+        prev.shadow_spec, next.shadow_spec, changes);
+    DiffValue("shadow_report", prev.shadow_report, next.shadow_report, changes);
+    DiffValue("gains_override",
+        prev.gains_override, next.gains_override, changes);
+    DiffValue("config_reload", prev.config_reload, next.config_reload, changes);
+    DiffValue("incremental", prev.incremental, next.incremental, changes);
+    DiffValue("placement",
+        prev.placement_name, next.placement_name, changes);
+    DiffValue("workers", prev.workers, next.workers, changes);
+    DiffValue("parallel_chunk",
+        prev.parallel_chunk, next.parallel_chunk, changes);
+    DiffValue("batch_kernel", prev.batch_name, next.batch_name, changes);
+    DiffValue("allocation",
+        prev.allocation_name, next.allocation_name, changes);
+    DiffValue("fair_weighted", prev.fair_weighted, next.fair_weighted, changes);
+    DiffValue("admission",
+        prev.admission_name, next.admission_name, changes);
+    DiffValue("admission_min_quota",
+        prev.admission.min_quota, next.admission.min_quota, changes);
+    DiffValue("admission_max_quota",
+        prev.admission.max_quota, next.admission.max_quota, changes);
+    DiffValue("admission_aging",
+        prev.admission.aging, next.admission.aging, changes);
+    DiffValue("groups", prev.group_budgets, next.group_budgets, changes);
+    DiffValue("group_members",
+        prev.group_members, next.group_members, changes);
+    DiffValue("autotune", prev.autotune, next.autotune, changes);
+    DiffValue("autotune_pole",
+        prev.tuner_bounds.pole, next.tuner_bounds.pole, changes);
+    DiffValue("autotune_kp_min",
+        prev.tuner_bounds.kp_min, next.tuner_bounds.kp_min, changes);
+    DiffValue("autotune_kp_max",
+        prev.tuner_bounds.kp_max, next.tuner_bounds.kp_max, changes);
+    DiffValue("autotune_ki_min",
+        prev.tuner_bounds.ki_min, next.tuner_bounds.ki_min, changes);
+    DiffValue("autotune_ki_max",
+        prev.tuner_bounds.ki_max, next.tuner_bounds.ki_max, changes);
+    DiffValue("autotune_kd_min",
+        prev.tuner_bounds.kd_min, next.tuner_bounds.kd_min, changes);
+    DiffValue("autotune_kd_max",
+        prev.tuner_bounds.kd_max, next.tuner_bounds.kd_max, changes);
+    DiffValue("ierr_limit", prev.ierr_limit, next.ierr_limit, changes);
+    DiffValue("autotune_report",
+        prev.autotune_report, next.autotune_report, changes);
+    DiffValue("forecast", prev.forecast_name, next.forecast_name, changes);
+    DiffValue("forecast_alpha",
+        prev.forecast.alpha, next.forecast.alpha, changes);
+    DiffValue("forecast_beta",
+        prev.forecast.beta, next.forecast.beta, changes);
+    DiffValue("kalman_q",
+        prev.forecast.kalman_q, next.forecast.kalman_q, changes);
+    DiffValue("kalman_r",
+        prev.forecast.kalman_r, next.forecast.kalman_r, changes);
+    DiffValue("forecast_confidence",
+        prev.forecast.confidence, next.forecast.confidence, changes);
+    DiffValue("forecast_max_headroom",
+        prev.forecast.max_headroom, next.forecast.max_headroom, changes);
+    DiffValue("forecast_ff_gain",
+        prev.forecast.ff_gain, next.forecast.ff_gain, changes);
+    DiffValue("hysteresis",
+        prev.hysteresis.enabled, next.hysteresis.enabled, changes);
+    DiffValue("hysteresis_grow",
+        prev.hysteresis.grow, next.hysteresis.grow, changes);
+    DiffValue("hysteresis_shrink",
+        prev.hysteresis.shrink, next.hysteresis.shrink, changes);
+    DiffValue("hysteresis_max_hold",
+        prev.hysteresis.max_hold, next.hysteresis.max_hold, changes);
+    DiffValue("reconf_cost",
+        prev.hysteresis.default_cost, next.hysteresis.default_cost, changes);
+    DiffValue("reconf_alpha",
+        prev.hysteresis.alpha, next.hysteresis.alpha, changes);
+    DiffValue("overcommit",
+        prev.overcommit.enabled, next.overcommit.enabled, changes);
+    DiffValue("overcommit_risk",
+        prev.overcommit.risk, next.overcommit.risk, changes);
+    DiffValue("overcommit_max_ratio",
+        prev.overcommit.max_ratio, next.overcommit.max_ratio, changes);
+    DiffValue("overcommit_reclaim",
+        prev.overcommit.reclaim, next.overcommit.reclaim, changes);
+    DiffValue("power_budget", prev.power.budget, next.power.budget, changes);
+    DiffValue("powercap_root", prev.power.root, next.power.root, changes);
+    DiffValue("power_gain", prev.power.gain, next.power.gain, changes);
+    DiffValue("power_min_ratio",
+        prev.power.min_ratio, next.power.min_ratio, changes);
+    DiffValue("power_shrink",
+        prev.power.shrink_name, next.power.shrink_name, changes);
+    DiffValue("burst_reserve", prev.burst.reserve, next.burst.reserve, changes);
+    DiffValue("latency_class",
+        prev.burst.class_spec, next.burst.class_spec, changes);
+    DiffValue("burst_earn", prev.burst.earn, next.burst.earn, changes);
+    DiffValue("burst_max_credit",
+        prev.burst.max_credit, next.burst.max_credit, changes);
+    DiffValue("burst_step", prev.burst.step, next.burst.step, changes);
+    DiffValue("cgroup_throttle",
+        prev.throttle.enabled, next.throttle.enabled, changes);
+    DiffValue("cgroup_root", prev.throttle.root, next.throttle.root, changes);
+    DiffValue("cgroup_path", prev.throttle.path, next.throttle.path, changes);
+    DiffValue("throttle_gain",
+        prev.throttle.gain, next.throttle.gain, changes);
+    DiffValue("throttle_max_stall",
+        prev.throttle.max_stall, next.throttle.max_stall, changes);
+    DiffValue("throttle_min_stall",
+        prev.throttle.min_stall, next.throttle.min_stall, changes);
+    DiffValue("throttle_max_step",
+        prev.throttle.max_step, next.throttle.max_step, changes);
+    DiffValue("trace_records",
+        prev.trace_records, next.trace_records, changes);
+    DiffValue("trace_file", prev.trace_file, next.trace_file, changes);
+    DiffValue("record_file", prev.record_file, next.record_file, changes);
+    DiffValue("record_size", prev.record_size, next.record_size, changes);
+    DiffValue("record_files", prev.record_files, next.record_files, changes);
+    DiffValue("export_shm", prev.export_shm, next.export_shm, changes);
+    DiffValue("export_apps", prev.export_apps, next.export_apps, changes);
+}
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_PARAMS_H_
+#define BBQUE_ADAPTIVE_CPU_PARAMS_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "adaptiveCPU_admission.h"
+#include "adaptiveCPU_batch.h"
+#include "adaptiveCPU_burst.h"
+#include "adaptiveCPU_controller.h"
+#include "adaptiveCPU_forecast.h"
+#include "adaptiveCPU_groups.h"
+#include "adaptiveCPU_hysteresis.h"
+#include "adaptiveCPU_overcommit.h"
+#include "adaptiveCPU_placement.h"
+#include "adaptiveCPU_power.h"
+#include "adaptiveCPU_throttle.h"
+#include "adaptiveCPU_tuner.h"
+
+#define DEFAULT_PARALLEL_CHUNK 64
+
+/** Prefixes of the gains overrides keys */
+#define OVERRIDE_APP_PREFIX "app:"
+#define OVERRIDE_RECIPE_PREFIX "recipe:"
+
+namespace bbque { namespace plugins {
+
+typedef std::unordered_map<std::string, PIDParams_t> GainsOverrides_t;
+
+/**
+ * Policy parameters loaded from the configuration file.
+ *
+ * A snapshot is never modified once published: a configuration reload
+ * builds a new snapshot and swaps it in.
+ */
+struct PolicyParams_t
+{
+    /** Global controller parameters */
+    PIDParams_t pid;
+
+    /** Primary error signal: CPU slack or goal gap */
+    std::string control_mode_name;
+    ControlMode_t control_mode;
+    int32_t ggap_deadband;
+
+    /** Active control law (CONTROL_LAW_DEFAULT = built-in control step) */
+    std::string controller;
+    /** Shadow control laws, and cycles between two reports (0 = never) */
+    std::string shadow_spec;
+    std::vector<std::string> shadows;
+    uint32_t shadow_report;
+
+    /** Controller parameters overrides, by "app:<name>" or "recipe:<name>" */
+    std::string gains_override;
+    GainsOverrides_t overrides;
+
+    /** Reload the configuration when the file changes */
+    bool config_reload;
+
+    /** Recompute only the applications changed since the last cycle */
+    bool incremental;
+
+    /** CPU binding domains placement */
+    std::string placement_name;
+    PlacementEngine::Policy_t placement;
+
+    /** Worker threads computing the control actions */
+    uint32_t workers;
+    uint32_t parallel_chunk;
+
+    /** Batch (SIMD) kernel of the slack control steps */
+    std::string batch_name;
+    bool batch;
+    PIDBatch::Kernel_t batch_kernel;
+
+    /** Budget allocation under contention */
+    std::string allocation_name;
+    bool fair_allocation;
+    bool fair_weighted;
+
+    /** Admission of the not running applications (greedy allocation) */
+    std::string admission_name;
+    bool admission_queue;
+    AdmissionParams_t admission;
+
+    /** Budget groups (empty = a single pool) and their members */
+    std::string group_budgets;
+    std::string group_members;
+    GroupParams_t groups;
+
+    /** Per-application PID gains auto-tuning */
+    bool autotune;
+    TunerBounds_t tuner_bounds;
+    int64_t ierr_limit;
+    uint32_t autotune_report;
+
+    /** Predictive control: usage forecasting */
+    std::string forecast_name;
+    ForecastParams_t forecast;
+
+    /** Reconfiguration-cost-aware quota hysteresis */
+    HysteresisParams_t hysteresis;
+
+    /** Statistical overcommit of the CPU budget */
+    OvercommitParams_t overcommit;
+
+    /** Power-capped allocation (RAPL energy counters) */
+    PowerParams_t power;
+
+    /** Burst credits of the latency-class applications */
+    BurstParams_t burst;
+
+    /** Throttling input from the cgroup v2 CPU controller */
+    ThrottleParams_t throttle;
+
+    /** Decision trace: number of records (0 = disabled) and spill file */
+    uint32_t trace_records;
+    std::string trace_file;
+
+    /** Recording of the cycles: file (empty = disabled), size and files */
+    std::string record_file;
+    uint32_t record_size;
+    uint32_t record_files;
+
+    /** Live export: shared memory segment (empty = disabled) and slots */
+    std::string export_shm;
+    uint32_t export_apps;
+};
+
+/**
+ * @brief Parse the controller parameters overrides
+ *
+ * The format is a semicolon separated list of entries like
+ * "app:<name>:kp=<v>,ki=<v>,kd=<v>,neg_delta=<v>" or "recipe:<name>:...".
+ * Parameters not specified in an entry take the global value.
+ *
+ * @param spec The overrides specification
+ * @param defaults The global controller parameters
+ * @param overrides Filled with the parsed overrides
+ * @param errors Filled with the entries that could not be parsed
+ */
+void ParseGainsOverrides(
+        std::string const & spec,
+        PIDParams_t const & defaults,
+        GainsOverrides_t & overrides,
+        std::vector<std::string> & errors);
+
+/**
+ * @brief Describe the differences between two parameters snapshots
+ *
+ * @param changes Filled with a "<name>: <old> -> <new>" string for each
+ * changed parameter
+ */
+void DiffParams(
+        PolicyParams_t const & prev,
+        PolicyParams_t const & next,
+        std::vector<std::string> & changes);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_PARAMS_H_
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_placement.h"
+
+#include <algorithm>
+
+namespace bbque { namespace plugins {
+
+PlacementEngine::PlacementEngine():
+    policy(SPREAD),
+    migrations(0) {
+}
+
+bool PlacementEngine::ParsePolicy(std::string const & name, Policy_t & p) {
+    if (name == "first")
+        p = FIRST_FIT;
+    else if (name == "pack")
+        p = PACK;
+    else if (name == "spread")
+        p = SPREAD;
+    else
+        return false;
+    return true;
+}
+
+char const * PlacementEngine::PolicyName(Policy_t p) {
+    switch (p) {
+    case FIRST_FIT:
+        return "first";
+    case PACK:
+        return "pack";
+    case SPREAD:
+        return "spread";
+    }
+    return "unknown";
+}
+
+void PlacementEngine::Reset(
+        std::vector<int32_t> const & ids,
+        std::vector<uint64_t> const & capacities) {
+    domains.clear();
+    index.clear();
+    migrations = 0;
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+        uint64_t capacity = (i < capacities.size()) ? capacities[i] : 0;
+        index.emplace(ids[i], domains.size());
+        domains.push_back({ids[i], capacity, capacity});
+    }
+    SortOrder();
+}
+
+void PlacementEngine::SortOrder() {
+    order.resize(domains.size());
+    rank.resize(domains.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(),
+        [this](uint32_t a, uint32_t b) { return Before(a, b); });
+    for (uint32_t pos = 0; pos < order.size(); ++pos)
+        rank[order[pos]] = pos;
+}
+
+void PlacementEngine::Candidates(
+        uint64_t quota,
+        int32_t prev_domain,
+        std::vector<int32_t> & candidates) const {
+    candidates.clear();
+    candidates.reserve(domains.size());
+
+    // Cache-sticky: the previous domain first, if the quota still fits
+    auto prev_it = index.find(prev_domain);
+    bool sticky = (policy != FIRST_FIT && prev_it != index.end() &&
+        domains[prev_it->second].residual >= quota);
+    if (sticky)
+        candidates.push_back(prev_domain);
+    int32_t skip = sticky ? prev_domain : -1;
+
+    if (policy == FIRST_FIT) {
+        // ID order: the fitting domains first
+        for (auto const & d : domains) {
+            if (d.residual >= quota)
+                candidates.push_back(d.id);
+        }
+        for (auto const & d : domains) {
+            if (d.residual < quota)
+                candidates.push_back(d.id);
+        }
+        return;
+    }
+
+    // The fitting domains are a prefix of the residual order
+    size_t nr_fitting = 0;
+    while (nr_fitting < order.size() &&
+            domains[order[nr_fitting]].residual >= quota)
+        ++nr_fitting;
+
+    if (policy == SPREAD) {
+        for (size_t pos = 0; pos < nr_fitting; ++pos) {
+            if (domains[order[pos]].id != skip)
+                candidates.push_back(domains[order[pos]].id);
+        }
+    }
+    else {
+        // Packing: the prefix backwards, each run of ties in ID order
+        size_t end = nr_fitting;
+        while (end > 0) {
+            size_t begin = end - 1;
+            while (begin > 0 && domains[order[begin - 1]].residual ==
+                    domains[order[end - 1]].residual)
+                --begin;
+            for (size_t pos = begin; pos < end; ++pos) {
+                if (domains[order[pos]].id != skip)
+                    candidates.push_back(domains[order[pos]].id);
+            }
+            end = begin;
+        }
+    }
+
+    // Domains not fitting the whole quota are the last resort
+    for (size_t pos = nr_fitting; pos < order.size(); ++pos)
+        candidates.push_back(domains[order[pos]].id);
+}
+
+bool PlacementEngine::Commit(
+        int32_t domain, uint64_t quota, int32_t prev_domain) {
+    auto it = index.find(domain);
+    if (it != index.end()) {
+        Domain_t & d(domains[it->second]);
+        d.residual = (d.residual > quota) ? d.residual - quota : 0;
+
+        // The residual decreased: the domain moves towards the tail
+        uint32_t pos = rank[it->second];
+        while (pos + 1 < order.size() && Before(order[pos + 1], order[pos])) {
+            std::swap(order[pos], order[pos + 1]);
+            rank[order[pos]] = pos;
+            rank[order[pos + 1]] = pos + 1;
+            ++pos;
+        }
+    }
+
+    if (prev_domain < 0 || prev_domain == domain)
+        return false;
+    ++migrations;
+    return true;
+}
+
+uint64_t PlacementEngine::Residual(int32_t domain) const {
+    auto it = index.find(domain);
+    if (it == index.end())
+        return 0;
+    return domains[it->second].residual;
+}
+
+} // namespace plugins
+
+} // namespace bbque
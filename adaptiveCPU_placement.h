@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_PLACEMENT_H_
+#define BBQUE_ADAPTIVE_CPU_PLACEMENT_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bbque { namespace plugins {
+
+/**
+ * @class PlacementEngine
+ *
+ * Choose the CPU binding domain of each application, keeping track of the
+ * residual capacity of the domains during a scheduling cycle.
+ *
+ * The domain an application was bound to in the previous cycle is always
+ * tried first, if it can still host the new quota, so that caches and
+ * NUMA-local memory stay warm. The other domains are ordered according to
+ * the placement policy.
+ *
+ * The domains are kept ordered by residual capacity (decreasing, then by
+ * ID order) as the quotas are committed, so that the candidates of an
+ * application are listed without sorting or allocating.
+ */
+class PlacementEngine {
+
+public:
+
+    enum Policy_t {
+        /** Domains in ID order, not sticky (legacy behavior) */
+        FIRST_FIT = 0,
+        /** Bin-packing: the fitting domain with the least residual */
+        PACK,
+        /** Spreading: the domain with the most residual */
+        SPREAD
+    };
+
+    PlacementEngine();
+
+    /**
+    * @brief Parse the placement policy name ("first", "pack", "spread")
+    *
+    * @return false if the name is unknown
+    */
+    static bool ParsePolicy(std::string const & name, Policy_t & policy);
+
+    static char const * PolicyName(Policy_t policy);
+
+    inline void SetPolicy(Policy_t p) { policy = p; }
+
+    inline Policy_t GetPolicy() const { return policy; }
+
+    /**
+    * @brief Start a new placement round
+    *
+    * @param ids The CPU binding domain IDs
+    * @param capacities The processing capacity of each domain
+    */
+    void Reset(
+        std::vector<int32_t> const & ids,
+        std::vector<uint64_t> const & capacities);
+
+    /**
+    * @brief The domains to try, in order of preference, for a quota
+    *
+    * @param quota The CPU quota to place
+    * @param prev_domain The domain of the previous cycle (or a negative
+    * value if none)
+    * @param candidates Filled with the ordered domain IDs. Its storage is
+    * reused: the caller should keep it across the calls.
+    */
+    void Candidates(
+        uint64_t quota,
+        int32_t prev_domain,
+        std::vector<int32_t> & candidates) const;
+
+    /**
+    * @brief Account a quota placed on a domain
+    *
+    * @return true if the placement is a migration from prev_domain
+    */
+    bool Commit(int32_t domain, uint64_t quota, int32_t prev_domain);
+
+    /**
+    * @brief Residual capacity of a domain
+    */
+    uint64_t Residual(int32_t domain) const;
+
+    /**
+    * @brief The CPU binding domains, in ID order
+    */
+    inline size_t DomainsCount() const { return domains.size(); }
+
+    inline int32_t DomainId(size_t i) const { return domains[i].id; }
+
+    inline uint64_t DomainCapacity(size_t i) const {
+        return domains[i].capacity;
+    }
+
+    /**
+    * @brief Number of migrations since the last Reset()
+    */
+    inline uint32_t Migrations() const { return migrations; }
+
+private:
+
+    struct Domain_t {
+        int32_t id;
+        uint64_t capacity;
+        uint64_t residual;
+    };
+
+    Policy_t policy;
+
+    std::vector<Domain_t> domains;
+
+    std::unordered_map<int32_t, uint32_t> index;
+
+    /** Domains by decreasing residual (ties in ID order), and the position
+     * of each domain in it */
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> rank;
+
+    uint32_t migrations;
+
+    /**
+    * @brief Domain a comes before domain b in the residual order
+    */
+    inline bool Before(uint32_t a, uint32_t b) const {
+        return domains[a].residual > domains[b].residual ||
+            (domains[a].residual == domains[b].residual && a < b);
+    }
+
+    /**
+    * @brief Sort the residual order from scratch
+    */
+    void SortOrder();
+
+};
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_PLACEMENT_H_
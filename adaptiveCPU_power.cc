@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_power.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/** The powercap files hold a single value */
+#define POWERCAP_FILE_BUFFER 64
+
+namespace bbque { namespace plugins {
+
+namespace {
+
+char const * shrink_names[] = { "ggap", "efficiency" };
+
+bool ReadValue(std::string const & path, uint64_t & value) {
+    char buf[POWERCAP_FILE_BUFFER];
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return false;
+    buf[len] = '\0';
+    char * end;
+    value = strtoull(buf, &end, 10);
+    return end != buf;
+}
+
+uint64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/** Shrinking score: the highest is shrunk first */
+float ShrinkScore(PowerApp_t const & app, PowerShrink_t shrink) {
+    if (shrink == POWER_SHRINK_GGAP)
+        return app.ggap_valid ? -app.ggap_percent : 0;
+    if (app.quota == 0)
+        return 0;
+    return 1 - static_cast<float>(std::min(app.used, app.quota)) / app.quota;
+}
+
+} // namespace
+
+bool ParsePowerShrink(std::string const & name, PowerShrink_t & shrink) {
+    for (size_t i = 0; i < sizeof(shrink_names) / sizeof(shrink_names[0]);
+            ++i) {
+        if (name == shrink_names[i]) {
+            shrink = static_cast<PowerShrink_t>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+char const * PowerShrinkName(PowerShrink_t shrink) {
+    return shrink_names[shrink];
+}
+
+PowerMeter::PowerMeter():
+        timestamp(0) {
+}
+
+size_t PowerMeter::Open(std::string const & _root) {
+    root = _root;
+    zones.clear();
+    timestamp = 0;
+
+    DIR * dir = opendir(root.c_str());
+    if (dir == nullptr)
+        return 0;
+    size_t prefix_len = strlen(POWERCAP_ZONE_PREFIX);
+    for (struct dirent * entry = readdir(dir); entry != nullptr;
+            entry = readdir(dir)) {
+        // Packages only: the sub-zones (intel-rapl:0:0) are part of them
+        char const * name = entry->d_name;
+        if (strncmp(name, POWERCAP_ZONE_PREFIX, prefix_len) != 0 ||
+                strchr(name + prefix_len, ':') != nullptr)
+            continue;
+        Zone_t zone;
+        zone.path = root + "/" + name;
+        if (!ReadValue(zone.path + "/energy_uj", zone.energy))
+            continue;
+        if (!ReadValue(zone.path + "/max_energy_range_uj", zone.max_range))
+            zone.max_range = 0;
+        zones.push_back(zone);
+    }
+    closedir(dir);
+
+    // Readings in a stable order
+    std::sort(zones.begin(), zones.end(),
+        [](Zone_t const & a, Zone_t const & b) { return a.path < b.path; });
+    return zones.size();
+}
+
+PowerSample_t PowerMeter::Sample() {
+    PowerSample_t sample = {false, 0, 0};
+    if (zones.empty())
+        return sample;
+
+    uint64_t now = NowUs();
+    uint64_t energy = 0;
+    bool valid = true;
+    for (auto & zone : zones) {
+        uint64_t value;
+        if (!ReadValue(zone.path + "/energy_uj", value)) {
+            valid = false;
+            continue;
+        }
+        if (value >= zone.energy)
+            energy += value - zone.energy;
+        else if (zone.max_range > zone.energy)
+            energy += zone.max_range - zone.energy + value;
+        else
+            valid = false;
+        zone.energy = value;
+    }
+
+    if (valid && timestamp > 0 && now > timestamp) {
+        sample.valid = true;
+        sample.energy = energy / 1e6;
+        sample.power = sample.energy / ((now - timestamp) / 1e6);
+    }
+    timestamp = valid ? now : 0;
+    return sample;
+}
+
+uint64_t PowerCap(
+        uint64_t cap,
+        uint64_t capacity,
+        PowerParams_t const & params,
+        double power) {
+    double next = cap * (1 + params.gain *
+        (params.budget - power) / params.budget);
+    double lower = params.min_ratio * capacity;
+    return std::max(lower, std::min(next, static_cast<double>(capacity)));
+}
+
+void PowerCandidates(
+        std::vector<PowerApp_t> const & apps,
+        PowerShrink_t shrink,
+        uint64_t floor,
+        std::vector<ReclaimCandidate_t> & candidates) {
+    std::vector<size_t> order(apps.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    // Ties broken by the application priority, the lowest shrunk first
+    std::stable_sort(order.begin(), order.end(),
+        [&apps, shrink](size_t a, size_t b) {
+            float sa = ShrinkScore(apps[a], shrink);
+            float sb = ShrinkScore(apps[b], shrink);
+            if (sa != sb)
+                return sa < sb;
+            return apps[a].priority < apps[b].priority;
+        });
+
+    candidates.resize(apps.size());
+    for (size_t rank = 0; rank < order.size(); ++rank) {
+        PowerApp_t const & app(apps[order[rank]]);
+        candidates[order[rank]] = {static_cast<uint32_t>(rank), app.quota,
+            floor};
+    }
+}
+
+} // namespace plugins
+
+} // namespace bbque
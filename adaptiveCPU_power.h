@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_POWER_H_
+#define BBQUE_ADAPTIVE_CPU_POWER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "adaptiveCPU_groups.h"
+
+#define DEFAULT_POWERCAP_ROOT "/sys/class/powercap"
+#define DEFAULT_POWER_GAIN 0.5
+#define DEFAULT_POWER_MIN_RATIO 0.1
+#define DEFAULT_POWER_SHRINK "efficiency"
+/** Package zones of the powercap tree: <prefix><package> */
+#define POWERCAP_ZONE_PREFIX "intel-rapl:"
+
+/*
+ * Power-capped allocation.
+ *
+ * The energy counters of the RAPL package zones (powercap tree, e.g.
+ * /sys/class/powercap/intel-rapl:0/energy_uj) give the node power over the
+ * last cycle. To keep it within a budget, the policy scales the total CPU
+ * quota it hands out, rather than letting the firmware throttle every core
+ * equally:
+ *
+ *   cap = cap * (1 + gain * (budget - power) / budget)
+ *
+ * bounded by [min_ratio, 1] times the capacity. The increases are granted
+ * within the cap only, and the quota in excess is taken back from the
+ * applications that lose the least from it first:
+ *
+ * - ggap: the ones exceeding their goal the most (goal gap);
+ * - efficiency: the ones using the least of their quota.
+ *
+ * The energy of the cycle is attributed to the running applications in
+ * proportion to their CPU usage.
+ */
+
+namespace bbque { namespace plugins {
+
+typedef enum PowerShrink {
+    POWER_SHRINK_GGAP = 0,
+    POWER_SHRINK_EFFICIENCY
+} PowerShrink_t;
+
+/** Power capping parameters */
+struct PowerParams_t
+{
+    /** Node power budget [W] (0 = disabled) */
+    float budget;
+    /** Root of the powercap tree */
+    std::string root;
+    /** Gain of the quota cap update */
+    float gain;
+    /** Lower bound of the quota cap over the capacity */
+    float min_ratio;
+    /** Criterion choosing the applications to shrink */
+    std::string shrink_name;
+    PowerShrink_t shrink;
+};
+
+/** Energy consumed since the previous reading */
+struct PowerSample_t
+{
+    bool valid;
+    /** Energy [J] and average power [W] */
+    double energy;
+    double power;
+};
+
+/** An application to rank for shrinking */
+struct PowerApp_t
+{
+    /** Application priority (0 is the highest) */
+    uint32_t priority;
+    uint64_t quota;
+    uint64_t used;
+    int32_t ggap_percent;
+    bool ggap_valid;
+};
+
+/**
+* @brief Parse a shrinking criterion name (ggap, efficiency)
+*
+* @return false if the name is unknown
+*/
+bool ParsePowerShrink(std::string const & name, PowerShrink_t & shrink);
+
+char const * PowerShrinkName(PowerShrink_t shrink);
+
+/**
+ * @class PowerMeter
+ *
+ * Package energy counters of the powercap tree.
+ */
+class PowerMeter
+{
+public:
+
+    PowerMeter();
+
+    /**
+    * @brief Discover the package zones
+    *
+    * @param root The root of the powercap tree
+    *
+    * @return The number of zones found
+    */
+    size_t Open(std::string const & root);
+
+    inline std::string const & Root() const { return root; }
+
+    inline size_t ZonesCount() const { return zones.size(); }
+
+    /**
+    * @brief Read the counters
+    *
+    * @return The energy since the previous reading. Not valid at the first
+    * reading, or if a counter could not be read.
+    */
+    PowerSample_t Sample();
+
+private:
+
+    struct Zone_t {
+        std::string path;
+        /** Counter range, to account the wrap-around [uJ] */
+        uint64_t max_range;
+        uint64_t energy;
+    };
+
+    std::string root;
+
+    std::vector<Zone_t> zones;
+
+    /** Time of the previous reading [us], 0 if none */
+    uint64_t timestamp;
+
+};
+
+/**
+* @brief Update the quota cap
+*
+* @param cap The quota cap of the previous cycle
+* @param capacity The CPU capacity
+* @param params The power capping parameters
+* @param power The power of the last cycle [W]
+*/
+uint64_t PowerCap(
+        uint64_t cap,
+        uint64_t capacity,
+        PowerParams_t const & params,
+        double power);
+
+/**
+* @brief The applications as reclaim candidates (see Reclaim()), ranked by
+* the shrinking criterion: the priority of a candidate is its rank, the
+* highest value being shrunk first
+*
+* @param apps The applications
+* @param shrink The shrinking criterion
+* @param floor The quota is not reduced below this value
+* @param candidates Filled with the candidates, in the order of apps
+*/
+void PowerCandidates(
+        std::vector<PowerApp_t> const & apps,
+        PowerShrink_t shrink,
+        uint64_t floor,
+        std::vector<ReclaimCandidate_t> & candidates);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_POWER_H_
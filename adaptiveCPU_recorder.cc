@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_recorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(bbque::plugins::RecordHeader_t) == 64,
+    "Record header layout changed: bump RECORD_VERSION");
+static_assert(sizeof(bbque::plugins::RecordFrame_t) == 24,
+    "Record frame layout changed: bump RECORD_VERSION");
+static_assert(sizeof(bbque::plugins::RecordConfig_t) == 176,
+    "Record config layout changed: bump RECORD_VERSION");
+static_assert(sizeof(bbque::plugins::RecordGroup_t) == 24,
+    "Record group layout changed: bump RECORD_VERSION");
+static_assert(sizeof(bbque::plugins::RecordCycle_t) == 64,
+    "Record cycle layout changed: bump RECORD_VERSION");
+static_assert(sizeof(bbque::plugins::RecordDomain_t) == 16,
+    "Record domain layout changed: bump RECORD_VERSION");
+static_assert(sizeof(bbque::plugins::RecordApp_t) == 152,
+    "Record application layout changed: bump RECORD_VERSION");
+
+namespace bbque { namespace plugins {
+
+namespace {
+
+uint64_t Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+} // namespace
+
+DecisionRecorder::DecisionRecorder():
+        header(nullptr),
+        base(nullptr),
+        size(0),
+        files(0),
+        sequence(0),
+        dropped(0),
+        pending(nullptr),
+        config_valid(false) {
+}
+
+DecisionRecorder::~DecisionRecorder() {
+    Close();
+}
+
+bool DecisionRecorder::Open(
+        std::string const & _path, uint64_t _size, uint32_t _files) {
+    Close();
+    if (_path.empty() || _size < RECORD_MIN_SIZE)
+        return false;
+    path = _path;
+    size = _size;
+    files = (_files > 0) ? _files : 1;
+    sequence = 0;
+    dropped = 0;
+    config_valid = false;
+
+    // Never append to a file of a previous run: keep it as history
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0)
+        return Rotate();
+    return Create();
+}
+
+void DecisionRecorder::Close() {
+    if (header == nullptr)
+        return;
+    uint64_t used = header->used.load(std::memory_order_relaxed);
+    Unmap();
+    // Drop the unused tail of the file
+    if (truncate(path.c_str(), used) != 0)
+        fprintf(stderr, "Cannot truncate the recording file [%s]\n",
+            path.c_str());
+}
+
+void DecisionRecorder::Unmap() {
+    msync(header, size, MS_ASYNC);
+    munmap(header, size);
+    header = nullptr;
+    base = nullptr;
+    pending = nullptr;
+}
+
+bool DecisionRecorder::Create() {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return false;
+    }
+    void * mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return false;
+
+    header = new (mem) RecordHeader_t();
+    header->magic = RECORD_MAGIC;
+    header->version = RECORD_VERSION;
+    header->header_size = sizeof(RecordHeader_t);
+    header->capacity = size;
+    header->sequence = sequence++;
+    header->created = Now();
+    header->used.store(sizeof(RecordHeader_t), std::memory_order_release);
+    base = static_cast<uint8_t *>(mem);
+
+    // Each file is self-contained: it starts with the configuration
+    if (config_valid)
+        Config(0, config, config_groups.data());
+    return true;
+}
+
+bool DecisionRecorder::Rotate() {
+    uint64_t used = 0;
+    if (header != nullptr) {
+        used = header->used.load(std::memory_order_relaxed);
+        Unmap();
+        if (truncate(path.c_str(), used) != 0)
+            return false;
+    }
+
+    // <path>.N-2 -> <path>.N-1, ..., <path> -> <path>.1
+    for (uint32_t i = files - 1; i > 0; --i) {
+        std::string from = (i > 1) ? path + "." + std::to_string(i - 1) : path;
+        rename(from.c_str(), (path + "." + std::to_string(i)).c_str());
+    }
+    if (files == 1)
+        unlink(path.c_str());
+    return Create();
+}
+
+RecordFrame_t * DecisionRecorder::Reserve(
+        uint32_t type, uint64_t cycle, size_t bytes) {
+    if (header == nullptr)
+        return nullptr;
+    if (bytes > UINT32_MAX ||
+            bytes > size - sizeof(RecordHeader_t) - sizeof(RecordConfig_t) -
+                config_groups.size() * sizeof(RecordGroup_t) -
+                sizeof(RecordFrame_t)) {
+        ++dropped;
+        return nullptr;
+    }
+
+    uint64_t used = header->used.load(std::memory_order_relaxed);
+    if (used + bytes > size) {
+        if (!Rotate())
+            return nullptr;
+        used = header->used.load(std::memory_order_relaxed);
+    }
+
+    RecordFrame_t * frame = reinterpret_cast<RecordFrame_t *>(base + used);
+    frame->type = type;
+    frame->size = bytes;
+    frame->cycle = cycle;
+    frame->timestamp = Now();
+    return frame;
+}
+
+bool DecisionRecorder::Config(
+        uint64_t cycle,
+        RecordConfig_t const & cfg,
+        RecordGroup_t const * groups) {
+    // Copied first: the groups may be the stored ones
+    if (groups != config_groups.data())
+        config_groups.assign(groups, groups + cfg.nr_groups);
+    config = cfg;
+    config_valid = true;
+    RecordFrame_t * frame = Reserve(RECORD_FRAME_CONFIG, cycle,
+        sizeof(RecordFrame_t) + sizeof(RecordConfig_t) +
+            cfg.nr_groups * sizeof(RecordGroup_t));
+    if (frame == nullptr)
+        return false;
+    RecordConfig_t * body = reinterpret_cast<RecordConfig_t *>(frame + 1);
+    *body = cfg;
+    std::copy(config_groups.begin(), config_groups.end(),
+        reinterpret_cast<RecordGroup_t *>(body + 1));
+    pending = frame;
+    Commit();
+    return true;
+}
+
+bool DecisionRecorder::BeginCycle(
+        uint64_t cycle,
+        RecordCycle_t const & info,
+        RecordDomain_t * & domains,
+        RecordApp_t * & apps) {
+    size_t bytes = sizeof(RecordFrame_t) + sizeof(RecordCycle_t) +
+        info.nr_domains * sizeof(RecordDomain_t) +
+        info.nr_apps * sizeof(RecordApp_t);
+    RecordFrame_t * frame = Reserve(RECORD_FRAME_CYCLE, cycle, bytes);
+    if (frame == nullptr)
+        return false;
+
+    RecordCycle_t * body = reinterpret_cast<RecordCycle_t *>(frame + 1);
+    *body = info;
+    domains = reinterpret_cast<RecordDomain_t *>(body + 1);
+    apps = reinterpret_cast<RecordApp_t *>(domains + info.nr_domains);
+    pending = frame;
+    return true;
+}
+
+void DecisionRecorder::Commit() {
+    if (pending == nullptr)
+        return;
+    header->used.fetch_add(pending->size, std::memory_order_release);
+    pending = nullptr;
+}
+
+void DecisionRecorder::Sync() {
+    if (header != nullptr)
+        msync(header, size, MS_ASYNC);
+}
+
+RecordReader::RecordReader():
+        header(nullptr),
+        map_size(0),
+        used(0),
+        offset(0) {
+}
+
+RecordReader::~RecordReader() {
+    Close();
+}
+
+bool RecordReader::Open(std::string const & path) {
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+            static_cast<size_t>(st.st_size) < sizeof(RecordHeader_t)) {
+        close(fd);
+        return false;
+    }
+    void * mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return false;
+
+    header = static_cast<RecordHeader_t const *>(mem);
+    map_size = st.st_size;
+    used = header->used.load(std::memory_order_acquire);
+    if (header->magic != RECORD_MAGIC ||
+            header->version != RECORD_VERSION ||
+            header->header_size != sizeof(RecordHeader_t) ||
+            used > map_size) {
+        Close();
+        return false;
+    }
+    offset = sizeof(RecordHeader_t);
+    return true;
+}
+
+void RecordReader::Close() {
+    if (header == nullptr)
+        return;
+    munmap(const_cast<RecordHeader_t *>(header), map_size);
+    header = nullptr;
+    map_size = 0;
+    used = 0;
+    offset = 0;
+}
+
+RecordFrame_t const * RecordReader::Next() {
+    if (header == nullptr || offset + sizeof(RecordFrame_t) > used)
+        return nullptr;
+    RecordFrame_t const * frame = reinterpret_cast<RecordFrame_t const *>(
+        reinterpret_cast<uint8_t const *>(header) + offset);
+    if (frame->size < sizeof(RecordFrame_t) || offset + frame->size > used)
+        return nullptr;
+
+    // Check the declared body size against the frame size
+    size_t body = 0;
+    if (frame->type == RECORD_FRAME_CONFIG) {
+        if (frame->size < sizeof(RecordFrame_t) + sizeof(RecordConfig_t))
+            return nullptr;
+        body = sizeof(RecordConfig_t) +
+            Body<RecordConfig_t>(frame)->nr_groups * sizeof(RecordGroup_t);
+    }
+    else if (frame->type == RECORD_FRAME_CYCLE) {
+        if (frame->size < sizeof(RecordFrame_t) + sizeof(RecordCycle_t))
+            return nullptr;
+        RecordCycle_t const * info = Body<RecordCycle_t>(frame);
+        body = sizeof(RecordCycle_t) +
+            info->nr_domains * sizeof(RecordDomain_t) +
+            info->nr_apps * sizeof(RecordApp_t);
+    }
+    if (body > 0 && frame->size != sizeof(RecordFrame_t) + body)
+        return nullptr;
+
+    offset += frame->size;
+    return frame;
+}
+
+} // namespace plugins
+
+} // namespace bbque
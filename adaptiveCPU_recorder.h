@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_RECORDER_H_
+#define BBQUE_ADAPTIVE_CPU_RECORDER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "adaptiveCPU_controller.h"
+
+#define RECORD_MAGIC 0x52504341 // "ACPR"
+#define RECORD_VERSION 2
+#define DEFAULT_RECORD_SIZE_MB 64
+#define DEFAULT_RECORD_FILES 4
+#define RECORD_MIN_SIZE 4096
+
+/** Frame types */
+#define RECORD_FRAME_CONFIG 0x47464341 // "ACFG"
+#define RECORD_FRAME_CYCLE 0x43594341 // "ACYC"
+
+/** Application record flags */
+#define RECORD_RUNNING 0x1
+#define RECORD_PROFILE_VALID 0x2
+#define RECORD_SKIPPED 0x4
+#define RECORD_RESET 0x8
+#define RECORD_SCHEDULED 0x10
+#define RECORD_LATENCY 0x20
+
+/** Cycle record flags */
+#define RECORD_CYCLE_POWER_VALID 0x1
+
+/** Configuration record flags */
+#define RECORD_CFG_FAIR 0x1
+#define RECORD_CFG_FAIR_WEIGHTED 0x2
+#define RECORD_CFG_ADMISSION_QUEUE 0x4
+#define RECORD_CFG_AUTOTUNE 0x8
+#define RECORD_CFG_INCREMENTAL 0x10
+#define RECORD_CFG_GROUPS 0x20
+#define RECORD_CFG_HYSTERESIS 0x40
+#define RECORD_CFG_OVERCOMMIT 0x80
+#define RECORD_CFG_POWER 0x100
+#define RECORD_CFG_CONTROL_LAW 0x200
+#define RECORD_CFG_BURST 0x400
+
+/*
+ * Recording of the inputs and the outputs of the scheduling cycles.
+ *
+ * Each cycle appends a frame with the system snapshot used by the policy
+ * (available CPU, capacity, power reading, CPU binding domains,
+ * applications state, booked quota, runtime profile, controller memory,
+ * burst credits and held quota changes) and the decisions taken (control
+ * variable, quota and binding). A configuration frame, followed by the
+ * budget groups, is appended whenever the policy parameters change, and at
+ * the beginning of each file, so that every file can be replayed on its
+ * own (see bbque-adaptiveCPU-sim -p). The state the policy rebuilds from
+ * the cycles themselves (usage forecasts and histories, admission queue)
+ * is not recorded: it is rebuilt by the replay as well.
+ *
+ * The file is memory-mapped, and the frames are written in place: the
+ * header "used" counter is advanced only once a frame is complete, so that
+ * a reader (or a crash) never sees a partial frame. When the file is full
+ * it is rotated: <path> is renamed <path>.1, <path>.1 is renamed <path>.2,
+ * and so on, keeping the given number of files.
+ */
+
+namespace bbque { namespace plugins {
+
+/** Recording file header */
+struct RecordHeader_t
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    /** Size of the file */
+    uint64_t capacity;
+    /** Bytes of complete frames, header included */
+    std::atomic<uint64_t> used;
+    /** Files opened before this one by the recorder */
+    uint64_t sequence;
+    /** Creation time [ns since the epoch] */
+    uint64_t created;
+    uint64_t reserved[3];
+};
+
+/** Frame header */
+struct RecordFrame_t
+{
+    /** RECORD_FRAME_* */
+    uint32_t type;
+    /** Bytes of the frame, header included */
+    uint32_t size;
+    /** Scheduling cycle */
+    uint64_t cycle;
+    /** Time of the frame [ns since the epoch] */
+    uint64_t timestamp;
+};
+
+/** Configuration frame body */
+struct RecordConfig_t
+{
+    int32_t neg_delta;
+    float kp;
+    float ki;
+    float kd;
+    /** ControlMode_t */
+    uint32_t control_mode;
+    int32_t ggap_deadband;
+    /** RECORD_CFG_* */
+    uint32_t flags;
+    /** ForecastMethod_t */
+    uint32_t forecast_method;
+    float forecast_alpha;
+    float forecast_beta;
+    float kalman_q;
+    float kalman_r;
+    float forecast_confidence;
+    float forecast_ff_gain;
+    int64_t forecast_max_headroom;
+    uint64_t admission_min_quota;
+    uint64_t admission_max_quota;
+    uint64_t admission_default_quota;
+    uint32_t admission_aging;
+    /** Budget groups following the configuration */
+    uint32_t nr_groups;
+    /** Hysteresis */
+    float hysteresis_grow;
+    float hysteresis_shrink;
+    uint32_t hysteresis_max_hold;
+    float reconf_cost;
+    float reconf_alpha;
+    /** Overcommit */
+    float overcommit_risk;
+    float overcommit_max_ratio;
+    float overcommit_reclaim;
+    /** Power capping (PowerShrink_t) */
+    float power_budget;
+    float power_gain;
+    float power_min_ratio;
+    uint32_t power_shrink;
+    /** Burst credits */
+    float burst_earn;
+    uint64_t burst_reserve;
+    uint64_t burst_max_credit;
+    uint64_t burst_step;
+};
+
+/** A budget group, in the order of the group indexes */
+struct RecordGroup_t
+{
+    uint64_t guaranteed;
+    uint64_t max;
+    float weight;
+    uint32_t reserved;
+};
+
+/** Cycle frame body, followed by the domain and the application records */
+struct RecordCycle_t
+{
+    /** CPU budget not booked at the beginning of the cycle */
+    uint64_t available_cpu;
+    uint32_t nr_domains;
+    uint32_t nr_apps;
+    /** Not running applications in the system */
+    uint32_t nr_not_run_apps;
+    /** RECORD_CYCLE_* flags */
+    uint32_t flags;
+    /** CPU capacity */
+    uint64_t capacity;
+    /** Time since the previous cycle [ms] */
+    double period_ms;
+    /** Power capping: quota cap of the last cycle, and the power reading */
+    uint64_t power_cap;
+    double energy;
+    double power;
+};
+
+/** A CPU binding domain */
+struct RecordDomain_t
+{
+    int32_t id;
+    uint32_t reserved;
+    uint64_t capacity;
+};
+
+/** An application, in the collection order of the policy */
+struct RecordApp_t
+{
+    uint32_t uid;
+    /** Application state */
+    uint16_t state;
+    /** RECORD_* flags */
+    uint16_t flags;
+    uint32_t priority;
+    /** Decision: CPU binding domain, or -1 if not bound */
+    int32_t binding;
+    /** Quota booked by the application (sys.cpu.pe), burst included */
+    uint64_t quota;
+    /** Runtime profile */
+    int32_t cpu_usage;
+    int32_t ctime_ms;
+    int32_t ggap_percent;
+    /** Controller parameters of the application */
+    int32_t neg_delta;
+    float kp;
+    float ki;
+    float kd;
+    uint32_t reserved;
+    /** Controller memory before the control step */
+    PIDState_t pid;
+    PIDState_t ggap_pid;
+    /** Decision: control variable and quota */
+    int64_t cv;
+    uint64_t next_quota;
+    /** Budget group and weight in the fair allocation */
+    uint32_t group;
+    float weight;
+    /** Burst credits before the cycle */
+    uint64_t burst_credit;
+    uint64_t burst_borrowed;
+    /** Reconfiguration cost and held quota change before the cycle */
+    float reconf_cost;
+    uint32_t reconf_samples;
+    int32_t reconf_direction;
+    float reconf_accrued;
+    uint32_t reconf_held;
+    uint32_t reserved2;
+};
+
+class DecisionRecorder
+{
+public:
+
+    DecisionRecorder();
+
+    ~DecisionRecorder();
+
+    /**
+    * @brief Start recording into a file, rotating the existing one
+    *
+    * @param path The recording file
+    * @param size The size of each file
+    * @param files The number of files to keep, the current one included
+    *
+    * @return false if the file could not be created
+    */
+    bool Open(std::string const & path, uint64_t size, uint32_t files);
+
+    /**
+    * @brief Stop recording, truncating the file to the recorded frames
+    */
+    void Close();
+
+    bool Enabled() const {
+        return header != nullptr;
+    }
+
+    /**
+    * @brief Append a configuration frame
+    *
+    * The configuration is also written at the beginning of the next files.
+    *
+    * @param groups The config.nr_groups budget groups
+    */
+    bool Config(
+        uint64_t cycle,
+        RecordConfig_t const & config,
+        RecordGroup_t const * groups);
+
+    /**
+    * @brief Start a cycle frame
+    *
+    * The domain and the application records are to be filled in place,
+    * then the frame is appended by Commit().
+    *
+    * @return false if the frame does not fit an empty file
+    */
+    bool BeginCycle(
+        uint64_t cycle,
+        RecordCycle_t const & info,
+        RecordDomain_t * & domains,
+        RecordApp_t * & apps);
+
+    /**
+    * @brief Append the frame started by BeginCycle()
+    */
+    void Commit();
+
+    /**
+    * @brief Schedule the write-back of the recording file
+    */
+    void Sync();
+
+    /**
+    * @brief Frames dropped since too large for the recording file
+    */
+    inline uint64_t Dropped() const { return dropped; }
+
+private:
+
+    RecordHeader_t * header;
+    uint8_t * base;
+    std::string path;
+    uint64_t size;
+    uint32_t files;
+    uint64_t sequence;
+    uint64_t dropped;
+
+    /** Frame being filled */
+    RecordFrame_t * pending;
+
+    /** Last configuration, written at the beginning of each file */
+    RecordConfig_t config;
+    std::vector<RecordGroup_t> config_groups;
+    bool config_valid;
+
+    /** Reserve a frame, rotating the file if full */
+    RecordFrame_t * Reserve(uint32_t type, uint64_t cycle, size_t bytes);
+
+    bool Rotate();
+
+    bool Create();
+
+    void Unmap();
+
+};
+
+/**
+ * Sequential reader of a recording file
+ */
+class RecordReader
+{
+public:
+
+    RecordReader();
+
+    ~RecordReader();
+
+    /**
+    * @brief Map a recording file
+    *
+    * @return false if the file does not hold a valid recording
+    */
+    bool Open(std::string const & path);
+
+    void Close();
+
+    inline RecordHeader_t const * Header() const { return header; }
+
+    /**
+    * @brief The next frame, or nullptr at the end of the recording
+    */
+    RecordFrame_t const * Next();
+
+    template <typename T>
+    static T const * Body(RecordFrame_t const * frame) {
+        return reinterpret_cast<T const *>(frame + 1);
+    }
+
+    static RecordGroup_t const * Groups(RecordFrame_t const * frame) {
+        return reinterpret_cast<RecordGroup_t const *>(
+            Body<RecordConfig_t>(frame) + 1);
+    }
+
+    static RecordDomain_t const * Domains(RecordFrame_t const * frame) {
+        return reinterpret_cast<RecordDomain_t const *>(
+            Body<RecordCycle_t>(frame) + 1);
+    }
+
+    static RecordApp_t const * Apps(RecordFrame_t const * frame) {
+        return reinterpret_cast<RecordApp_t const *>(
+            Domains(frame) + Body<RecordCycle_t>(frame)->nr_domains);
+    }
+
+private:
+
+    RecordHeader_t const * header;
+    size_t map_size;
+    uint64_t used;
+    uint64_t offset;
+
+};
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_RECORDER_H_
@@ -17,11 +17,14 @@
 
 #include "adaptiveCPU_schedpol.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <stdio.h>
 #include <fstream>
+#include <sys/stat.h>
 #include "bbque/modules_factory.h"
 #include "bbque/utils/logging/logger.h"
 
@@ -32,10 +35,13 @@
 
 #define MODULE_CONFIG SCHEDULER_POLICY_CONFIG "." SCHEDULER_POLICY_NAME
 
-#define INITIAL_DEFAULT_QUOTA 150
-#define MIN_ASSIGNABLE_QUOTA 10
-#define ADMISSIBLE_DELTA 10
-#define THRESHOLD 1
+// Per-application logging, compiled only if enabled: the decisions are
+// traced by the DecisionTracer
+#ifdef CONFIG_BBQUE_SCHEDPOL_ADAPTIVECPU_APP_LOG
+# define APP_LOG(...) logger->Debug(__VA_ARGS__)
+#else
+# define APP_LOG(...)
+#endif
 
 using namespace std::placeholders;
 
@@ -44,7 +50,52 @@ namespace po = boost::program_options;
 
 namespace bbque { 
     namespace plugins {
-    
+
+/* Definition of metrics used by this module */
+MetricsCollector::MetricsCollection_t
+AdaptiveCPUSchedPol::coll_metrics[ACPU_METRICS_COUNT] = {
+    ACPU_SAMPLE_METRIC("cycle",
+        "Scheduling cycle time [ms]"),
+    ACPU_SAMPLE_METRIC("init",
+        "Initialization time [ms]"),
+    ACPU_SAMPLE_METRIC("collect",
+        "Applications collection time [ms]"),
+    ACPU_SAMPLE_METRIC("control",
+        "Control actions computation time [ms]"),
+    ACPU_SAMPLE_METRIC("run_pass",
+        "Quota assignment time of the running applications [ms]"),
+    ACPU_SAMPLE_METRIC("notrun_pass",
+        "Quota assignment time of the not running applications [ms]"),
+    ACPU_SAMPLE_METRIC("binding",
+        "CPU binding attempts time [ms]"),
+    ACPU_SAMPLE_METRIC("sched_req",
+        "ApplicationManager schedule requests time [ms]"),
+    ACPU_COUNTER_METRIC("bind_fail",
+        "CPU binding failures"),
+    ACPU_COUNTER_METRIC("sched_req_fail",
+        "Schedule requests failures"),
+    ACPU_COUNTER_METRIC("skip_app",
+        "Applications not scheduled (SCHED_SKIP_APP)"),
+    ACPU_COUNTER_METRIC("quota_reset",
+        "Quota resets to the initial default quota"),
+    ACPU_COUNTER_METRIC("quota_held",
+        "Quota changes held by the reconfiguration hysteresis"),
+    ACPU_COUNTER_METRIC("overcommit_reclaim",
+        "Overcommit suspensions reclaiming quota"),
+    ACPU_COUNTER_METRIC("power_reclaim",
+        "Quota reclaims enforcing the power budget"),
+    ACPU_COUNTER_METRIC("burst",
+        "Bursts of the latency-class applications"),
+    ACPU_SAMPLE_METRIC("power",
+        "Node power in the last cycle [W]"),
+    ACPU_SAMPLE_METRIC("ctrl_error",
+        "Control error of the running applications"),
+    ACPU_SAMPLE_METRIC("unused_quota",
+        "Unused quota of the running applications"),
+    ACPU_SAMPLE_METRIC("app_energy",
+        "Energy attributed to the running applications in a cycle [J]"),
+};
+
 // :::::::::::::::::::::: Static plugin interface ::::::::::::::::::::::::::::
 
 void * AdaptiveCPUSchedPol::Create(PF_ObjectParams *) {
@@ -66,7 +117,18 @@ void * AdaptiveCPUSchedPol::Create(PF_ObjectParams *) {
 
     AdaptiveCPUSchedPol::AdaptiveCPUSchedPol():
         cm(ConfigurationManager::GetInstance()),
-        ra(ResourceAccounter::GetInstance()) {
+        ra(ResourceAccounter::GetInstance()),
+        mc(bu::MetricsCollector::GetInstance()),
+        binding_ms(0),
+        sched_request_ms(0),
+        cycle_start_ms(0),
+        cycle_period_ms(0),
+        active_law_name(CONTROL_LAW_DEFAULT),
+        law_deadband(DEFAULT_GGAP_DEADBAND),
+        config_mtime(),
+        dirty_marked(false),
+        last_status_view(0),
+        last_status_view_valid(false) {
     logger = bu::Logger::GetLogger(MODULE_NAMESPACE);
     assert(logger);
     if (logger)
@@ -74,6 +136,9 @@ void * AdaptiveCPUSchedPol::Create(PF_ObjectParams *) {
     else
         fprintf(stderr,
             FI("adaptive_cpu: Built new dynamic object [%p]\n"), (void *)this);
+
+    // Register all the metrics generated by this module
+    mc.Register(coll_metrics, ACPU_METRICS_COUNT);
     }
 
 
@@ -104,37 +169,759 @@ SchedulerPolicyIF::ExitCode_t AdaptiveCPUSchedPol::_Init() {
     
     available_cpu = ra.Available("sys.cpu.pe");
     
+    InitPlacement();
+
+    return SCHED_OK;
+}
+
+void AdaptiveCPUSchedPol::LoadConfiguration() {
+    std::shared_ptr<PolicyParams_t> next(new PolicyParams_t);
+
+    // Taken before parsing: a change made meanwhile triggers a new reload
+    std::string const & conf_file(cm.GetConfigurationFile());
+    struct stat conf_stat;
+    if (stat(conf_file.c_str(), &conf_stat) == 0)
+        config_mtime = conf_stat.st_mtim;
+
     po::options_description opts_desc("AdaptiveCPUSchedPol Parameters Options");
     opts_desc.add_options()
         ("AdaptiveCPUSchedPol.neg_delta",
         po::value<int64_t>(
-        &this->neg_delta)->default_value(DEFAULT_NEG_DELTA),
+        &next->pid.neg_delta)->default_value(DEFAULT_NEG_DELTA),
         "Value of neg_delta");
 
     opts_desc.add_options()
         ("AdaptiveCPUSchedPol.kp",
         po::value<float>(
-        &this->kp)->default_value(DEFAULT_KP),
+        &next->pid.kp)->default_value(DEFAULT_KP),
         "Value of coefficient kp");
 
     opts_desc.add_options()
         ("AdaptiveCPUSchedPol.ki",
         po::value<float>(
-        &this->ki)->default_value(DEFAULT_KI),
+        &next->pid.ki)->default_value(DEFAULT_KI),
         "Value of coefficient ki");
 
     opts_desc.add_options()
         ("AdaptiveCPUSchedPol.kd",
         po::value<float>(
-        &this->kd)->default_value(DEFAULT_KD),
+        &next->pid.kd)->default_value(DEFAULT_KD),
         "Value of coefficient kd");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.control_mode",
+        po::value<std::string>(
+        &next->control_mode_name)->default_value("slack"),
+        "Primary error signal of the controller (slack, ggap)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.ggap_deadband",
+        po::value<int32_t>(
+        &next->ggap_deadband)->default_value(DEFAULT_GGAP_DEADBAND),
+        "Goal gap [%] considered as goal met (ggap control mode)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.controller",
+        po::value<std::string>(
+        &next->controller)->default_value(CONTROL_LAW_DEFAULT),
+        "Active control law (default, slack, ggap, track)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.shadow_controllers",
+        po::value<std::string>(
+        &next->shadow_spec)->default_value(""),
+        "Comma separated control laws evaluated in shadow mode "
+        "(slack, ggap, track)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.shadow_report",
+        po::value<uint32_t>(
+        &next->shadow_report)->default_value(DEFAULT_SHADOW_REPORT),
+        "Cycles between two shadow control laws reports (0 = never)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.gains_override",
+        po::value<std::string>(
+        &next->gains_override)->default_value(""),
+        "Controller parameters overrides "
+        "(app:<name>:kp=<v>,ki=<v>,kd=<v>,neg_delta=<v>;recipe:<name>:...)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.config_reload",
+        po::value<bool>(
+        &next->config_reload)->default_value(true),
+        "Reload the parameters when the configuration file changes");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.incremental",
+        po::value<bool>(
+        &next->incremental)->default_value(false),
+        "Recompute only the applications changed since the last cycle");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.placement",
+        po::value<std::string>(
+        &next->placement_name)->default_value("spread"),
+        "CPU binding domains placement (first, pack, spread)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.workers",
+        po::value<uint32_t>(
+        &next->workers)->default_value(0),
+        "Worker threads computing the control actions (0 = serial)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.parallel_chunk",
+        po::value<uint32_t>(
+        &next->parallel_chunk)->default_value(DEFAULT_PARALLEL_CHUNK),
+        "Minimum number of applications per worker chunk");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.batch_kernel",
+        po::value<std::string>(
+        &next->batch_name)->default_value("auto"),
+        "Batch kernel of the control steps (none, auto, scalar, sse, avx2)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.allocation",
+        po::value<std::string>(
+        &next->allocation_name)->default_value("greedy"),
+        "Budget allocation under contention (greedy, fair)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.fair_weighted",
+        po::value<bool>(
+        &next->fair_weighted)->default_value(false),
+        "Weight the fair allocation by application priority");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.admission",
+        po::value<std::string>(
+        &next->admission_name)->default_value("queue"),
+        "Admission of the not running applications (queue, equal)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.admission_min_quota",
+        po::value<uint64_t>(
+        &next->admission.min_quota)->default_value(
+            DEFAULT_ADMISSION_MIN_QUOTA),
+        "Minimum viable initial quota of an admitted application");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.admission_max_quota",
+        po::value<uint64_t>(
+        &next->admission.max_quota)->default_value(
+            DEFAULT_ADMISSION_MAX_QUOTA),
+        "Maximum initial quota sized on the application usage history");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.admission_aging",
+        po::value<uint32_t>(
+        &next->admission.aging)->default_value(DEFAULT_ADMISSION_AGING),
+        "Waiting cycles raising the admission priority by one level");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.groups",
+        po::value<std::string>(
+        &next->group_budgets)->default_value(""),
+        "Budget groups (<name>:guaranteed=<v>,max=<v>,weight=<v>;...), "
+        "empty = a single pool");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.group_members",
+        po::value<std::string>(
+        &next->group_members)->default_value(""),
+        "Budget groups members (app:<name>=<group>;recipe:<name>=<group>;"
+        "user:<uid>=<group>)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.autotune",
+        po::value<bool>(
+        &next->autotune)->default_value(false),
+        "Per-application online tuning of the PID gains");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.autotune_pole",
+        po::value<float>(
+        &next->tuner_bounds.pole)->default_value(DEFAULT_TUNER_POLE),
+        "Target closed-loop pole of the tuned controllers, in (0, 1)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.autotune_kp_min",
+        po::value<float>(
+        &next->tuner_bounds.kp_min)->default_value(DEFAULT_TUNER_KP_MIN),
+        "Minimum tuned kp");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.autotune_kp_max",
+        po::value<float>(
+        &next->tuner_bounds.kp_max)->default_value(DEFAULT_TUNER_KP_MAX),
+        "Maximum tuned kp");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.autotune_ki_min",
+        po::value<float>(
+        &next->tuner_bounds.ki_min)->default_value(DEFAULT_TUNER_KI_MIN),
+        "Minimum tuned ki");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.autotune_ki_max",
+        po::value<float>(
+        &next->tuner_bounds.ki_max)->default_value(DEFAULT_TUNER_KI_MAX),
+        "Maximum tuned ki");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.autotune_kd_min",
+        po::value<float>(
+        &next->tuner_bounds.kd_min)->default_value(DEFAULT_TUNER_KD_MIN),
+        "Minimum tuned kd");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.autotune_kd_max",
+        po::value<float>(
+        &next->tuner_bounds.kd_max)->default_value(DEFAULT_TUNER_KD_MAX),
+        "Maximum tuned kd");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.ierr_limit",
+        po::value<int64_t>(
+        &next->ierr_limit)->default_value(DEFAULT_IERR_LIMIT),
+        "Auto-tuning anti-windup: bound of the integral error (0 = none)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.autotune_report",
+        po::value<uint32_t>(
+        &next->autotune_report)->default_value(0),
+        "Cycles between two auto-tuning gains reports (0 = never)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.forecast",
+        po::value<std::string>(
+        &next->forecast_name)->default_value("none"),
+        "Predictive control usage forecasting (none, ewma, holt, kalman)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.forecast_alpha",
+        po::value<float>(
+        &next->forecast.alpha)->default_value(DEFAULT_FORECAST_ALPHA),
+        "Level smoothing factor (ewma, holt)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.forecast_beta",
+        po::value<float>(
+        &next->forecast.beta)->default_value(DEFAULT_FORECAST_BETA),
+        "Trend smoothing factor (holt)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.kalman_q",
+        po::value<float>(
+        &next->forecast.kalman_q)->default_value(DEFAULT_KALMAN_Q),
+        "Process noise variance (kalman)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.kalman_r",
+        po::value<float>(
+        &next->forecast.kalman_r)->default_value(DEFAULT_KALMAN_R),
+        "Measurement noise variance (kalman)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.forecast_confidence",
+        po::value<float>(
+        &next->forecast.confidence)->default_value(
+            DEFAULT_FORECAST_CONFIDENCE),
+        "Slack headroom in standard deviations of the forecast error");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.forecast_max_headroom",
+        po::value<int64_t>(
+        &next->forecast.max_headroom)->default_value(
+            DEFAULT_FORECAST_MAX_HEADROOM),
+        "Maximum slack headroom");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.forecast_ff_gain",
+        po::value<float>(
+        &next->forecast.ff_gain)->default_value(DEFAULT_FORECAST_FF_GAIN),
+        "Gain of the forecast feed-forward action");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.trace_records",
+        po::value<uint32_t>(
+        &next->trace_records)->default_value(DEFAULT_TRACE_RECORDS),
+        "Records of the decision trace ring buffer (0 = disabled)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.trace_file",
+        po::value<std::string>(
+        &next->trace_file)->default_value(""),
+        "Memory-mapped file of the decision trace (empty = in memory)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.record_file",
+        po::value<std::string>(
+        &next->record_file)->default_value(""),
+        "Recording file of the cycles inputs and decisions (empty = disabled)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.record_size",
+        po::value<uint32_t>(
+        &next->record_size)->default_value(DEFAULT_RECORD_SIZE_MB),
+        "Size of each recording file [MB]");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.record_files",
+        po::value<uint32_t>(
+        &next->record_files)->default_value(DEFAULT_RECORD_FILES),
+        "Recording files kept by the rotation");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.export_shm",
+        po::value<std::string>(
+        &next->export_shm)->default_value(""),
+        "Shared memory segment of the live controller state "
+        "(empty = disabled)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.export_apps",
+        po::value<uint32_t>(
+        &next->export_apps)->default_value(DEFAULT_EXPORT_APPS),
+        "Applications slots of the live controller state");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.hysteresis",
+        po::value<bool>(
+        &next->hysteresis.enabled)->default_value(false),
+        "Hold the quota changes not worth a reconfiguration");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.hysteresis_grow",
+        po::value<float>(
+        &next->hysteresis.grow)->default_value(DEFAULT_HYSTERESIS_GROW),
+        "Gain/cost ratio to apply a quota increase");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.hysteresis_shrink",
+        po::value<float>(
+        &next->hysteresis.shrink)->default_value(DEFAULT_HYSTERESIS_SHRINK),
+        "Gain/cost ratio to apply a quota decrease");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.hysteresis_max_hold",
+        po::value<uint32_t>(
+        &next->hysteresis.max_hold)->default_value(
+            DEFAULT_HYSTERESIS_MAX_HOLD),
+        "Cycles a quota change is held at most (0 = no bound)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.reconf_cost",
+        po::value<float>(
+        &next->hysteresis.default_cost)->default_value(DEFAULT_RECONF_COST),
+        "Reconfiguration cost of the applications not measured yet "
+        "[%CPU * ms]");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.reconf_alpha",
+        po::value<float>(
+        &next->hysteresis.alpha)->default_value(DEFAULT_RECONF_ALPHA),
+        "Smoothing factor of the reconfiguration cost estimate");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.overcommit",
+        po::value<bool>(
+        &next->overcommit.enabled)->default_value(false),
+        "Let the quotas exceed the capacity within the usage percentiles");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.overcommit_risk",
+        po::value<float>(
+        &next->overcommit.risk)->default_value(DEFAULT_OVERCOMMIT_RISK),
+        "Probability of the demand exceeding the capacity");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.overcommit_max_ratio",
+        po::value<float>(
+        &next->overcommit.max_ratio)->default_value(
+            DEFAULT_OVERCOMMIT_MAX_RATIO),
+        "Upper bound of the booked quotas over the capacity");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.overcommit_reclaim",
+        po::value<float>(
+        &next->overcommit.reclaim)->default_value(DEFAULT_OVERCOMMIT_RECLAIM),
+        "Usage over capacity suspending the overcommit");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.power_budget",
+        po::value<float>(
+        &next->power.budget)->default_value(0),
+        "Node power budget [W] (0 = no power capping)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.powercap_root",
+        po::value<std::string>(
+        &next->power.root)->default_value(DEFAULT_POWERCAP_ROOT),
+        "Root of the powercap tree (RAPL package zones)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.power_gain",
+        po::value<float>(
+        &next->power.gain)->default_value(DEFAULT_POWER_GAIN),
+        "Gain of the quota cap update");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.power_min_ratio",
+        po::value<float>(
+        &next->power.min_ratio)->default_value(DEFAULT_POWER_MIN_RATIO),
+        "Lower bound of the quota cap over the capacity");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.power_shrink",
+        po::value<std::string>(
+        &next->power.shrink_name)->default_value(DEFAULT_POWER_SHRINK),
+        "Applications shrunk first under the power cap (ggap, efficiency)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.burst_reserve",
+        po::value<uint64_t>(
+        &next->burst.reserve)->default_value(0),
+        "Node-wide burst reserve of the latency class [%CPU] (0 = disabled)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.latency_class",
+        po::value<std::string>(
+        &next->burst.class_spec)->default_value(""),
+        "Latency class members (app:<name>;recipe:<name>)");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.burst_earn",
+        po::value<float>(
+        &next->burst.earn)->default_value(DEFAULT_BURST_EARN),
+        "Burst credits earned per unit of quota not used");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.burst_max_credit",
+        po::value<uint64_t>(
+        &next->burst.max_credit)->default_value(DEFAULT_BURST_MAX_CREDIT),
+        "Upper bound of the burst credits of an application");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.burst_step",
+        po::value<uint64_t>(
+        &next->burst.step)->default_value(DEFAULT_BURST_STEP),
+        "Burst growth per saturated cycle [%CPU]");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.cgroup_throttle",
+        po::value<bool>(
+        &next->throttle.enabled)->default_value(false),
+        "Size the saturated quotas from the cgroup v2 throttling and PSI");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.cgroup_root",
+        po::value<std::string>(
+        &next->throttle.root)->default_value(DEFAULT_CGROUP_ROOT),
+        "Mount point of the cgroup v2 hierarchy");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.cgroup_path",
+        po::value<std::string>(
+        &next->throttle.path)->default_value(DEFAULT_CGROUP_PATH),
+        "Cgroup of an application ({id}, {name}, {pid}, {uid})");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.throttle_gain",
+        po::value<float>(
+        &next->throttle.gain)->default_value(DEFAULT_THROTTLE_GAIN),
+        "Gain of the quota shortfall estimated from the stall");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.throttle_max_stall",
+        po::value<float>(
+        &next->throttle.max_stall)->default_value(DEFAULT_THROTTLE_MAX_STALL),
+        "Upper bound of the stall fraction used in the estimate");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.throttle_min_stall",
+        po::value<float>(
+        &next->throttle.min_stall)->default_value(DEFAULT_THROTTLE_MIN_STALL),
+        "Stall fraction below which a saturated quota fits");
+
+    opts_desc.add_options()
+        ("AdaptiveCPUSchedPol.throttle_max_step",
+        po::value<int64_t>(
+        &next->throttle.max_step)->default_value(DEFAULT_THROTTLE_MAX_STEP),
+        "Upper bound of the quota shortfall");
     po::variables_map opts_vm;
     cm.ParseConfigurationFile(opts_desc, opts_vm);
 
-    logger->Info("Running with neg_delta=%d, kp=%f, ki=%f, kd=%f", 
-                 neg_delta, kp, ki, kd);
+    next->fair_allocation = (next->allocation_name == "fair");
+    if (!next->fair_allocation && next->allocation_name != "greedy")
+        logger->Warn("LoadConfiguration: unknown allocation policy '%s', "
+            "using 'greedy'", next->allocation_name.c_str());
 
-    return SCHED_OK;
+    if (!PlacementEngine::ParsePolicy(next->placement_name, next->placement)) {
+        logger->Warn("LoadConfiguration: unknown placement policy '%s', "
+            "using 'spread'", next->placement_name.c_str());
+        next->placement = PlacementEngine::SPREAD;
+    }
+
+    next->admission_queue = (next->admission_name == "queue");
+    if (!next->admission_queue && next->admission_name != "equal")
+        logger->Warn("LoadConfiguration: unknown admission policy '%s', "
+            "using 'equal'", next->admission_name.c_str());
+    next->admission.default_quota = INITIAL_DEFAULT_QUOTA;
+
+    next->control_mode = CONTROL_SLACK;
+    if (next->control_mode_name == "ggap")
+        next->control_mode = CONTROL_GGAP;
+    else if (next->control_mode_name != "slack")
+        logger->Warn("LoadConfiguration: unknown control mode '%s', "
+            "using 'slack'", next->control_mode_name.c_str());
+
+    if (next->controller != CONTROL_LAW_DEFAULT &&
+            MakeControlLaw(next->controller, 0) == nullptr) {
+        logger->Warn("LoadConfiguration: unknown control law '%s', "
+            "using '%s'", next->controller.c_str(), CONTROL_LAW_DEFAULT);
+        next->controller = CONTROL_LAW_DEFAULT;
+    }
+
+    std::string law_errors;
+    if (!ParseControlLaws(next->shadow_spec, next->shadows, law_errors))
+        logger->Warn("LoadConfiguration: unknown shadow control laws "
+            "ignored: %s", law_errors.c_str());
+
+    if (!ParseForecastMethod(next->forecast_name, next->forecast.method)) {
+        logger->Warn("LoadConfiguration: unknown forecasting method '%s', "
+            "using 'none'", next->forecast_name.c_str());
+        next->forecast.method = FORECAST_NONE;
+    }
+
+    if (next->hysteresis.alpha <= 0 || next->hysteresis.alpha > 1) {
+        logger->Warn("LoadConfiguration: invalid reconf_alpha %f, using %f",
+            next->hysteresis.alpha, DEFAULT_RECONF_ALPHA);
+        next->hysteresis.alpha = DEFAULT_RECONF_ALPHA;
+    }
+
+    if (next->overcommit.risk <= 0 || next->overcommit.risk >= 1) {
+        logger->Warn("LoadConfiguration: invalid overcommit_risk %f, "
+            "using %f", next->overcommit.risk, DEFAULT_OVERCOMMIT_RISK);
+        next->overcommit.risk = DEFAULT_OVERCOMMIT_RISK;
+    }
+
+    if (next->overcommit.max_ratio < 1) {
+        logger->Warn("LoadConfiguration: invalid overcommit_max_ratio %f, "
+            "using 1", next->overcommit.max_ratio);
+        next->overcommit.max_ratio = 1;
+    }
+
+    if (next->overcommit.reclaim <= 0 || next->overcommit.reclaim > 1) {
+        logger->Warn("LoadConfiguration: invalid overcommit_reclaim %f, "
+            "using %f", next->overcommit.reclaim, DEFAULT_OVERCOMMIT_RECLAIM);
+        next->overcommit.reclaim = DEFAULT_OVERCOMMIT_RECLAIM;
+    }
+
+    // The sizing needs the quotas and the usage of all the applications,
+    // while the incremental mode collects only the changed ones
+    if (next->overcommit.enabled && next->incremental) {
+        logger->Warn("LoadConfiguration: overcommit not supported in "
+            "incremental mode, overcommit disabled");
+        next->overcommit.enabled = false;
+    }
+
+    if (next->power.budget < 0) {
+        logger->Warn("LoadConfiguration: invalid power_budget %f, "
+            "power capping disabled", next->power.budget);
+        next->power.budget = 0;
+    }
+
+    if (next->power.min_ratio <= 0 || next->power.min_ratio > 1) {
+        logger->Warn("LoadConfiguration: invalid power_min_ratio %f, "
+            "using %f", next->power.min_ratio, DEFAULT_POWER_MIN_RATIO);
+        next->power.min_ratio = DEFAULT_POWER_MIN_RATIO;
+    }
+
+    if (!ParsePowerShrink(next->power.shrink_name, next->power.shrink)) {
+        logger->Warn("LoadConfiguration: unknown power_shrink '%s', "
+            "using '%s'", next->power.shrink_name.c_str(),
+            DEFAULT_POWER_SHRINK);
+        ParsePowerShrink(DEFAULT_POWER_SHRINK, next->power.shrink);
+    }
+
+    std::vector<std::string> burst_errors;
+    ParseBurstClass(next->burst.class_spec, next->burst.members,
+        burst_errors);
+    for (auto const & entry : burst_errors)
+        logger->Warn("LoadConfiguration: invalid latency class entry '%s'",
+            entry.c_str());
+
+    if (next->burst.earn < 0) {
+        logger->Warn("LoadConfiguration: invalid burst_earn %f, using %f",
+            next->burst.earn, DEFAULT_BURST_EARN);
+        next->burst.earn = DEFAULT_BURST_EARN;
+    }
+
+    if (next->throttle.max_stall <= 0 || next->throttle.max_stall >= 1) {
+        logger->Warn("LoadConfiguration: invalid throttle_max_stall %f, "
+            "using %f", next->throttle.max_stall, DEFAULT_THROTTLE_MAX_STALL);
+        next->throttle.max_stall = DEFAULT_THROTTLE_MAX_STALL;
+    }
+
+    next->batch = (next->batch_name != "none");
+    next->batch_kernel = PIDBatch::KERNEL_AUTO;
+    if (next->batch &&
+            !PIDBatch::ParseKernel(next->batch_name, next->batch_kernel))
+        logger->Warn("LoadConfiguration: unknown batch kernel '%s', "
+            "using 'auto'", next->batch_name.c_str());
+
+    std::vector<std::string> errors;
+    ParseGainsOverrides(
+        next->gains_override, next->pid, next->overrides, errors);
+    for (auto const & entry : errors)
+        logger->Warn("LoadConfiguration: invalid gains override '%s'",
+            entry.c_str());
+
+    errors.clear();
+    if (!next->group_budgets.empty())
+        ParseGroups(next->group_budgets, next->group_members, next->groups,
+            errors);
+    else if (!next->group_members.empty())
+        logger->Warn("LoadConfiguration: group members without groups");
+    for (auto const & entry : errors)
+        logger->Warn("LoadConfiguration: invalid group entry '%s'",
+            entry.c_str());
+
+    auto prev = std::atomic_load(&params);
+    if (prev) {
+        std::vector<std::string> changes;
+        DiffParams(*prev, *next, changes);
+        logger->Info("LoadConfiguration: '%s' reloaded, %d parameters changed",
+            conf_file.c_str(), changes.size());
+        for (auto const & change : changes)
+            logger->Info("LoadConfiguration: %s", change.c_str());
+    }
+
+    if (!prev || prev->workers != next->workers)
+        engine.Workers().Resize(next->workers);
+
+    if (next->batch) {
+        PIDBatch::Kernel_t kernel = engine.Batch().SetKernel(
+            next->batch_kernel);
+        if (next->batch_kernel != PIDBatch::KERNEL_AUTO &&
+                kernel != next->batch_kernel)
+            logger->Warn("LoadConfiguration: batch kernel '%s' not supported, "
+                "using '%s'", next->batch_name.c_str(),
+                PIDBatch::KernelName(kernel));
+    }
+
+    if (!prev || prev->trace_records != next->trace_records ||
+            prev->trace_file != next->trace_file) {
+        tracer.Close();
+        if (next->trace_records > 0 &&
+                !tracer.Open(next->trace_records, next->trace_file))
+            logger->Warn("LoadConfiguration: cannot open the decision trace "
+                "[%s]", next->trace_file.c_str());
+    }
+
+    if (!prev || prev->record_file != next->record_file ||
+            prev->record_size != next->record_size ||
+            prev->record_files != next->record_files) {
+        recorder.Close();
+        if (!next->record_file.empty() &&
+                !recorder.Open(next->record_file,
+                    uint64_t(next->record_size) << 20, next->record_files))
+            logger->Warn("LoadConfiguration: cannot open the recording "
+                "[%s]", next->record_file.c_str());
+    }
+    if (recorder.Enabled())
+        RecordConfiguration(*next);
+
+    if (!prev || prev->export_shm != next->export_shm ||
+            prev->export_apps != next->export_apps) {
+        exporter.Close();
+        if (!next->export_shm.empty() &&
+                !exporter.Open(next->export_shm, next->export_apps))
+            logger->Warn("LoadConfiguration: cannot create the live export "
+                "[%s]", next->export_shm.c_str());
+    }
+
+    logger->Info("Running with neg_delta=%d, kp=%f, ki=%f, kd=%f, incremental=%d, "
+                 "%d gains overrides, batch kernel=%s",
+                 next->pid.neg_delta, next->pid.kp, next->pid.ki,
+                 next->pid.kd, next->incremental, next->overrides.size(),
+                 next->batch ? PIDBatch::KernelName(engine.Batch().GetKernel()) : "none");
+
+    std::atomic_store(&params, std::shared_ptr<PolicyParams_t const>(next));
+}
+
+bool AdaptiveCPUSchedPol::ConfigurationChanged() {
+    struct stat conf_stat;
+    if (stat(cm.GetConfigurationFile().c_str(), &conf_stat) != 0)
+        return false;
+    return conf_stat.st_mtim.tv_sec != config_mtime.tv_sec ||
+        conf_stat.st_mtim.tv_nsec != config_mtime.tv_nsec;
+}
+
+uint32_t AdaptiveCPUSchedPol::ResolveGroup(bbque::app::AppCPtr_t papp) {
+    if (cfg->groups.members.empty())
+        return 0;
+
+    auto recipe = papp->GetRecipe();
+    return GroupOf(cfg->groups, papp->Name(),
+        recipe ? recipe->Path() : std::string(),
+        cfg->groups.by_user ? ProcessOwner(papp->Pid()) : -1);
+}
+
+bool AdaptiveCPUSchedPol::ResolveLatencyClass(bbque::app::AppCPtr_t papp) {
+    auto recipe = papp->GetRecipe();
+    if (InBurstClass(cfg->burst, papp->Name(),
+            recipe ? recipe->Path() : std::string()))
+        return true;
+    if (!recipe)
+        return false;
+
+    // Recipe: <plugin name="adaptive_cpu"><latency_class>burst</...>
+    auto attr = std::static_pointer_cast<bu::PluginAttr_t>(
+        recipe->GetAttribute(BURST_RECIPE_NS, BURST_RECIPE_KEY));
+    return attr && attr->str == BURST_RECIPE_VALUE;
+}
+
+PIDParams_t const * AdaptiveCPUSchedPol::ResolveGains(
+        bbque::app::AppCPtr_t papp) {
+    if (cfg->overrides.empty())
+        return &cfg->pid;
+
+    auto it = cfg->overrides.find(OVERRIDE_APP_PREFIX + papp->Name());
+    if (it != cfg->overrides.end())
+        return &it->second;
+
+    auto recipe = papp->GetRecipe();
+    if (recipe) {
+        it = cfg->overrides.find(OVERRIDE_RECIPE_PREFIX + recipe->Path());
+        if (it != cfg->overrides.end())
+            return &it->second;
+    }
+    return &cfg->pid;
+}
+
+void AdaptiveCPUSchedPol::InitPlacement() {
+    PlacementEngine::Policy_t policy = cfg->placement;
+    placement.SetPolicy(policy);
+
+    // Every application is placed again in the new view, therefore each
+    // domain starts from its whole processing capacity
+    BindingManager & bdm(BindingManager::GetInstance());
+    BindingMap_t & bindings(bdm.GetBindingDomains());
+    std::vector<int32_t> ids;
+    std::vector<uint64_t> capacities;
+    for (BBQUE_RID_TYPE cpu_id : bindings[br::ResourceType::CPU]->r_ids) {
+        ids.push_back(cpu_id);
+        capacities.push_back(ra.Total(
+            std::string("sys.cpu") + std::to_string(cpu_id) + ".pe"));
+    }
+    placement.Reset(ids, capacities);
+
+    logger->Debug("Init: placement policy '%s' over %d CPU domains",
+        PlacementEngine::PolicyName(policy), ids.size());
 }
 
 
@@ -144,105 +931,26 @@ SchedulerPolicyIF::ExitCode_t AdaptiveCPUSchedPol::_Init() {
 ************ MY CODE*************
 ********************************/
 
-void AdaptiveCPUSchedPol::ComputeQuota(AppInfo_t * ainfo){
-    logger->Info("Computing quota for [%s]", ainfo->papp->StrId());
-    
-    if (!ainfo->papp->Running()){
-    
-        logger->Info("Computing quota first round");
+void AdaptiveCPUSchedPol::ForEachActiveApplication(
+        std::function<void(bbque::app::AppCPtr_t)> func) {
+    AppsUidMapIt app_it;
+    ba::AppCPtr_t app_ptr;
 
-        if (quota_not_run_apps < INITIAL_DEFAULT_QUOTA)
-            ainfo->next_quota = quota_not_run_apps;
-        else           
-            ainfo->next_quota = INITIAL_DEFAULT_QUOTA;
-        
-        ainfo->pawm = std::make_shared<ba::WorkingMode>(
-        ainfo->papp->WorkingModes().size(), "Default", 1, ainfo->papp);
-                 
-        //Set initial integral error
-        ainfo->papp->SetAttribute("ierr",std::to_string(0));
-        
-        //Set initial error for derivative controller
-        ainfo->papp->SetAttribute("derr",std::to_string(0)); 
-        
-        available_cpu -= ainfo->next_quota;
-            
-        logger->Info("Next quota=%d, Previous quota=%d, Previously used CPU=%d, Delta=%d Available cpu=%d",
-            ainfo->next_quota,
-            ainfo->prev_quota,
-            ainfo->prev_used,
-            ainfo->prev_delta,
-            available_cpu);
-        
-        return;
-    }
-    
-    //if cpu_usage==quota we push a forfait delta
-    if (ainfo->prev_used >= ainfo->prev_quota - THRESHOLD){
-        ainfo->prev_delta = neg_delta;
-    }
-    
-    int64_t error, ierr, derr;
-    int64_t cv, pvar, ivar, dvar;
-    
-    //PROPORTIONAL CONTROLLER:
-    error = ADMISSIBLE_DELTA/2 - ainfo->prev_delta;
-    
-    //we are in the admissible range
-    if (abs(error) < ADMISSIBLE_DELTA/2)
-        error = 0;
-    
-    pvar = kp*error;
+    app_ptr = sys->GetFirstRunning(app_it);
+    for (; app_ptr; app_ptr = sys->GetNextRunning(app_it))
+        func(app_ptr);
 
-    //INTEGRAL CONTROLLER
-    ierr = std::stoll(ainfo->papp->GetAttribute("ierr")) + error;
-    ivar = ki*ierr;
-    
-    //DERIVATIVE CONTROLLER
-    derr = error - std::stoll(ainfo->papp->GetAttribute("derr"));
-    dvar = kd*derr;
-    
-    logger->Info("pvar=%d, ivar=%d, dvar=%d", pvar, ivar, dvar);
-    //Compute control variable
-    cv = pvar + ivar + dvar;
-    
-    //check available cpu
-    if (cv > 0)
-       cv = (available_cpu > cv) ? cv : available_cpu;
-    else
-        //reset in case of fault
-        if (abs(cv) > ainfo->prev_quota){
-            logger->Error("App [%s] requires quota lower than zero: resetting to initial default quota", ainfo->papp->StrId());
-            ainfo->next_quota = (available_cpu > INITIAL_DEFAULT_QUOTA) ? INITIAL_DEFAULT_QUOTA : available_cpu;
-        }
-    
-    ainfo->next_quota = ainfo->prev_quota + cv;
-    
-    //Create AWM
-    ainfo->pawm = std::make_shared<ba::WorkingMode>(
-        ainfo->papp->WorkingModes().size(), "Adaptation", 1, ainfo->papp);
-    
-    //Update errors and expected delta
-    ainfo->papp->SetAttribute("ierr",std::to_string(ierr));
-	ainfo->papp->SetAttribute("derr",std::to_string(error)); 
-        
-    //update available cpu
-    if (ainfo->next_quota > ainfo->prev_quota)
-        available_cpu -= ainfo->next_quota - ainfo->prev_quota;
-    else
-        available_cpu += ainfo->prev_quota - ainfo->next_quota;
-    
-    logger->Info("Error = %d, cv=%d",
-                 error,
-                 cv);
-    
-    logger->Info("New settings: Next quota=%d, Previous quota=%d, Previously used CPU=%d, Delta=%d Available cpu=%d",
-            ainfo->next_quota,
-            ainfo->prev_quota,
-            ainfo->prev_used,
-            ainfo->prev_delta,
-            available_cpu);
-    
+    app_ptr = sys->GetFirstReady(app_it);
+    for (; app_ptr; app_ptr = sys->GetNextReady(app_it))
+        func(app_ptr);
+
+    app_ptr = sys->GetFirstThawed(app_it);
+    for (; app_ptr; app_ptr = sys->GetNextThawed(app_it))
+        func(app_ptr);
+
+    app_ptr = sys->GetFirstRestoring(app_it);
+    for (; app_ptr; app_ptr = sys->GetNextRestoring(app_it))
+        func(app_ptr);
 }
 
 AppInfo_t AdaptiveCPUSchedPol::InitializeAppInfo(bbque::app::AppCPtr_t papp){
@@ -250,6 +958,23 @@ AppInfo_t AdaptiveCPUSchedPol::InitializeAppInfo(bbque::app::AppCPtr_t papp){
     
     ainfo.papp = papp;
     ainfo.pawm = papp->CurrentAWM();
+    ainfo.uid = papp->Uid();
+    ainfo.priority = papp->Priority();
+    ainfo.weight = AllocationWeight(papp);
+    // Throttling counters read by the worker threads
+    if (cfg->throttle.enabled)
+        ainfo.cgroup = CgroupPath(cfg->throttle, papp->StrId(),
+            papp->Name(), papp->Pid(), papp->Uid());
+    ainfo.running = papp->Running();
+    ainfo.skip = false;
+    ainfo.reset = false;
+    ainfo.held = false;
+    ainfo.energy = 0;
+    ainfo.latency = false;
+    ainfo.prev_burst = 0;
+    ainfo.burst = 0;
+    ainfo.reclaimed = 0;
+    ainfo.share = 0;
     ainfo.prev_quota = ra.UsedBy(
         "sys.cpu.pe",
         papp,
@@ -257,184 +982,758 @@ AppInfo_t AdaptiveCPUSchedPol::InitializeAppInfo(bbque::app::AppCPtr_t papp){
     auto prof = papp->GetRuntimeProfile();
     ainfo.prev_used = prof.cpu_usage;
     ainfo.prev_delta = ainfo.prev_quota - ainfo.prev_used;
+    ainfo.next_quota = 0;
+    ainfo.booked = 0;
+    ainfo.demand = 0;
+    ainfo.grant = 0;
+    ainfo.gains = ResolveGains(papp);
+    ainfo.params = *ainfo.gains;
+    ainfo.throttle = {false, 0, 0};
+    ainfo.group = ResolveGroup(papp);
+
+    bool created;
+    ainfo.state = &ctrl_states.Get(papp->Uid(), created);
+    if (created)
+        logger->Debug("InitializeAppInfo: [%s] new controller state",
+            papp->StrId());
+    ainfo.state->last_sample = {
+        static_cast<int32_t>(prof.cpu_usage),
+        static_cast<int32_t>(prof.ctime_ms),
+        static_cast<int32_t>(prof.ggap_percent),
+        prof.is_valid };
+    ainfo.state->last_state = papp->State();
+    // Overcommit: only a share of the quota assigned has been booked
+    if (cfg->overcommit.enabled && ainfo.running && !created) {
+        ainfo.prev_quota = ainfo.state->last_quota;
+        ainfo.prev_delta = ainfo.prev_quota - ainfo.prev_used;
+    }
+    ainfo.latency = (cfg->burst.reserve > 0) && ResolveLatencyClass(papp);
+
+    // Cost of the last reconfiguration: a valid profile is back
+    ReconfState_t & rs(ainfo.state->reconf);
+    if (cfg->hysteresis.enabled &&
+            ReconfObserve(rs, cfg->hysteresis, cycle_start_ms,
+                prof.is_valid, prof.ctime_ms))
+        logger->Debug("InitializeAppInfo: [%s] reconfiguration cost "
+            "estimate=%.0f [%d samples]", papp->StrId(), rs.cost,
+            rs.samples);
     
     return ainfo;
 }
-    
 
-SchedulerPolicyIF::ExitCode_t
-AdaptiveCPUSchedPol::AssignWorkingMode(bbque::app::AppCPtr_t papp)
-{  
-    ApplicationManager & am(ApplicationManager::GetInstance());
+void AdaptiveCPUSchedPol::CollectApplications() {
+    app_infos.clear();
 
-    if (papp == nullptr) {
-        logger->Error("AssignWorkingMode: null application descriptor!");
-        return SCHED_ERROR;
-    }
+    ForEachActiveApplication([this](ba::AppCPtr_t papp) {
+        if (papp == nullptr) {
+            logger->Error("CollectApplications: null application descriptor!");
+            return;
+        }
 
-    // Print the run-time profiling info if running
-    if (papp->Running()) {
-        auto prof = papp->GetRuntimeProfile();
-        logger->Info("AssignWorkingMode: [%s] "
-            "cpu_usage=%d c_time=%d, ggap=%d [valid=%d]",
-            papp->StrId(),
-            prof.cpu_usage,
-            prof.ctime_ms,
-            prof.ggap_percent,
-            prof.is_valid);
-    }
-    
-    //it initializes a struct with all the info about the app, to have it in a compact way
-    AppInfo_t ainfo = AdaptiveCPUSchedPol::InitializeAppInfo(papp);
-    
-    logger->Info("Initialized app [%s] info: Previous quota=%d, Previously used CPU=%d, Delta=%d Available cpu=%d",
+        // Incremental mode: keep the current AWM of the unchanged applications
+        if (cfg->incremental && dirty_marked) {
+            bool created;
+            AppCtrlState_t & state(ctrl_states.Get(papp->Uid(), created));
+            if (!created && !state.dirty &&
+                    ResubmitWorkingMode(papp, state) == SCHED_OK)
+                return;
+        }
+
+        //it initializes a struct with all the info about the app, to have it in a compact way
+        app_infos.push_back(InitializeAppInfo(papp));
+
+#ifdef CONFIG_BBQUE_SCHEDPOL_ADAPTIVECPU_APP_LOG
+        // Print the run-time profiling info if running
+        if (papp->Running()) {
+            auto prof = papp->GetRuntimeProfile();
+            APP_LOG("CollectApplications: [%s] "
+                "cpu_usage=%d c_time=%d, ggap=%d [valid=%d]",
+                papp->StrId(),
+                prof.cpu_usage,
+                prof.ctime_ms,
+                prof.ggap_percent,
+                prof.is_valid);
+        }
+
+        AppInfo_t & ainfo(app_infos.back());
+        APP_LOG("Initialized app [%s] info: Previous quota=%d, Previously used CPU=%d, Delta=%d Available cpu=%d",
             papp->StrId(),
             ainfo.prev_quota,
             ainfo.prev_used,
             ainfo.prev_delta,
-            available_cpu);
-    
-    if (quota_not_run_apps == 0 && !ainfo.papp->Running()){
-        logger->Info("AssignWorkingMode: Not enough available resources to schedule [%s]",
-            papp->StrId());
-        return SCHED_SKIP_APP;
+            engine.Available());
+#endif
+    });
+
+    // New controller states may have moved the table storage
+    cycle_apps.clear();
+    for (auto & ainfo : app_infos) {
+        ainfo.state = ctrl_states.Find(ainfo.uid);
+        engine.Collect(ainfo);
+        cycle_apps.push_back(&ainfo);
     }
-        
-    AdaptiveCPUSchedPol::ComputeQuota(&ainfo);
+}
+
+void AdaptiveCPUSchedPol::ConfigureControlLaws() {
+    bool deadband_changed = (law_deadband != cfg->ggap_deadband);
+    law_deadband = cfg->ggap_deadband;
+
+    if (cfg->controller != active_law_name ||
+            (active_law && deadband_changed)) {
+        active_law = MakeControlLaw(cfg->controller, law_deadband);
+        active_law_name = cfg->controller;
+        logger->Info("ConfigureControlLaws: active control law '%s'",
+            active_law ? active_law->Name() : CONTROL_LAW_DEFAULT);
+    }
+
+    if (cfg->shadows != shadow_names || deadband_changed) {
+        std::vector<std::unique_ptr<ControlLaw>> laws;
+        for (auto const & name : cfg->shadows)
+            laws.push_back(MakeControlLaw(name, law_deadband));
+        shadows.Configure(std::move(laws));
+        shadow_names = cfg->shadows;
+        logger->Info("ConfigureControlLaws: %d shadow control laws",
+            shadow_names.size());
+    }
+}
+
+void AdaptiveCPUSchedPol::SubmitShadowInputs() {
+    shadow_inputs.clear();
+    for (auto const & ainfo : app_infos) {
+        if (!ainfo.running || ainfo.skip)
+            continue;
+        shadow_inputs.push_back({LawInput(ainfo, ainfo.params),
+            ainfo.next_quota});
+    }
+    shadows.Submit(ctrl_states.Cycle(), shadow_inputs);
+}
+
+SchedulerPolicyIF::ExitCode_t
+AdaptiveCPUSchedPol::AssignWorkingMode(AppInfo_t & ainfo)
+{  
+    ApplicationManager & am(ApplicationManager::GetInstance());
+    auto papp = ainfo.papp;
+
+    // Reusable AWM of the application
+    AppAwm_t & awm(app_awms[papp->Uid()]);
+    if (awm.pawm == nullptr) {
+        awm.pawm = std::make_shared<ba::WorkingMode>(
+            papp->WorkingModes().size(),
+            ainfo.running ? "Adaptation" : "Default", 1, papp);
+        awm.quota = 0;
+        awm.cpu_id = CTRL_NO_BINDING;
+        awm.ref_num = -1;
+        logger->Debug("AssignWorkingMode: [%s] new AWM", papp->StrId());
+    }
+    ainfo.pawm = awm.pawm;
     
     auto pawm = ainfo.pawm;
     
-    pawm->AddResourceRequest(
-        "sys.cpu.pe",
-        ainfo.next_quota,
-        br::ResourceAssignment::Policy::SEQUENTIAL);
+    // Update the request in place, only if the quota changed
+    if (awm.quota != ainfo.booked || awm.ref_num < 0) {
+        pawm->ClearResourceRequests();
+        pawm->AddResourceRequest(
+            "sys.cpu.pe",
+            ainfo.booked,
+            br::ResourceAssignment::Policy::SEQUENTIAL);
+        pawm->ClearSchedResourceBinding();
+        awm.quota = ainfo.booked;
+        awm.cpu_id = CTRL_NO_BINDING;
+        awm.ref_num = -1;
+    }
     
-    // Look for the first available CPU
-    BindingManager & bdm(BindingManager::GetInstance());
-    BindingMap_t & bindings(bdm.GetBindingDomains());
-    auto & cpu_ids(bindings[br::ResourceType::CPU]->r_ids);
+    // CPU domains in order of preference
+    int32_t prev_binding = ainfo.running ?
+        ainfo.state->last_binding : CTRL_NO_BINDING;
+    placement.Candidates(ainfo.booked, prev_binding, cpu_ids);
     
     for (BBQUE_RID_TYPE cpu_id : cpu_ids) {
-        logger->Info("AssingWorkingMode: [%s] binding attempt CPU id = %d",
+        APP_LOG("AssingWorkingMode: [%s] binding attempt CPU id = %d",
         papp->StrId(), cpu_id);
         
         
-        // CPU binding
+        // CPU binding (kept if unchanged)
 
-        int32_t ref_num = -1;
-        ref_num = pawm->BindResource(br::ResourceType::CPU, R_ID_ANY, cpu_id, ref_num);
+        int32_t ref_num = awm.ref_num;
+        if (static_cast<int32_t>(cpu_id) != awm.cpu_id) {
+            Timer bind_timer;
+            bind_timer.start();
+            pawm->ClearSchedResourceBinding();
+            awm.cpu_id = CTRL_NO_BINDING;
+            awm.ref_num = -1;
+            ref_num = pawm->BindResource(br::ResourceType::CPU, R_ID_ANY, cpu_id, -1);
+            binding_ms += bind_timer.getElapsedTimeMs();
+        }
 
         if (ref_num < 0) {
             logger->Error("AssingWorkingMode: [%s] CPU binding to < %d > failed",
                 papp->StrId(), cpu_id);
+            mc.Count(coll_metrics[ACPU_BINDING_FAILURES].mh);
             continue;
         }
+        awm.cpu_id = cpu_id;
+        awm.ref_num = ref_num;
         
         // Schedule request
         ApplicationManager::ExitCode_t am_ret;
+        Timer req_timer;
+        req_timer.start();
         am_ret = am.ScheduleRequest(papp, pawm, sched_status_view, ref_num);
+        sched_request_ms += req_timer.getElapsedTimeMs();
         if (am_ret != ApplicationManager::AM_SUCCESS) {
             logger->Error("AssignWorkingMode: [%s] schedule request failed",
                 papp->StrId());
+            mc.Count(coll_metrics[ACPU_SCHED_REQUEST_FAILURES].mh);
             continue;
         }
         
+        if (placement.Commit(cpu_id, ainfo.booked, prev_binding))
+            logger->Debug("AssignWorkingMode: [%s] migrated from CPU %d "
+                "to CPU %d", papp->StrId(), prev_binding, cpu_id);
+        ainfo.state->last_binding = cpu_id;
+        ainfo.state->last_ref_num = ref_num;
+        if (cfg->hysteresis.enabled && ainfo.running &&
+                ainfo.next_quota != ainfo.prev_quota) {
+            ProfileSample_t const & sample(ainfo.state->last_sample);
+            ReconfRequested(ainfo.state->reconf, HysteresisNow(),
+                ainfo.prev_used, sample.is_valid ? sample.ctime_ms : 0);
+        }
         return SCHED_OK;
     }
     
-    return SCHED_ERROR;
+    return SCHED_SKIP_APP;
 
 }
 
-SchedulerPolicyIF::ExitCode_t 
-AdaptiveCPUSchedPol::ScheduleApplications(std::function
-<SchedulerPolicyIF::ExitCode_t(bbque::app::AppCPtr_t) > do_func)
-{
-            
-    AppsUidMapIt app_it;
-    ba::AppCPtr_t app_ptr;
+SchedulerPolicyIF::ExitCode_t
+AdaptiveCPUSchedPol::ResubmitWorkingMode(
+        bbque::app::AppCPtr_t papp, AppCtrlState_t & state) {
+    ApplicationManager & am(ApplicationManager::GetInstance());
 
-    //Fair alternative among not running applications
-    app_ptr = sys->GetFirstRunning(app_it);
-    for (; app_ptr; app_ptr = sys->GetNextRunning(app_it)) {
-            do_func(app_ptr);
+    auto pawm = papp->CurrentAWM();
+    if (pawm == nullptr || state.last_ref_num < 0)
+        return SCHED_ERROR;
+
+    ApplicationManager::ExitCode_t am_ret;
+    am_ret = am.ScheduleRequest(
+        papp, pawm, sched_status_view, state.last_ref_num);
+    if (am_ret != ApplicationManager::AM_SUCCESS) {
+        logger->Warn("ResubmitWorkingMode: [%s] schedule request failed",
+            papp->StrId());
+        return SCHED_ERROR;
     }
-    
-    if (nr_not_run_apps != 0)
-        quota_not_run_apps = available_cpu / nr_not_run_apps;
-    
-    app_ptr = sys->GetFirstReady(app_it);
-    for (; app_ptr; app_ptr = sys->GetNextReady(app_it)) {
-            do_func(app_ptr);
+
+    placement.Commit(state.last_binding, state.last_quota, state.last_binding);
+    logger->Debug("ResubmitWorkingMode: [%s] unchanged, quota=%d",
+        papp->StrId(), state.last_quota);
+    return SCHED_OK;
+}
+
+int32_t AdaptiveCPUSchedPol::MarkDirtyApplications() {
+    int32_t nr_dirty = 0;
+    uint32_t nr_visited = 0;
+
+    auto mark = [&](ba::AppCPtr_t papp) {
+        ++nr_visited;
+        AppCtrlState_t * state = ctrl_states.Find(papp->Uid());
+        if (state == nullptr) {
+            ++nr_dirty;
+            return;
+        }
+
+        auto prof = papp->GetRuntimeProfile();
+        ProfileSample_t sample = {
+            static_cast<int32_t>(prof.cpu_usage),
+            static_cast<int32_t>(prof.ctime_ms),
+            static_cast<int32_t>(prof.ggap_percent),
+            prof.is_valid };
+
+        state->dirty =
+            !papp->Running() ||
+            state->last_state != papp->State() ||
+            !(state->last_sample == sample) ||
+            state->last_error != 0 ||
+            state->last_cv != 0;
+        if (state->dirty)
+            ++nr_dirty;
+    };
+
+    ForEachActiveApplication(mark);
+
+    // Some applications left the system
+    if (nr_visited != ctrl_states.Size())
+        return -1;
+
+    return nr_dirty;
+}
+
+PowerSample_t AdaptiveCPUSchedPol::SamplePower() {
+    // Zones discovered again only if the root changed
+    if (engine.QuotaCap() == 0 || power_meter.Root() != cfg->power.root) {
+        size_t nr_zones = power_meter.Open(cfg->power.root);
+        if (nr_zones == 0)
+            logger->Warn("SamplePower: no readable RAPL package zone in [%s]",
+                cfg->power.root.c_str());
+        else
+            logger->Info("SamplePower: %d RAPL package zones in [%s]",
+                nr_zones, cfg->power.root.c_str());
+        engine.SetQuotaCap(ra.Total("sys.cpu.pe"));
     }
 
-    app_ptr = sys->GetFirstThawed(app_it);
-    for (; app_ptr; app_ptr = sys->GetNextThawed(app_it)) {
-            do_func(app_ptr);
+    // Not valid at the first reading: the cap of the last cycle is kept
+    PowerSample_t sample(power_meter.Sample());
+    if (sample.valid)
+        mc.AddSample(coll_metrics[ACPU_NODE_POWER].mh, sample.power);
+    logger->Debug("SamplePower: power=%.1f W budget=%.1f W energy=%.2f J",
+        sample.power, cfg->power.budget, sample.energy);
+    return sample;
+}
+
+void AdaptiveCPUSchedPol::ReportReconciliation() {
+    CycleStats_t const & stats(engine.Stats());
+    mc.AddSample(coll_metrics[ACPU_RUN_PASS_TIME].mh, stats.run_pass_ms);
+    mc.AddSample(coll_metrics[ACPU_NOT_RUN_PASS_TIME].mh,
+        stats.not_run_pass_ms);
+
+    uint64_t capacity = ra.Total("sys.cpu.pe");
+    if (cfg->overcommit.enabled && capacity > 0) {
+        OvercommitBudget_t const & budget(stats.overcommit);
+        logger->Debug("SizeOvercommit: capacity=%d used=%d quotas=%d "
+            "demand=%d limit=%d%s", capacity, stats.used, budget.quota,
+            budget.demand, budget.limit,
+            stats.overcommit_pressure ? " [pressure]" : "");
+        if (stats.overcommit_excess > 0) {
+            logger->Info("ReclaimOvercommit: usage close to the capacity, "
+                "reclaiming %d", stats.overcommit_excess);
+            mc.Count(coll_metrics[ACPU_OVERCOMMIT_RECLAIMS].mh);
+        }
     }
 
-    app_ptr = sys->GetFirstRestoring(app_it);
-    for (; app_ptr; app_ptr = sys->GetNextRestoring(app_it)) {
-            do_func(app_ptr);
+    if (cfg->power.budget > 0) {
+        logger->Debug("LimitPower: cap=%d held=%d", engine.QuotaCap(),
+            stats.power_held);
+        if (stats.power_excess > 0)
+            mc.Count(coll_metrics[ACPU_POWER_RECLAIMS].mh);
     }
-    
-    return SCHED_OK;
-    
-    //Other alternative: assign quota>0 only to the number of apps s.t. quota_not_run_apps>=MIN_ASSIGNABLE_QUOTA
-    //comment above and uncomment here if preferred
-    /*AppsUidMapIt app_it;
-    ba::AppCPtr_t app_ptr;
-    
-    app_ptr = sys->GetFirstRunning(app_it);
-    for (; app_ptr; app_ptr = sys->GetNextRunning(app_it)) {
-            do_func(app_ptr);
+
+    if (cfg->burst.reserve > 0 && stats.burst_reserve < cfg->burst.reserve)
+        logger->Debug("CarveBurstReserve: reserve=%d of %d",
+            stats.burst_reserve, cfg->burst.reserve);
+
+    auto const & specs(cfg->groups.groups);
+    auto const & groups(engine.Groups());
+    for (size_t g = 0; g < groups.size(); ++g) {
+        CycleGroup_t const & group(groups[g]);
+        if (group.apps == 0)
+            continue;
+        logger->Debug("ReconcileGroups: [%s] guaranteed=%d held=%d budget=%d "
+            "borrowed=%d assigned=%d", specs[g].name.c_str(),
+            specs[g].guaranteed, group.held, group.budget, group.borrowed,
+            group.assigned);
     }
-    
-    if (nr_not_run_apps != 0){
-        
-        quota_not_run_apps = available_cpu / nr_not_run_apps;
-        
-        uint64_t nr_schedulable_app;
-        nr_schedulable_app = nr_not_run_apps;
-        
-        if (available_cpu < MIN_ASSIGNABLE_QUOTA)
-            nr_schedulable_app = 0;
-        
-        else if (quota_not_run_apps < MIN_ASSIGNABLE_QUOTA)
-            while (quota_not_run_apps < MIN_ASSIGNABLE_QUOTA){
-                nr_schedulable_app--;
-                quota_not_run_apps = available_cpu / nr_schedulable_app;
-            }
-        
-        app_ptr = sys->GetFirstReady(app_it);
-        for (; app_ptr; app_ptr = sys->GetNextReady(app_it)) {
-            if (nr_schedulable_app == 0)
-                quota_not_run_apps = 0;
-            else 
-                nr_schedulable_app--;
-            do_func(app_ptr);
+
+    if (stats.not_reclaimed > 0)
+        logger->Warn("ReportReconciliation: %d not reclaimed",
+            stats.not_reclaimed);
+}
+
+void AdaptiveCPUSchedPol::ScaleBookings(uint64_t capacity) {
+    if (!cfg->overcommit.enabled) {
+        for (auto & ainfo : app_infos)
+            ainfo.booked = ainfo.next_quota;
+        return;
+    }
+
+    uint64_t assigned = OvercommitBookings(cycle_apps, capacity);
+    if (assigned > capacity)
+        logger->Debug("ScaleBookings: quotas=%d booked within %d",
+            assigned, capacity);
+}
+
+void AdaptiveCPUSchedPol::ReportApplication(AppInfo_t const & ainfo) {
+    if (ainfo.skip) {
+        if (cfg->admission_queue && !cfg->fair_allocation)
+            logger->Info("AdmitApplications: [%s] queued, waiting since %d "
+                "cycles", ainfo.papp->StrId(),
+                engine.Admission().Waited(ainfo.uid));
+        else
+            logger->Info("ScheduleApplications: Not enough available "
+                "resources to schedule [%s]", ainfo.papp->StrId());
+        return;
+    }
+    if (ainfo.reset)
+        logger->Error("App [%s] requires quota lower than zero: resetting to initial default quota", ainfo.papp->StrId());
+    if (ainfo.reclaimed > 0)
+        logger->Info("ScheduleApplications: [%s] quota reclaimed=%d, "
+            "next quota=%d", ainfo.papp->StrId(), ainfo.reclaimed,
+            ainfo.next_quota);
+    if (ainfo.burst > 0 && ainfo.prev_burst == 0)
+        logger->Debug("GrantBursts: [%s] burst started, credit=%d",
+            ainfo.papp->StrId(), ainfo.state->burst.credit + ainfo.burst);
+
+    APP_LOG("Computed quota for [%s]", ainfo.papp->StrId());
+    if (ainfo.running) {
+        PIDOutput_t const & out(ainfo.ctrl);
+        APP_LOG("pvar=%d, ivar=%d, dvar=%d, ffvar=%d",
+            out.pvar, out.ivar, out.dvar, out.ffvar);
+        if (ainfo.throttle.valid)
+            APP_LOG("throttled periods=%.3f, stall=%.3f, neg_delta=%d",
+                ainfo.throttle.throttled_periods, ainfo.throttle.stall,
+                ainfo.params.neg_delta);
+        if (ainfo.held)
+            APP_LOG("Quota change held, gain=%.0f, cost=%.0f",
+                ainfo.state->reconf.accrued,
+                ReconfCost(ainfo.state->reconf, cfg->hysteresis));
+        APP_LOG("Error = %d, cv=%d", out.error, out.cv);
+    }
+    if (ainfo.burst > 0)
+        APP_LOG("Burst=%d, credit=%d", ainfo.burst,
+            ainfo.state->burst.credit);
+    APP_LOG("New settings: Next quota=%d, Previous quota=%d, Previously used CPU=%d, Delta=%d",
+            ainfo.next_quota,
+            ainfo.prev_quota,
+            ainfo.prev_used,
+            ainfo.prev_delta);
+}
+
+void AdaptiveCPUSchedPol::LogGainsReport() {
+    logger->Info("Auto-tuning report: %d applications", ctrl_states.Size());
+    logger->Info("%8s %8s %8s %8s %8s %8s %8s",
+        "uid", "K", "noise", "samples", "kp", "ki", "kd");
+    for (auto const & state : ctrl_states) {
+        TunerState_t const & ts(state.tuner);
+        if (ts.samples < TUNER_MIN_SAMPLES) {
+            logger->Info("%8d %8.3f %8.2f %8d %8s %8s %8s",
+                state.uid, ts.gain, ts.noise, ts.samples,
+                "default", "default", "default");
+            continue;
         }
+        logger->Info("%8d %8.3f %8.2f %8d %8.3f %8.3f %8.3f",
+            state.uid, ts.gain, ts.noise, ts.samples, ts.kp, ts.ki, ts.kd);
+    }
+}
+
+void AdaptiveCPUSchedPol::LogShadowReport() {
+    std::vector<ShadowStats_t> stats;
+    uint64_t dropped = shadows.Stats(stats);
+    logger->Info("Shadow control laws report: active '%s', %d cycles "
+        "dropped", active_law ? active_law->Name() : CONTROL_LAW_DEFAULT,
+        dropped);
+    logger->Info("%8s %8s %10s %10s %10s %10s %10s",
+        "law", "cycles", "diverg", "max_diverg", "waste", "act_waste",
+        "shortfall");
+    for (auto const & s : stats) {
+        // Per application and cycle
+        double samples = (s.samples > 0) ? s.samples : 1;
+        double projected = (s.projected > 0) ? s.projected : 1;
+        logger->Info("%8s %8d %10.2f %10d %10.2f %10.2f %10.2f",
+            s.name.c_str(), s.cycles, s.divergence / samples,
+            s.max_divergence, s.waste / projected,
+            s.active_waste / projected, s.shortfall / projected);
+    }
+}
+
+void AdaptiveCPUSchedPol::CollectAppMetrics(
+        AppInfo_t const & ainfo, ExitCode_t result) {
+    if (result == SCHED_SKIP_APP)
+        mc.Count(coll_metrics[ACPU_SKIP_APP].mh);
+    if (ainfo.reset)
+        mc.Count(coll_metrics[ACPU_QUOTA_RESETS].mh);
+    if (ainfo.held)
+        mc.Count(coll_metrics[ACPU_QUOTA_HELD].mh);
+    if (ainfo.burst > 0 && ainfo.prev_burst == 0)
+        mc.Count(coll_metrics[ACPU_BURSTS].mh);
+    if (!ainfo.running)
+        return;
+
+    mc.AddSample(coll_metrics[ACPU_CONTROL_ERROR].mh, ainfo.ctrl.error);
+    mc.AddSample(coll_metrics[ACPU_UNUSED_QUOTA].mh,
+        (ainfo.prev_quota > ainfo.prev_used) ?
+            ainfo.prev_quota - ainfo.prev_used : 0);
+    if (cfg->power.budget > 0)
+        mc.AddSample(coll_metrics[ACPU_APP_ENERGY].mh, ainfo.energy);
+}
+
+void AdaptiveCPUSchedPol::TraceDecision(
+        AppInfo_t const & ainfo, bool assigned) {
+    TraceRecord_t rec;
+    rec.cycle = ctrl_states.Cycle();
+    rec.uid = ainfo.uid;
+    rec.binding = assigned ? ainfo.state->last_binding : CTRL_NO_BINDING;
+    rec.prev_used = ainfo.prev_used;
+    rec.prev_quota = ainfo.prev_quota;
+    if (ainfo.running) {
+        rec.error = ainfo.ctrl.error;
+        rec.pvar = ainfo.ctrl.pvar;
+        rec.ivar = ainfo.ctrl.ivar;
+        rec.dvar = ainfo.ctrl.dvar;
+        rec.cv = ainfo.ctrl.cv;
+    }
+    else {
+        rec.error = rec.pvar = rec.ivar = rec.dvar = rec.cv = 0;
+    }
+    rec.next_quota = ainfo.next_quota;
+    rec.flags =
+        (ainfo.running ? TRACE_RUNNING : 0) |
+        (ainfo.skip ? TRACE_SKIPPED : 0) |
+        (ainfo.reset ? TRACE_RESET : 0) |
+        (!ainfo.skip && !assigned ? TRACE_BIND_FAILED : 0);
+    rec.reserved = 0;
+    tracer.Record(rec);
+}
+
+void AdaptiveCPUSchedPol::RecordConfiguration(PolicyParams_t const & p) {
+    RecordConfig_t rc;
+    rc.neg_delta = p.pid.neg_delta;
+    rc.kp = p.pid.kp;
+    rc.ki = p.pid.ki;
+    rc.kd = p.pid.kd;
+    rc.control_mode = p.control_mode;
+    rc.ggap_deadband = p.ggap_deadband;
+    rc.flags =
+        (p.fair_allocation ? RECORD_CFG_FAIR : 0) |
+        (p.fair_weighted ? RECORD_CFG_FAIR_WEIGHTED : 0) |
+        (p.admission_queue ? RECORD_CFG_ADMISSION_QUEUE : 0) |
+        (p.autotune ? RECORD_CFG_AUTOTUNE : 0) |
+        (p.incremental ? RECORD_CFG_INCREMENTAL : 0) |
+        (!p.groups.groups.empty() ? RECORD_CFG_GROUPS : 0) |
+        (p.hysteresis.enabled ? RECORD_CFG_HYSTERESIS : 0) |
+        (p.overcommit.enabled ? RECORD_CFG_OVERCOMMIT : 0) |
+        (p.power.budget > 0 ? RECORD_CFG_POWER : 0) |
+        (p.controller != CONTROL_LAW_DEFAULT ? RECORD_CFG_CONTROL_LAW : 0) |
+        (p.burst.reserve > 0 ? RECORD_CFG_BURST : 0);
+    rc.forecast_method = p.forecast.method;
+    rc.forecast_alpha = p.forecast.alpha;
+    rc.forecast_beta = p.forecast.beta;
+    rc.kalman_q = p.forecast.kalman_q;
+    rc.kalman_r = p.forecast.kalman_r;
+    rc.forecast_confidence = p.forecast.confidence;
+    rc.forecast_ff_gain = p.forecast.ff_gain;
+    rc.forecast_max_headroom = p.forecast.max_headroom;
+    rc.admission_min_quota = p.admission.min_quota;
+    rc.admission_max_quota = p.admission.max_quota;
+    rc.admission_default_quota = p.admission.default_quota;
+    rc.admission_aging = p.admission.aging;
+    rc.nr_groups = p.groups.groups.size();
+    rc.hysteresis_grow = p.hysteresis.grow;
+    rc.hysteresis_shrink = p.hysteresis.shrink;
+    rc.hysteresis_max_hold = p.hysteresis.max_hold;
+    rc.reconf_cost = p.hysteresis.default_cost;
+    rc.reconf_alpha = p.hysteresis.alpha;
+    rc.overcommit_risk = p.overcommit.risk;
+    rc.overcommit_max_ratio = p.overcommit.max_ratio;
+    rc.overcommit_reclaim = p.overcommit.reclaim;
+    rc.power_budget = p.power.budget;
+    rc.power_gain = p.power.gain;
+    rc.power_min_ratio = p.power.min_ratio;
+    rc.power_shrink = p.power.shrink;
+    rc.burst_earn = p.burst.earn;
+    rc.burst_reserve = p.burst.reserve;
+    rc.burst_max_credit = p.burst.max_credit;
+    rc.burst_step = p.burst.step;
+
+    std::vector<RecordGroup_t> groups;
+    for (auto const & spec : p.groups.groups)
+        groups.push_back({spec.guaranteed, spec.max, spec.weight, 0});
+    if (!recorder.Config(ctrl_states.Cycle(), rc, groups.data()))
+        logger->Warn("RecordConfiguration: configuration not recorded");
+}
+
+void AdaptiveCPUSchedPol::RecordApplication(
+        AppInfo_t const & ainfo, bool assigned, RecordApp_t & rec) {
+    ProfileSample_t const & sample(ainfo.state->last_sample);
+    rec.uid = ainfo.uid;
+    rec.state = static_cast<uint16_t>(ainfo.state->last_state);
+    rec.flags =
+        (ainfo.running ? RECORD_RUNNING : 0) |
+        (sample.is_valid ? RECORD_PROFILE_VALID : 0) |
+        (ainfo.skip ? RECORD_SKIPPED : 0) |
+        (ainfo.reset ? RECORD_RESET : 0) |
+        (assigned ? RECORD_SCHEDULED : 0) |
+        (ainfo.latency ? RECORD_LATENCY : 0);
+    rec.priority = ainfo.priority;
+    rec.binding = assigned ? ainfo.state->last_binding : CTRL_NO_BINDING;
+    rec.quota = ainfo.prev_quota + ainfo.prev_burst;
+    rec.cpu_usage = sample.cpu_usage;
+    rec.ctime_ms = sample.ctime_ms;
+    rec.ggap_percent = sample.ggap_percent;
+    rec.neg_delta = ainfo.params.neg_delta;
+    rec.kp = ainfo.params.kp;
+    rec.ki = ainfo.params.ki;
+    rec.kd = ainfo.params.kd;
+    rec.reserved = 0;
+    rec.pid = ainfo.pid_in;
+    rec.ggap_pid = ainfo.ggap_in;
+    rec.cv = ainfo.running ? ainfo.ctrl.cv : 0;
+    rec.next_quota = ainfo.next_quota;
+    rec.group = ainfo.group;
+    rec.weight = ainfo.weight;
+    rec.burst_credit = ainfo.burst_in.credit;
+    rec.burst_borrowed = ainfo.burst_in.borrowed;
+    rec.reconf_cost = ainfo.reconf_in.cost;
+    rec.reconf_samples = ainfo.reconf_in.samples;
+    rec.reconf_direction = ainfo.reconf_in.direction;
+    rec.reconf_accrued = ainfo.reconf_in.accrued;
+    rec.reconf_held = ainfo.reconf_in.held;
+    rec.reserved2 = 0;
+}
+
+void AdaptiveCPUSchedPol::ExportApplication(
+        AppInfo_t const & ainfo, bool assigned, ExportApp_t & exp) {
+    std::string const & name(ainfo.papp->Name());
+    exp.uid = ainfo.uid;
+    exp.pid = ainfo.papp->Pid();
+    size_t len = std::min(name.size(), sizeof(exp.name) - 1);
+    memcpy(exp.name, name.c_str(), len);
+    exp.name[len] = '\0';
+    exp.state = static_cast<uint16_t>(ainfo.state->last_state);
+    exp.flags =
+        (ainfo.running ? EXPORT_RUNNING : 0) |
+        (ainfo.skip ? EXPORT_SKIPPED : 0) |
+        (ainfo.reset ? EXPORT_RESET : 0) |
+        (!ainfo.skip && !assigned ? EXPORT_BIND_FAILED : 0) |
+        (ainfo.throttle.valid && ainfo.throttle.throttled_periods > 0 ?
+            EXPORT_THROTTLED : 0) |
+        (ainfo.burst > 0 ? EXPORT_BURST : 0);
+    exp.priority = ainfo.priority;
+    exp.binding = assigned ? ainfo.state->last_binding : CTRL_NO_BINDING;
+    exp.group = ainfo.group;
+    exp.quota = ainfo.prev_quota;
+    exp.used = ainfo.prev_used;
+    exp.next_quota = ainfo.next_quota;
+    if (ainfo.running) {
+        exp.error = ainfo.ctrl.error;
+        exp.pvar = ainfo.ctrl.pvar;
+        exp.ivar = ainfo.ctrl.ivar;
+        exp.dvar = ainfo.ctrl.dvar;
+        exp.ffvar = ainfo.ctrl.ffvar;
+        exp.cv = ainfo.ctrl.cv;
+    }
+    else {
+        exp.error = exp.pvar = exp.ivar = exp.dvar = exp.ffvar = exp.cv = 0;
+    }
+    exp.ierr = ainfo.state->pid.ierr;
+    exp.derr = ainfo.state->pid.derr;
+    exp.neg_delta = ainfo.params.neg_delta;
+    exp.kp = ainfo.params.kp;
+    exp.ki = ainfo.params.ki;
+    exp.kd = ainfo.params.kd;
+    exp.stall = ainfo.throttle.valid ? ainfo.throttle.stall : 0;
+    exp.energy = ainfo.energy;
+}
+
+float AdaptiveCPUSchedPol::AllocationWeight(bbque::app::AppCPtr_t papp) {
+    if (!cfg->fair_weighted)
+        return 1.0;
+    // Priority 0 is the highest one
+    return 1.0 + sys->ApplicationLowestPriority() - papp->Priority();
+}
+
+SchedulerPolicyIF::ExitCode_t 
+AdaptiveCPUSchedPol::ScheduleApplications()
+{
+    Timer timer;
+    uint64_t cycle_available_cpu = available_cpu;
+
+    // Phase 1: control actions of the running applications
+    ConfigureControlLaws();
+    uint64_t capacity = ra.Total("sys.cpu.pe");
+    engine.Begin(*cfg, ctrl_states.Cycle(), available_cpu, capacity,
+        cycle_period_ms);
+    engine.SetControlLaw(active_law.get());
+    ExportCycle_t & exp_cycle(exporter.Cycle());
+    timer.start();
+    CollectApplications();
+    exp_cycle.collect_ms = timer.getElapsedTimeMs();
+    mc.AddSample(coll_metrics[ACPU_COLLECT_TIME].mh, exp_cycle.collect_ms);
+    timer.start();
+    engine.Control(cycle_apps);
+    exp_cycle.control_ms = timer.getElapsedTimeMs();
+    mc.AddSample(coll_metrics[ACPU_CONTROL_TIME].mh, exp_cycle.control_ms);
+
+    // Phase 2: budget reconciliation
+    timer.start();
+    PowerSample_t power = {false, 0, 0};
+    if (cfg->power.budget > 0)
+        power = SamplePower();
+    uint64_t power_cap = engine.QuotaCap();
+    engine.Reconcile(cycle_apps, power);
+    ReportReconciliation();
+    ScaleBookings(capacity);
+    exp_cycle.reconcile_ms = timer.getElapsedTimeMs();
+
+    if (cfg->autotune && cfg->autotune_report > 0 &&
+            ctrl_states.Cycle() % cfg->autotune_report == 0)
+        LogGainsReport();
 
-        app_ptr = sys->GetFirstThawed(app_it);
-        for (; app_ptr; app_ptr = sys->GetNextThawed(app_it)) {
-            if (nr_schedulable_app == 0)
-                quota_not_run_apps = 0;
-            else 
-                nr_schedulable_app--;
-            do_func(app_ptr);
+    // Recording: the frame is filled in place with the decisions
+    RecordDomain_t * rec_domains = nullptr;
+    RecordApp_t * rec_apps = nullptr;
+    bool recording = false;
+    if (recorder.Enabled()) {
+        RecordCycle_t info = {cycle_available_cpu,
+            static_cast<uint32_t>(placement.DomainsCount()),
+            static_cast<uint32_t>(app_infos.size()), nr_not_run_apps,
+            power.valid ? RECORD_CYCLE_POWER_VALID : 0u, capacity,
+            cycle_period_ms, power_cap, power.energy, power.power};
+        recording = recorder.BeginCycle(
+            ctrl_states.Cycle(), info, rec_domains, rec_apps);
+        for (size_t i = 0; recording && i < info.nr_domains; ++i)
+            rec_domains[i] = {placement.DomainId(i), 0,
+                placement.DomainCapacity(i)};
+    }
+
+    // Phase 3: schedule requests
+    binding_ms = 0;
+    sched_request_ms = 0;
+    for (size_t i = 0; i < app_infos.size(); ++i) {
+        AppInfo_t & ainfo(app_infos[i]);
+        ExitCode_t result = SCHED_SKIP_APP;
+        ReportApplication(ainfo);
+        if (!ainfo.skip) {
+            result = AssignWorkingMode(ainfo);
+            if (result != SCHED_OK)
+                logger->Warn("ScheduleApplications: [%s] not scheduled",
+                    ainfo.papp->StrId());
         }
+        CollectAppMetrics(ainfo, result);
+        if (tracer.Enabled())
+            TraceDecision(ainfo, result == SCHED_OK);
+        if (recording)
+            RecordApplication(ainfo, result == SCHED_OK, rec_apps[i]);
+        ExportApp_t * exp = exporter.App(i);
+        if (exp != nullptr)
+            ExportApplication(ainfo, result == SCHED_OK, *exp);
+    }
+    if (recording)
+        recorder.Commit();
 
-        app_ptr = sys->GetFirstRestoring(app_it);
-        for (; app_ptr; app_ptr = sys->GetNextRestoring(app_it)) {
-            if (nr_schedulable_app == 0)
-                quota_not_run_apps = 0;
-            else 
-                nr_schedulable_app--;
-            do_func(app_ptr);
+    // Shadow control laws: evaluated off the scheduling path
+    if (shadows.Enabled()) {
+        SubmitShadowInputs();
+        if (cfg->shadow_report > 0 &&
+                ctrl_states.Cycle() % cfg->shadow_report == 0)
+            LogShadowReport();
+    }
+
+    if (exporter.Enabled()) {
+        exp_cycle.cycle = ctrl_states.Cycle();
+        exp_cycle.total_cpu = capacity;
+        exp_cycle.available_cpu = cycle_available_cpu;
+        exp_cycle.unbooked_cpu = engine.Available();
+        exp_cycle.booked_cpu = 0;
+        exp_cycle.nr_running = 0;
+        exp_cycle.nr_skipped = 0;
+        for (auto const & ainfo : app_infos) {
+            exp_cycle.booked_cpu += ainfo.booked;
+            exp_cycle.nr_running += ainfo.running ? 1 : 0;
+            exp_cycle.nr_skipped += ainfo.skip ? 1 : 0;
         }
     }
+    mc.AddSample(coll_metrics[ACPU_BINDING_TIME].mh, binding_ms);
+    mc.AddSample(coll_metrics[ACPU_SCHED_REQUEST_TIME].mh, sched_request_ms);
 
-    return SCHED_OK;*/
+    return SCHED_OK;
 }
 
 /********************************
@@ -449,9 +1748,45 @@ AdaptiveCPUSchedPol::Schedule(
 
     // Class providing query functions for applications and resources
     sys = &system;
+    Timer cycle_timer;
+    cycle_timer.start();
+
+    // Time elapsed since the previous cycle (quota hysteresis)
+    uint64_t now_ms = HysteresisNow();
+    cycle_period_ms = (cycle_start_ms > 0) ? now_ms - cycle_start_ms : 0;
+    cycle_start_ms = now_ms;
+
+    // Configuration: parsed once, then again only if the file changed. A
+    // reload invalidates the previous resource view.
+    if (!params) {
+        LoadConfiguration();
+    }
+    else if (params->config_reload && ConfigurationChanged()) {
+        LoadConfiguration();
+        last_status_view_valid = false;
+    }
+    cfg = std::atomic_load(&params);
+
+    // Incremental mode: nothing changed, keep the previous resource view
+    dirty_marked = false;
+    if (cfg->incremental && last_status_view_valid) {
+        int32_t nr_dirty = MarkDirtyApplications();
+        dirty_marked = true;
+        if (nr_dirty == 0) {
+            logger->Debug("Schedule: no application changed, "
+                "keeping resource status view = %ld", last_status_view);
+            status_view = last_status_view;
+            PublishCycle(cycle_timer.getElapsedTimeMs(), true);
+            return SCHED_DONE;
+        }
+        logger->Debug("Schedule: %d applications changed", nr_dirty);
+    }
 
     // Initialization
+    Timer timer;
+    timer.start();
     auto result = Init();
+    mc.AddSample(coll_metrics[ACPU_INIT_TIME].mh, timer.getElapsedTimeMs());
     if (result != SCHED_OK) {
         logger->Fatal("Schedule: initialization failed");
         return SCHED_ERROR;
@@ -460,38 +1795,53 @@ AdaptiveCPUSchedPol::Schedule(
             sched_status_view);	
     }
 
-    /** 
-    * INSERT YOUR CODE HERE
-    **/
-    
-    
-    /*auto assign_awm = std::bind(
-        static_cast<ExitCode_t (AdaptiveCPUSchedPol::*)(ba::AppCPtr_t)>
-        (&AdaptiveCPUSchedPol::AssignWorkingMode),
-        this, _1);
-    
-    result = ForEachApplicationToScheduleDo(assign_awm);
-    if (result != SCHED_OK)
-        return result;
-    */
-    
-    auto assign_awm = std::bind(
-        static_cast<ExitCode_t (AdaptiveCPUSchedPol::*)(ba::AppCPtr_t)>
-        (&AdaptiveCPUSchedPol::AssignWorkingMode),
-        this, _1);
-    
-    result = AdaptiveCPUSchedPol::ScheduleApplications(assign_awm);
+    ctrl_states.BeginCycle();
+    result = AdaptiveCPUSchedPol::ScheduleApplications();
     if (result != SCHED_OK)
         return result;
+
+    logger->Info("Schedule: %d CPU domain migrations", placement.Migrations());
+
+    // Drop the controller state and the AWM of the applications no longer
+    // scheduled
+    std::vector<uint32_t> evicted;
+    size_t nr_evicted = ctrl_states.Evict(&evicted);
+    for (uint32_t uid : evicted)
+        app_awms.erase(uid);
+    logger->Debug("Schedule: %d controller states evicted, %d tracked",
+        nr_evicted, ctrl_states.Size());
     
+    tracer.Sync();
+    recorder.Sync();
+
     logger->Debug("Schedule: done");
     // Return the new resource status view according to the new resource
     // allocation performed
     status_view = sched_status_view;
+    last_status_view = sched_status_view;
+    last_status_view_valid = true;
 
+    PublishCycle(cycle_timer.getElapsedTimeMs(), false);
     return SCHED_DONE;
 }
 
+void AdaptiveCPUSchedPol::PublishCycle(double cycle_ms, bool unchanged) {
+    mc.AddSample(coll_metrics[ACPU_CYCLE_TIME].mh, cycle_ms);
+
+    // Live export: published once the cycle is complete. If nothing
+    // changed, the last snapshot still holds, with no phase run.
+    if (!exporter.Enabled())
+        return;
+    ExportCycle_t & exp_cycle(exporter.Cycle());
+    if (unchanged) {
+        exp_cycle.collect_ms = 0;
+        exp_cycle.control_ms = 0;
+        exp_cycle.reconcile_ms = 0;
+    }
+    exp_cycle.cycle_ms = cycle_ms;
+    exporter.Publish(app_infos.size());
+}
+
 } // namespace plugins
 
 } // namespace bbque
@@ -19,21 +19,40 @@
 #define BBQUE_ADAPTIVE_CPUSCHEDPOL_H_
 
 #include <cstdint>
+#include <ctime>
 #include <list>
 #include <memory>
+#include <unordered_map>
 
 #include "bbque/configuration_manager.h"
 #include "bbque/plugins/plugin.h"
 #include "bbque/plugins/scheduler_policy.h"
 #include "bbque/scheduler_manager.h"
+#include "bbque/utils/metrics_collector.h"
+#include "bbque/utils/timer.h"
+
+#include "adaptiveCPU_controller.h"
+#include "adaptiveCPU_cycle.h"
+#include "adaptiveCPU_export.h"
+#include "adaptiveCPU_groups.h"
+#include "adaptiveCPU_laws.h"
+#include "adaptiveCPU_params.h"
+#include "adaptiveCPU_placement.h"
+#include "adaptiveCPU_recorder.h"
+#include "adaptiveCPU_shadow.h"
+#include "adaptiveCPU_state.h"
+#include "adaptiveCPU_tracer.h"
 
 #define SCHEDULER_POLICY_NAME "adaptiveCPU"
 
 #define MODULE_NAMESPACE SCHEDULER_POLICY_NAMESPACE "." SCHEDULER_POLICY_NAME
-#define DEFAULT_NEG_DELTA -5
-#define DEFAULT_KP 0.6
-#define DEFAULT_KI 0.3
-#define DEFAULT_KD 0.1
+
+/** Metrics (class COUNTER) declaration */
+#define ACPU_COUNTER_METRIC(NAME, DESC)\
+ {MODULE_NAMESPACE "." NAME, DESC, MetricsCollector::COUNTER, 0, NULL, 0}
+/** Metrics (class SAMPLE) declaration */
+#define ACPU_SAMPLE_METRIC(NAME, DESC)\
+ {MODULE_NAMESPACE "." NAME, DESC, MetricsCollector::SAMPLE, 0, NULL, 0}
 
 using bbque::res::RViewToken_t;
 using bbque::utils::MetricsCollector;
@@ -44,18 +63,57 @@ struct PF_ObjectParams;
 
 namespace bbque { namespace plugins {
 
-struct AppInfo_t
+/** An application to schedule: the cycle inputs and decisions, and its
+ * framework objects */
+struct AppInfo_t : public CycleApp_t
 {
     bbque::app::AppCPtr_t papp;
     bbque::app::AwmPtr_t pawm;
-    uint64_t prev_quota;
-    uint64_t prev_used;
-    int64_t prev_delta;
-    uint64_t next_quota;
+};
+
+/** Reusable AWM of an application */
+struct AppAwm_t
+{
+    bbque::app::AwmPtr_t pawm;
+    /** Quota currently requested by the AWM */
+    uint64_t quota;
+    /** CPU binding of the AWM and its reference number */
+    int32_t cpu_id;
+    int32_t ref_num;
 };
 
 class LoggerIF;
 
+/** Metrics collected by the policy */
+typedef enum AdaptiveCPUMetrics {
+    /** Time spent in each phase of a cycle [ms] */
+    ACPU_CYCLE_TIME = 0,
+    ACPU_INIT_TIME,
+    ACPU_COLLECT_TIME,
+    ACPU_CONTROL_TIME,
+    ACPU_RUN_PASS_TIME,
+    ACPU_NOT_RUN_PASS_TIME,
+    ACPU_BINDING_TIME,
+    ACPU_SCHED_REQUEST_TIME,
+    /** Events */
+    ACPU_BINDING_FAILURES,
+    ACPU_SCHED_REQUEST_FAILURES,
+    ACPU_SKIP_APP,
+    ACPU_QUOTA_RESETS,
+    ACPU_QUOTA_HELD,
+    ACPU_OVERCOMMIT_RECLAIMS,
+    ACPU_POWER_RECLAIMS,
+    ACPU_BURSTS,
+    /** Node power in the last cycle [W] */
+    ACPU_NODE_POWER,
+    /** Per-application distributions */
+    ACPU_CONTROL_ERROR,
+    ACPU_UNUSED_QUOTA,
+    ACPU_APP_ENERGY,
+
+    ACPU_METRICS_COUNT
+} AdaptiveCPUMetrics_t;
+
 /**
 * @class AdaptiveCPUSchedPol
 *
@@ -96,10 +154,138 @@ public:
     * new scheduling / resource allocation
     */
     ExitCode_t Schedule(System & system, RViewToken_t & status_view);
-    ExitCode_t AssignWorkingMode(bbque::app::AppCPtr_t papp);
+
+    /**
+    * @brief Schedule the applications in three phases: control actions
+    * (computed in parallel), budget reconciliation and schedule requests
+    */
+    ExitCode_t ScheduleApplications();
+
+    /**
+    * @brief Phase 1: collect the applications to schedule
+    */
+    void CollectApplications();
     AppInfo_t InitializeAppInfo(bbque::app::AppCPtr_t papp);
-    ExitCode_t ScheduleApplications(std::function <ExitCode_t(bbque::app::AppCPtr_t) > do_func);
-    void ComputeQuota(AppInfo_t * ainfo);
+
+    /**
+    * @brief Build the active and the shadow control laws, if the
+    * configuration changed
+    */
+    void ConfigureControlLaws();
+
+    /**
+    * @brief Hand over the inputs and the decisions of the cycle to the
+    * shadow control laws
+    */
+    void SubmitShadowInputs();
+
+    /**
+    * @brief Power capping: read the node power of the last cycle, opening
+    * the energy counters again if the powercap root changed
+    */
+    PowerSample_t SamplePower();
+
+    /**
+    * @brief Phase 2: log the outcome of the budget reconciliation
+    */
+    void ReportReconciliation();
+
+    /**
+    * @brief The quotas to book: the quotas assigned, or their share of the
+    * capacity if overcommitted (see OvercommitBookings())
+    *
+    * @param capacity The CPU capacity
+    */
+    void ScaleBookings(uint64_t capacity);
+
+    /**
+    * @brief Log the outcome of the budget reconciliation for an
+    * application
+    */
+    void ReportApplication(AppInfo_t const & ainfo);
+
+    /**
+    * @brief Weight of an application in the fair allocation
+    */
+    float AllocationWeight(bbque::app::AppCPtr_t papp);
+
+    /**
+    * @brief Log the gains chosen by the auto-tuning
+    */
+    void LogGainsReport();
+
+    /**
+    * @brief Log the divergence and the projected waste of the shadow
+    * control laws
+    */
+    void LogShadowReport();
+
+    /**
+    * @brief Phase 3: build the AWM, bind it and issue the schedule request
+    *
+    * @return SCHED_SKIP_APP if no CPU domain accepted the application
+    */
+    ExitCode_t AssignWorkingMode(AppInfo_t & ainfo);
+
+    /**
+    * @brief Append the decision taken for an application to the trace
+    *
+    * @param assigned The schedule request has been accepted
+    */
+    void TraceDecision(AppInfo_t const & ainfo, bool assigned);
+
+    /**
+    * @brief Append the configuration to the recording
+    */
+    void RecordConfiguration(PolicyParams_t const & p);
+
+    /**
+    * @brief Fill the recording of an application: inputs and decisions
+    *
+    * @param assigned The schedule request has been accepted
+    */
+    void RecordApplication(
+        AppInfo_t const & ainfo, bool assigned, RecordApp_t & rec);
+
+    /**
+    * @brief Fill the live export of an application controller state
+    *
+    * @param assigned The schedule request has been accepted
+    */
+    void ExportApplication(
+        AppInfo_t const & ainfo, bool assigned, ExportApp_t & exp);
+
+    /**
+    * @brief Sample the per-application distributions and count the events
+    * of a scheduled application
+    */
+    void CollectAppMetrics(AppInfo_t const & ainfo, ExitCode_t result);
+
+    /**
+    * @brief Mark the applications changed since the last cycle
+    *
+    * An application is dirty if it is not running, if it changed state, if
+    * it reported a new run-time profile sample, or if its controller has not
+    * reached the steady state (non-zero error or control variable).
+    *
+    * @return The number of dirty applications, or a negative value if the
+    * set of applications changed since the last cycle
+    */
+    int32_t MarkDirtyApplications();
+
+    /**
+    * @brief Schedule again an application with its current AWM and binding
+    */
+    ExitCode_t ResubmitWorkingMode(
+        bbque::app::AppCPtr_t papp, AppCtrlState_t & state);
+
+    /**
+    * @brief Sample the cycle time and publish the live export
+    *
+    * @param unchanged No application changed: the cycle was skipped, and
+    * the last snapshot is published again
+    */
+    void PublishCycle(double cycle_ms, bool unchanged);
     
 private:
 
@@ -109,6 +295,33 @@ private:
     /** Resource accounter instance */
     ResourceAccounter & ra;
 
+    /** Metrics collector instance */
+    MetricsCollector & mc;
+
+    /** The collection of metrics generated by this module */
+    static MetricsCollector::MetricsCollection_t coll_metrics[ACPU_METRICS_COUNT];
+
+    /** Time spent in binding attempts and schedule requests in a cycle */
+    double binding_ms;
+    double sched_request_ms;
+
+    /** Start of the current cycle, and time since the previous one [ms] */
+    uint64_t cycle_start_ms;
+    double cycle_period_ms;
+
+    /** Power capping: energy counters */
+    PowerMeter power_meter;
+
+    /** Active control law (nullptr = built-in control step) */
+    std::unique_ptr<ControlLaw> active_law;
+    std::string active_law_name;
+
+    /** Shadow control laws, as configured, and the inputs buffer */
+    ShadowEvaluator shadows;
+    std::vector<std::string> shadow_names;
+    int32_t law_deadband;
+    std::vector<ShadowInput_t> shadow_inputs;
+
     /** System logger instance */
     std::unique_ptr<bu::Logger> logger;
     
@@ -117,12 +330,48 @@ private:
     std::vector<uint32_t> sys_ids;
     
     uint64_t available_cpu;
-    uint64_t quota_not_run_apps;
 
-    int64_t neg_delta;
-    float kp;
-    float ki;
-    float kd;
+    /** Published policy parameters, and the snapshot used by the cycle */
+    std::shared_ptr<PolicyParams_t const> params;
+    std::shared_ptr<PolicyParams_t const> cfg;
+
+    /** Modification time of the configuration file when last loaded */
+    struct timespec config_mtime;
+
+    /** Per-application controller state */
+    ControllerStateTable ctrl_states;
+
+    /** Reusable AWM of each application, by UID */
+    std::unordered_map<uint32_t, AppAwm_t> app_awms;
+
+    /** Applications to schedule in the current cycle, and their view for
+     * the cycle engine */
+    std::vector<AppInfo_t> app_infos;
+    std::vector<CycleApp_t *> cycle_apps;
+
+    /** Control actions and budget reconciliation (phases 1 and 2) */
+    CycleEngine engine;
+
+    /** CPU binding domains placement, and the candidates of the
+     * application being placed */
+    PlacementEngine placement;
+    std::vector<int32_t> cpu_ids;
+
+    /** Binary trace of the controller decisions */
+    DecisionTracer tracer;
+
+    /** Recording of the inputs and the decisions of each cycle */
+    DecisionRecorder recorder;
+
+    /** Live export of the controller state (shared memory) */
+    StateExporter exporter;
+
+    /** The dirty flags have been updated in the current cycle */
+    bool dirty_marked;
+
+    /** Resource view returned by the last scheduling cycle */
+    RViewToken_t last_status_view;
+    bool last_status_view_valid;
     
     uint32_t nr_apps;
     uint32_t nr_run_apps;
@@ -141,6 +390,47 @@ private:
     */
     ExitCode_t _Init();
 
+    /**
+    * @brief Run a function on the running applications first, and then on
+    * the ready, thawed and restoring ones
+    */
+    void ForEachActiveApplication(
+        std::function<void(bbque::app::AppCPtr_t)> func);
+
+    /**
+    * @brief Reset the placement engine with the CPU binding domains
+    */
+    void InitPlacement();
+
+    /**
+    * @brief Parse the configuration file and publish a new parameters
+    * snapshot, logging the parameters changed by a reload
+    */
+    void LoadConfiguration();
+
+    /**
+    * @brief Check whether the configuration file changed since the last
+    * load (modification time)
+    */
+    bool ConfigurationChanged();
+
+    /**
+    * @brief Controller parameters of an application: its own override, the
+    * override of its recipe, or the global ones
+    */
+    PIDParams_t const * ResolveGains(bbque::app::AppCPtr_t papp);
+
+    /**
+    * @brief Budget group of an application
+    */
+    uint32_t ResolveGroup(bbque::app::AppCPtr_t papp);
+
+    /**
+    * @brief The application is in the latency class (configuration or
+    * recipe attribute)
+    */
+    bool ResolveLatencyClass(bbque::app::AppCPtr_t papp);
+
 };
 
 } // namespace plugins
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_shadow.h"
+
+#include <cstdlib>
+
+namespace bbque { namespace plugins {
+
+ShadowEvaluator::ShadowEvaluator():
+        nr_laws(0),
+        pending_cycle(0),
+        has_pending(false),
+        busy(false),
+        stop(false),
+        dropped(0) {
+}
+
+ShadowEvaluator::~ShadowEvaluator() {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        stop = true;
+    }
+    work_cv.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+void ShadowEvaluator::Configure(
+        std::vector<std::unique_ptr<ControlLaw>> && laws) {
+    std::unique_lock<std::mutex> lock(mtx);
+    idle_cv.wait(lock, [this] { return !busy; });
+
+    evals.clear();
+    published.clear();
+    for (auto & law : laws) {
+        evals.emplace_back();
+        LawEval_t & e(evals.back());
+        e.law = std::move(law);
+        e.stats = ShadowStats_t();
+        e.stats.name = e.law->Name();
+        published.push_back(e.stats);
+    }
+    nr_laws = evals.size();
+    has_pending = false;
+    dropped = 0;
+
+    if (nr_laws > 0 && !thread.joinable())
+        thread = std::thread(&ShadowEvaluator::Worker, this);
+}
+
+void ShadowEvaluator::Submit(
+        uint64_t cycle, std::vector<ShadowInput_t> & inputs) {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (has_pending)
+            ++dropped;
+        pending.swap(inputs);
+        pending_cycle = cycle;
+        has_pending = true;
+    }
+    inputs.clear();
+    work_cv.notify_one();
+}
+
+uint64_t ShadowEvaluator::Stats(std::vector<ShadowStats_t> & stats) {
+    std::unique_lock<std::mutex> lock(mtx);
+    stats = published;
+    return dropped;
+}
+
+void ShadowEvaluator::Worker() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        work_cv.wait(lock, [this] { return stop || has_pending; });
+        if (stop)
+            return;
+
+        current.swap(pending);
+        uint64_t cycle = pending_cycle;
+        has_pending = false;
+        busy = true;
+        lock.unlock();
+
+        Evaluate(cycle);
+
+        lock.lock();
+        for (size_t i = 0; i < evals.size(); ++i)
+            published[i] = evals[i].stats;
+        busy = false;
+        idle_cv.notify_all();
+    }
+}
+
+void ShadowEvaluator::Evaluate(uint64_t cycle) {
+    for (auto & e : evals) {
+        ShadowStats_t & s(e.stats);
+        e.next_quotas.clear();
+        for (auto const & si : current) {
+            ControlInput_t const & in(si.in);
+
+            // The projection of the previous cycle against the usage
+            auto it = e.quotas.find(in.uid);
+            if (it != e.quotas.end()) {
+                uint64_t quota = it->second;
+                ++s.projected;
+                s.waste += (quota > in.prev_used) ? quota - in.prev_used : 0;
+                s.active_waste += (in.prev_quota > in.prev_used) ?
+                    in.prev_quota - in.prev_used : 0;
+                s.shortfall += (in.prev_used > quota) ?
+                    in.prev_used - quota : 0;
+            }
+
+            // The capacity is not a constraint of the shadow
+            uint64_t available = UINT64_MAX / 2;
+            uint64_t quota;
+            ApplyControl(in.prev_quota, e.law->Step(in, cycle).cv,
+                available, quota);
+            e.next_quotas[in.uid] = quota;
+
+            uint64_t divergence = (quota > si.next_quota) ?
+                quota - si.next_quota : si.next_quota - quota;
+            ++s.samples;
+            s.divergence += divergence;
+            if (divergence > s.max_divergence)
+                s.max_divergence = divergence;
+        }
+        e.law->Purge(cycle);
+        e.quotas.swap(e.next_quotas);
+        ++s.cycles;
+    }
+    current.clear();
+}
+
+} // namespace plugins
+
+} // namespace bbque
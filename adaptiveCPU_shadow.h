@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_SHADOW_H_
+#define BBQUE_ADAPTIVE_CPU_SHADOW_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "adaptiveCPU_laws.h"
+
+#define DEFAULT_SHADOW_REPORT 100
+
+/*
+ * Shadow evaluation of alternative control laws.
+ *
+ * At the end of each cycle the policy hands over the inputs of the running
+ * applications and the quotas assigned by the active controller. A
+ * dedicated thread steps each shadow law on the same inputs and compares
+ * what it would have assigned (the capacity not considered) with the
+ * active controller:
+ *
+ * - divergence: |shadow quota - active quota|;
+ * - projected waste: the shadow quota of the previous cycle not used in
+ *   this cycle, against the quota actually not used;
+ * - shortfall: the usage beyond the shadow quota of the previous cycle. It
+ *   is a lower bound, since the usage is bounded by the active quota.
+ *
+ * The hand-over swaps two buffers and never waits for the evaluation. If
+ * the previous cycle is still being evaluated, the pending one is replaced
+ * and counted as dropped.
+ */
+
+namespace bbque { namespace plugins {
+
+/** Inputs of an application in a cycle */
+struct ShadowInput_t
+{
+    ControlInput_t in;
+    /** Quota assigned by the active controller */
+    uint64_t next_quota;
+};
+
+/** Statistics of a shadow law */
+struct ShadowStats_t
+{
+    std::string name;
+    uint64_t cycles;
+    /** Applications compared, over all the cycles */
+    uint64_t samples;
+    /** Quota divergence from the active controller: sum and maximum */
+    double divergence;
+    uint64_t max_divergence;
+    /** Applications with a projection of the previous cycle */
+    uint64_t projected;
+    /** Quota not used: projected for the shadow, actual for the active */
+    double waste;
+    double active_waste;
+    /** Usage beyond the projected quota */
+    double shortfall;
+};
+
+class ShadowEvaluator
+{
+public:
+
+    ShadowEvaluator();
+
+    ~ShadowEvaluator();
+
+    /**
+    * @brief Set the shadow laws, resetting the statistics
+    *
+    * Waits for the evaluation in progress, if any.
+    */
+    void Configure(std::vector<std::unique_ptr<ControlLaw>> && laws);
+
+    inline bool Enabled() const { return nr_laws > 0; }
+
+    /**
+    * @brief Hand over the inputs of a cycle
+    *
+    * @param cycle The cycle
+    * @param inputs The inputs, swapped with an empty buffer
+    */
+    void Submit(uint64_t cycle, std::vector<ShadowInput_t> & inputs);
+
+    /**
+    * @brief The statistics of the last evaluated cycle
+    *
+    * @param stats Filled with the statistics of each law
+    *
+    * @return The number of cycles dropped
+    */
+    uint64_t Stats(std::vector<ShadowStats_t> & stats);
+
+private:
+
+    struct LawEval_t {
+        std::unique_ptr<ControlLaw> law;
+        /** Quota projected in the previous cycle */
+        std::unordered_map<uint32_t, uint64_t> quotas;
+        std::unordered_map<uint32_t, uint64_t> next_quotas;
+        ShadowStats_t stats;
+    };
+
+    std::thread thread;
+
+    std::mutex mtx;
+
+    std::condition_variable work_cv;
+
+    std::condition_variable idle_cv;
+
+    /** Owned by the evaluation thread while busy */
+    std::vector<LawEval_t> evals;
+    size_t nr_laws;
+
+    /** Cycle handed over and not evaluated yet */
+    std::vector<ShadowInput_t> pending;
+    uint64_t pending_cycle;
+    bool has_pending;
+
+    /** Cycle being evaluated */
+    std::vector<ShadowInput_t> current;
+
+    bool busy;
+    bool stop;
+    uint64_t dropped;
+
+    /** Statistics published after each evaluation */
+    std::vector<ShadowStats_t> published;
+
+    void Worker();
+
+    void Evaluate(uint64_t cycle);
+
+};
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_SHADOW_H_
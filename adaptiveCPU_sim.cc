@@ -0,0 +1,752 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Trace-replay simulator of the AdaptiveCPU quota controller.
+ *
+ * The tool replaces the System, ResourceAccounter and ApplicationManager
+ * with local stand-ins: a list of simulated applications, the sys.cpu.pe
+ * capacity and the quota booked by each application. Each simulated cycle
+ * runs the cycle engine of AdaptiveCPUSchedPol::ScheduleApplications (see
+ * CycleEngine): the quotas are computed by the very same control and
+ * reconciliation code used by the policy. The not running applications are
+ * admitted either by the admission queue (the default of the policy) or in
+ * equal parts of the remaining budget.
+ *
+ * The CPU demand of the applications comes either from a trace file or from
+ * a synthetic generator. A trace file has one row per cycle and one column
+ * per application (comma or blank separated). Each value is the CPU demand
+ * of the application (100 = one core), while a negative value or "-" means
+ * that the application is not in the system in that cycle.
+ *
+ * A recording of the policy (AdaptiveCPUSchedPol.record_file) can be
+ * replayed as well: the recorded inputs of each cycle are fed to the cycle
+ * engine of the policy (see CycleEngine), in every allocation mode, and the
+ * control actions and the quotas computed are checked against the recorded
+ * decisions. The state the policy rebuilds from the cycles themselves
+ * (usage forecasts and histories, admission queue) is rebuilt by the
+ * replay as well: a recording not starting with the policy can mismatch
+ * in its first cycles.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "adaptiveCPU_controller.h"
+#include "adaptiveCPU_cycle.h"
+#include "adaptiveCPU_forecast.h"
+#include "adaptiveCPU_params.h"
+#include "adaptiveCPU_recorder.h"
+#include "adaptiveCPU_state.h"
+
+using namespace bbque::plugins;
+
+#define SIM_DEFAULT_CPU_CAPACITY 400
+#define SIM_DEFAULT_CYCLES 1000
+#define SIM_DEFAULT_SEED 1
+
+/** A demand value meaning "application not in the system" */
+#define SIM_ABSENT -1
+
+typedef std::vector<std::vector<int64_t>> Trace_t;
+
+/** Stand-in of the application descriptor and its booked resources */
+struct SimApp_t
+{
+    uint32_t uid;
+    bool running = false;
+    uint64_t quota = 0;
+    uint64_t used = 0;
+};
+
+/** Policy state of a synthetic or trace simulation */
+struct SimPolicy_t
+{
+    PolicyParams_t params;
+    ControllerStateTable states;
+    CycleEngine engine;
+    /** Applications in the system in the cycle */
+    std::vector<CycleApp_t> cycle;
+    std::vector<CycleApp_t *> apps;
+};
+
+/** Figures of merit collected for each application */
+struct SimStats_t
+{
+    uint32_t cycles = 0;
+    uint32_t steps = 0;
+    uint32_t settled = 0;
+    uint64_t settling_sum = 0;
+    uint32_t settling_max = 0;
+    uint64_t overshoot_max = 0;
+    uint64_t wasted = 0;
+    uint32_t throttled_cycles = 0;
+    uint64_t throttled_demand = 0;
+    uint32_t resets = 0;
+    /** Cycles waiting for admission: current and longest wait */
+    uint32_t waiting = 0;
+    uint32_t waiting_max = 0;
+
+    // Current demand segment tracking
+    uint32_t seg_start = 0;
+    uint32_t seg_last_err = 0;
+    bool seg_open = false;
+    bool seg_err = false;
+    int64_t seg_demand = SIM_ABSENT;
+};
+
+/** Outcome of a recording replay */
+struct ReplayStats_t
+{
+    uint64_t frames = 0;
+    uint64_t cycles = 0;
+    uint64_t apps = 0;
+    uint64_t cv_checked = 0;
+    uint64_t cv_mismatches = 0;
+    uint64_t quota_checked = 0;
+    uint64_t quota_mismatches = 0;
+};
+
+/** State of the policy rebuilt by a recording replay */
+struct ReplayState_t
+{
+    PolicyParams_t params;
+    /** RECORD_CFG_* flags of the configuration */
+    uint32_t flags = 0;
+    ControllerStateTable states;
+    CycleEngine engine;
+    /** Applications of the cycle, and their recorded gains */
+    std::vector<CycleApp_t> apps;
+    std::vector<CycleApp_t *> cycle_apps;
+    std::vector<PIDParams_t> gains;
+};
+
+static void CloseSegment(SimStats_t & st) {
+    if (!st.seg_open)
+        return;
+    st.seg_open = false;
+    if (st.seg_err)
+        return;
+    uint32_t settling = st.seg_last_err - st.seg_start;
+    ++st.settled;
+    st.settling_sum += settling;
+    st.settling_max = std::max(st.settling_max, settling);
+}
+
+static void Usage(char const * prog) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -t FILE     replay the CPU demand trace in FILE\n"
+        "  -s APPS     synthetic workload of APPS applications\n"
+        "  -n CYCLES   cycles of the synthetic workload (default %d)\n"
+        "  -r SEED     seed of the synthetic workload (default %d)\n"
+        "  -c CPU      sys.cpu.pe capacity (default %d)\n"
+        "  -g KP,KI,KD controller gains (default %.1f,%.1f,%.1f)\n"
+        "  -d DELTA    neg_delta (default %d)\n"
+        "  -f METHOD   predictive mode: none, ewma, holt, kalman (default none)\n"
+        "  -z CONF     predictive headroom in forecast deviations (default %.1f)\n"
+        "  -a POLICY   admission of the not running applications: queue, equal\n"
+        "              (default queue)\n"
+        "  -p FILE     replay the recording in FILE (repeat for rotated files,\n"
+        "              oldest first)\n"
+        "  -x PERCENT  fail if the quota resets exceed PERCENT of the\n"
+        "              application cycles\n"
+        "  -w CYCLES   fail if an application waits for admission longer\n"
+        "              than CYCLES cycles\n"
+        "  -v          print per-application statistics\n",
+        prog, SIM_DEFAULT_CYCLES, SIM_DEFAULT_SEED, SIM_DEFAULT_CPU_CAPACITY,
+        DEFAULT_KP, DEFAULT_KI, DEFAULT_KD, DEFAULT_NEG_DELTA,
+        DEFAULT_FORECAST_CONFIDENCE);
+}
+
+static bool LoadTrace(std::string const & path, Trace_t & trace) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        fprintf(stderr, "Cannot open trace file [%s]\n", path.c_str());
+        return false;
+    }
+
+    std::string line;
+    size_t nr_apps = 0;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream ss(line);
+        std::vector<int64_t> row;
+        std::string cell;
+        while (ss >> cell) {
+            if (cell == "-")
+                row.push_back(SIM_ABSENT);
+            else
+                row.push_back(std::strtoll(cell.c_str(), nullptr, 10));
+        }
+        nr_apps = std::max(nr_apps, row.size());
+        trace.push_back(row);
+    }
+
+    for (auto & row : trace)
+        row.resize(nr_apps, SIM_ABSENT);
+    return !trace.empty();
+}
+
+/**
+ * Synthetic workload: a mix of steady, step, ramp and periodic demands,
+ * with some noise on top and applications arriving at different times
+ */
+static void SyntheticTrace(
+        uint32_t nr_apps, uint32_t nr_cycles, uint32_t seed, Trace_t & trace) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> level(10, 120);
+    std::uniform_int_distribution<int> kind(0, 3);
+    std::uniform_int_distribution<uint32_t> arrival(0, nr_cycles / 4);
+    std::uniform_int_distribution<uint32_t> period(20, 200);
+    std::normal_distribution<double> noise(0.0, 2.0);
+
+    trace.assign(nr_cycles, std::vector<int64_t>(nr_apps, SIM_ABSENT));
+    for (uint32_t a = 0; a < nr_apps; ++a) {
+        int base = level(gen);
+        int high = level(gen);
+        int k = kind(gen);
+        uint32_t start = arrival(gen);
+        uint32_t per = period(gen);
+        for (uint32_t c = start; c < nr_cycles; ++c) {
+            double d = base;
+            uint32_t t = c - start;
+            switch (k) {
+            case 1: // step
+                d = ((t / per) % 2) ? high : base;
+                break;
+            case 2: // ramp
+                d = base + (high - base) * double(t % per) / per;
+                break;
+            case 3: // periodic
+                d = base + (high - base) *
+                    (0.5 + 0.5 * std::sin(2.0 * M_PI * t / per));
+                break;
+            }
+            d += noise(gen);
+            trace[c][a] = std::max<int64_t>(0, std::lround(d));
+        }
+    }
+}
+
+/**
+ * A simulated cycle: the controller state and the cycle engine of the
+ * policy, with the quotas booked by the applications in place of the
+ * ResourceAccounter
+ */
+static void SimCycle(
+        SimPolicy_t & sp,
+        uint64_t capacity,
+        std::vector<int64_t> const & demand,
+        std::vector<SimApp_t> & apps,
+        std::vector<SimStats_t> & stats,
+        uint32_t cycle) {
+
+    // Applications leaving the system release their resources
+    for (size_t i = 0; i < apps.size(); ++i) {
+        if (demand[i] < 0) {
+            apps[i].running = false;
+            apps[i].quota = 0;
+        }
+    }
+
+    // ResourceAccounter stand-in: what is not booked by running apps
+    uint64_t booked = 0;
+    sp.states.BeginCycle();
+    for (size_t i = 0; i < apps.size(); ++i) {
+        if (demand[i] < 0)
+            continue;
+        bool created;
+        sp.states.Get(apps[i].uid, created);
+        if (apps[i].running)
+            booked += apps[i].quota;
+    }
+    uint64_t available_cpu = (capacity > booked) ? capacity - booked : 0;
+
+    sp.engine.Begin(sp.params, cycle, available_cpu, capacity, 0);
+    sp.cycle.clear();
+    for (size_t i = 0; i < apps.size(); ++i) {
+        if (demand[i] < 0)
+            continue;
+        SimApp_t const & app(apps[i]);
+        CycleApp_t capp = CycleApp_t();
+        capp.uid = app.uid;
+        capp.weight = 1.0;
+        capp.prev_quota = app.quota;
+        capp.prev_used = app.used;
+        capp.prev_delta = app.quota - app.used;
+        capp.running = app.running;
+        capp.state = sp.states.Find(app.uid);
+        capp.gains = &sp.params.pid;
+        capp.params = sp.params.pid;
+        sp.cycle.push_back(capp);
+    }
+    sp.apps.clear();
+    for (CycleApp_t & capp : sp.cycle) {
+        sp.engine.Collect(capp);
+        sp.apps.push_back(&capp);
+    }
+
+    sp.engine.Control(sp.apps);
+    sp.engine.Reconcile(sp.apps, {false, 0, 0});
+    sp.states.Evict();
+
+    for (CycleApp_t const & capp : sp.cycle) {
+        SimApp_t & app(apps[capp.uid]);
+        SimStats_t & st(stats[capp.uid]);
+        if (capp.skip) {
+            st.waiting_max = std::max(st.waiting_max, ++st.waiting);
+            continue;
+        }
+        st.waiting = 0;
+        if (capp.running) {
+            if (capp.reset)
+                ++stats[capp.uid].resets;
+            // Settled as long as the error stays in the admissible range
+            stats[capp.uid].seg_err = (capp.ctrl.error != 0);
+            if (stats[capp.uid].seg_err)
+                stats[capp.uid].seg_last_err = cycle;
+        }
+        app.running = true;
+        app.quota = capp.next_quota;
+    }
+
+    // Execution of the applications with the new quotas
+    for (size_t i = 0; i < apps.size(); ++i) {
+        SimApp_t & app(apps[i]);
+        SimStats_t & st(stats[i]);
+        if (!app.running)
+            continue;
+
+        uint64_t d = demand[i];
+        app.used = std::min(d, app.quota);
+
+        ++st.cycles;
+        st.wasted += app.quota - app.used;
+        if (d > app.quota) {
+            ++st.throttled_cycles;
+            st.throttled_demand += d - app.quota;
+        }
+        if (app.quota > d + ADMISSIBLE_DELTA)
+            st.overshoot_max = std::max(
+                st.overshoot_max, app.quota - d - ADMISSIBLE_DELTA);
+
+        // A new demand segment starts on variations beyond the admissible
+        // range of the controller
+        if (!st.seg_open ||
+                std::llabs(demand[i] - st.seg_demand) > ADMISSIBLE_DELTA) {
+            CloseSegment(st);
+            ++st.steps;
+            st.seg_open = true;
+            st.seg_err = false;
+            st.seg_start = cycle;
+            st.seg_last_err = cycle;
+            st.seg_demand = demand[i];
+        }
+    }
+}
+
+static ForecastParams_t RecordedForecast(RecordConfig_t const & rc) {
+    ForecastParams_t fparams;
+    fparams.method = static_cast<ForecastMethod_t>(rc.forecast_method);
+    fparams.alpha = rc.forecast_alpha;
+    fparams.beta = rc.forecast_beta;
+    fparams.kalman_q = rc.kalman_q;
+    fparams.kalman_r = rc.kalman_r;
+    fparams.confidence = rc.forecast_confidence;
+    fparams.max_headroom = rc.forecast_max_headroom;
+    fparams.ff_gain = rc.forecast_ff_gain;
+    return fparams;
+}
+
+/**
+ * Policy parameters of a configuration frame. The gains actually used in
+ * each cycle (tuned, or throttled) are recorded with the applications: the
+ * replay runs with the auto-tuning and the throttling disabled.
+ */
+static void RecordedParams(
+        RecordConfig_t const & rc,
+        RecordGroup_t const * groups,
+        PolicyParams_t & p) {
+    p = PolicyParams_t();
+    p.pid = {rc.neg_delta, rc.kp, rc.ki, rc.kd};
+    p.control_mode = static_cast<ControlMode_t>(rc.control_mode);
+    p.ggap_deadband = rc.ggap_deadband;
+    p.incremental = rc.flags & RECORD_CFG_INCREMENTAL;
+    p.parallel_chunk = DEFAULT_PARALLEL_CHUNK;
+    p.fair_allocation = rc.flags & RECORD_CFG_FAIR;
+    p.fair_weighted = rc.flags & RECORD_CFG_FAIR_WEIGHTED;
+    p.admission_queue = rc.flags & RECORD_CFG_ADMISSION_QUEUE;
+    p.admission = {rc.admission_min_quota, rc.admission_max_quota,
+        rc.admission_default_quota, rc.admission_aging};
+    p.forecast = RecordedForecast(rc);
+    p.hysteresis = {(rc.flags & RECORD_CFG_HYSTERESIS) != 0,
+        rc.hysteresis_grow, rc.hysteresis_shrink, rc.hysteresis_max_hold,
+        rc.reconf_cost, rc.reconf_alpha};
+    p.overcommit = {(rc.flags & RECORD_CFG_OVERCOMMIT) != 0,
+        rc.overcommit_risk, rc.overcommit_max_ratio, rc.overcommit_reclaim};
+    p.power.budget = (rc.flags & RECORD_CFG_POWER) ? rc.power_budget : 0;
+    p.power.gain = rc.power_gain;
+    p.power.min_ratio = rc.power_min_ratio;
+    p.power.shrink = static_cast<PowerShrink_t>(rc.power_shrink);
+    p.burst.reserve = (rc.flags & RECORD_CFG_BURST) ? rc.burst_reserve : 0;
+    p.burst.earn = rc.burst_earn;
+    p.burst.max_credit = rc.burst_max_credit;
+    p.burst.step = rc.burst_step;
+    for (uint32_t g = 0; g < rc.nr_groups; ++g)
+        p.groups.groups.push_back({"group" + std::to_string(g),
+            groups[g].guaranteed, groups[g].max, groups[g].weight});
+}
+
+/**
+ * Replay a recorded cycle through the cycle engine of the policy. The
+ * controller memory, the burst credits and the held quota changes are
+ * restored from the recording; the rest of the state (usage forecasts and
+ * histories, admission queue) is rebuilt by the replay itself. The control
+ * actions are checked unless computed by a control law, whose own memory
+ * is not recorded: the recorded ones are reconciled instead. The quotas
+ * are checked in every allocation mode.
+ */
+static void ReplayCycle(
+        ReplayState_t & st,
+        RecordFrame_t const * frame,
+        ReplayStats_t & rs,
+        bool verbose) {
+    RecordCycle_t const * info = RecordReader::Body<RecordCycle_t>(frame);
+    RecordApp_t const * recs = RecordReader::Apps(frame);
+    bool check_cv = !(st.flags & RECORD_CFG_CONTROL_LAW);
+
+    ++rs.cycles;
+    st.states.BeginCycle();
+    for (uint32_t i = 0; i < info->nr_apps; ++i) {
+        RecordApp_t const & rec(recs[i]);
+        bool created;
+        AppCtrlState_t & state(st.states.Get(rec.uid, created));
+        state.pid = rec.pid;
+        state.ggap_pid = rec.ggap_pid;
+        state.last_sample = {rec.cpu_usage, rec.ctime_ms, rec.ggap_percent,
+            (rec.flags & RECORD_PROFILE_VALID) != 0};
+        state.burst = {rec.burst_credit, rec.burst_borrowed};
+        state.reconf.cost = rec.reconf_cost;
+        state.reconf.samples = rec.reconf_samples;
+        state.reconf.direction = rec.reconf_direction;
+        state.reconf.accrued = rec.reconf_accrued;
+        state.reconf.held = rec.reconf_held;
+    }
+
+    st.engine.Begin(st.params, frame->cycle, info->available_cpu,
+        info->capacity, info->period_ms);
+    if (info->power_cap > 0)
+        st.engine.SetQuotaCap(info->power_cap);
+
+    // Stable storage: the engine keeps pointers to the applications
+    st.apps.assign(info->nr_apps, CycleApp_t());
+    st.gains.resize(info->nr_apps);
+    st.cycle_apps.clear();
+    for (uint32_t i = 0; i < info->nr_apps; ++i) {
+        RecordApp_t const & rec(recs[i]);
+        CycleApp_t & app(st.apps[i]);
+        st.gains[i] = {rec.neg_delta, rec.kp, rec.ki, rec.kd};
+        app.uid = rec.uid;
+        app.priority = rec.priority;
+        app.weight = rec.weight;
+        app.prev_quota = rec.quota;
+        app.prev_used = rec.cpu_usage;
+        app.prev_delta = app.prev_quota - app.prev_used;
+        app.running = rec.flags & RECORD_RUNNING;
+        app.state = st.states.Find(rec.uid);
+        app.gains = &st.gains[i];
+        app.params = st.gains[i];
+        app.latency = rec.flags & RECORD_LATENCY;
+        app.group = rec.group;
+        st.engine.Collect(app);
+        st.cycle_apps.push_back(&app);
+    }
+
+    if (check_cv) {
+        st.engine.Control(st.cycle_apps);
+    }
+    else {
+        for (uint32_t i = 0; i < info->nr_apps; ++i) {
+            CycleApp_t & app(st.apps[i]);
+            if (!app.running)
+                continue;
+            app.ctrl.cv = recs[i].cv;
+            app.ctrl.state = recs[i].pid;
+            app.demand = app.grant = app.ctrl.cv;
+        }
+    }
+
+    PowerSample_t power = {(info->flags & RECORD_CYCLE_POWER_VALID) != 0,
+        info->energy, info->power};
+    st.engine.Reconcile(st.cycle_apps, power);
+
+    for (uint32_t i = 0; i < info->nr_apps; ++i) {
+        RecordApp_t const & rec(recs[i]);
+        CycleApp_t const & app(st.apps[i]);
+        ++rs.apps;
+        if (check_cv && app.running) {
+            ++rs.cv_checked;
+            if (app.ctrl.cv != rec.cv) {
+                ++rs.cv_mismatches;
+                if (verbose)
+                    printf("cycle %lu uid %u: cv=%ld recorded=%ld\n",
+                        frame->cycle, rec.uid, app.ctrl.cv, rec.cv);
+            }
+        }
+        ++rs.quota_checked;
+        if (app.next_quota != rec.next_quota) {
+            ++rs.quota_mismatches;
+            if (verbose)
+                printf("cycle %lu uid %u: quota=%lu recorded=%lu\n",
+                    frame->cycle, rec.uid, app.next_quota, rec.next_quota);
+        }
+    }
+
+    // Incremental mode: the unchanged applications are not recorded, but
+    // the policy keeps their state
+    if (!st.params.incremental)
+        st.states.Evict();
+}
+
+static int Replay(std::vector<std::string> const & files, bool verbose) {
+    ReplayStats_t rs;
+    ReplayState_t st;
+    bool config_valid = false;
+
+    for (auto const & path : files) {
+        RecordReader reader;
+        if (!reader.Open(path)) {
+            fprintf(stderr, "Cannot open recording file [%s]\n", path.c_str());
+            return EXIT_FAILURE;
+        }
+        RecordFrame_t const * frame;
+        while ((frame = reader.Next()) != nullptr) {
+            ++rs.frames;
+            if (frame->type == RECORD_FRAME_CONFIG) {
+                RecordConfig_t const * rc =
+                    RecordReader::Body<RecordConfig_t>(frame);
+                RecordedParams(*rc, RecordReader::Groups(frame), st.params);
+                st.flags = rc->flags;
+                config_valid = true;
+            }
+            else if (frame->type == RECORD_FRAME_CYCLE && config_valid) {
+                ReplayCycle(st, frame, rs, verbose);
+            }
+        }
+    }
+
+    printf("# replay files=%zu frames=%lu cycles=%lu applications=%lu\n",
+        files.size(), rs.frames, rs.cycles, rs.apps);
+    printf("control actions          : %lu checked, %lu mismatches\n",
+        rs.cv_checked, rs.cv_mismatches);
+    printf("quotas                   : %lu checked, %lu mismatches\n",
+        rs.quota_checked, rs.quota_mismatches);
+
+    if (rs.cv_mismatches > 0 || rs.quota_mismatches > 0)
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char * argv[]) {
+    std::string trace_file;
+    std::vector<std::string> replay_files;
+    uint32_t nr_synth_apps = 0;
+    uint32_t nr_cycles = SIM_DEFAULT_CYCLES;
+    uint32_t seed = SIM_DEFAULT_SEED;
+    uint64_t capacity = SIM_DEFAULT_CPU_CAPACITY;
+    bool verbose = false;
+    float max_resets = -1;
+    int64_t max_waiting = -1;
+    SimPolicy_t sp;
+    sp.params = PolicyParams_t();
+    PolicyParams_t & p(sp.params);
+    PIDParams_t & params(p.pid);
+    ForecastParams_t & fparams(p.forecast);
+    params = {DEFAULT_NEG_DELTA, DEFAULT_KP, DEFAULT_KI, DEFAULT_KD};
+    fparams = {FORECAST_NONE,
+        DEFAULT_FORECAST_ALPHA, DEFAULT_FORECAST_BETA,
+        DEFAULT_KALMAN_Q, DEFAULT_KALMAN_R,
+        DEFAULT_FORECAST_CONFIDENCE, DEFAULT_FORECAST_MAX_HEADROOM,
+        DEFAULT_FORECAST_FF_GAIN};
+    p.parallel_chunk = DEFAULT_PARALLEL_CHUNK;
+    p.admission_queue = true;
+    p.admission = {DEFAULT_ADMISSION_MIN_QUOTA, DEFAULT_ADMISSION_MAX_QUOTA,
+        INITIAL_DEFAULT_QUOTA, DEFAULT_ADMISSION_AGING};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:s:n:r:c:g:d:f:z:a:p:x:w:vh")) != -1) {
+        switch (opt) {
+        case 't':
+            trace_file = optarg;
+            break;
+        case 's':
+            nr_synth_apps = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'n':
+            nr_cycles = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'r':
+            seed = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'c':
+            capacity = std::strtoull(optarg, nullptr, 10);
+            break;
+        case 'g':
+            if (sscanf(optarg, "%f,%f,%f",
+                    &params.kp, &params.ki, &params.kd) != 3) {
+                Usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'd':
+            params.neg_delta = std::strtoll(optarg, nullptr, 10);
+            break;
+        case 'f':
+            if (!ParseForecastMethod(optarg, fparams.method)) {
+                Usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'z':
+            fparams.confidence = std::strtof(optarg, nullptr);
+            break;
+        case 'a':
+            p.admission_queue = (std::string(optarg) == "queue");
+            if (!p.admission_queue && std::string(optarg) != "equal") {
+                Usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'p':
+            replay_files.push_back(optarg);
+            break;
+        case 'x':
+            max_resets = std::strtof(optarg, nullptr);
+            break;
+        case 'w':
+            max_waiting = std::strtoll(optarg, nullptr, 10);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            Usage(argv[0]);
+            return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (!replay_files.empty())
+        return Replay(replay_files, verbose);
+
+    Trace_t trace;
+    if (!trace_file.empty()) {
+        if (!LoadTrace(trace_file, trace))
+            return EXIT_FAILURE;
+    }
+    else if (nr_synth_apps > 0) {
+        SyntheticTrace(nr_synth_apps, nr_cycles, seed, trace);
+    }
+    else {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t nr_apps = trace[0].size();
+    std::vector<SimApp_t> apps(nr_apps);
+    std::vector<SimStats_t> stats(nr_apps);
+    for (size_t i = 0; i < nr_apps; ++i)
+        apps[i].uid = i;
+
+    for (uint32_t c = 0; c < trace.size(); ++c)
+        SimCycle(sp, capacity, trace[c], apps, stats, c);
+    for (auto & st : stats)
+        CloseSegment(st);
+
+    printf("# cycles=%zu apps=%zu capacity=%lu neg_delta=%ld "
+        "kp=%.3f ki=%.3f kd=%.3f forecast=%s admission=%s\n",
+        trace.size(), nr_apps, capacity, params.neg_delta,
+        params.kp, params.ki, params.kd, ForecastMethodName(fparams.method),
+        p.admission_queue ? "queue" : "equal");
+
+    SimStats_t tot;
+    uint32_t unsettled = 0;
+    if (verbose)
+        printf("%6s %7s %8s %8s %8s %10s %9s %10s %6s %6s\n",
+            "app", "cycles", "settle", "settleM", "ovrshM",
+            "wasted", "throttled", "unmet", "resets", "waitM");
+    for (size_t i = 0; i < nr_apps; ++i) {
+        SimStats_t & st(stats[i]);
+        if (verbose)
+            printf("%6zu %7u %8.1f %8u %8lu %10lu %9u %10lu %6u %6u\n",
+                i, st.cycles,
+                st.settled ? double(st.settling_sum) / st.settled : 0.0,
+                st.settling_max, st.overshoot_max, st.wasted,
+                st.throttled_cycles, st.throttled_demand, st.resets,
+                st.waiting_max);
+        tot.cycles += st.cycles;
+        tot.steps += st.steps;
+        tot.settled += st.settled;
+        tot.settling_sum += st.settling_sum;
+        tot.settling_max = std::max(tot.settling_max, st.settling_max);
+        tot.overshoot_max = std::max(tot.overshoot_max, st.overshoot_max);
+        tot.wasted += st.wasted;
+        tot.throttled_cycles += st.throttled_cycles;
+        tot.throttled_demand += st.throttled_demand;
+        tot.resets += st.resets;
+        tot.waiting_max = std::max(tot.waiting_max, st.waiting_max);
+        unsettled += st.steps - st.settled;
+    }
+
+    printf("settling time [cycles]   : mean=%.2f max=%u (unsettled=%u/%u)\n",
+        tot.settled ? double(tot.settling_sum) / tot.settled : 0.0,
+        tot.settling_max, unsettled, tot.steps);
+    printf("overshoot [%% CPU]        : max=%lu\n", tot.overshoot_max);
+    printf("wasted CPU [%% CPU/cycle] : %.2f\n",
+        tot.cycles ? double(tot.wasted) / tot.cycles : 0.0);
+    printf("throttled cycles         : %u (%.2f%%), unmet demand=%lu\n",
+        tot.throttled_cycles,
+        tot.cycles ? 100.0 * tot.throttled_cycles / tot.cycles : 0.0,
+        tot.throttled_demand);
+    printf("quota resets             : %u\n", tot.resets);
+    printf("admission wait [cycles]  : max=%u\n", tot.waiting_max);
+
+    if (max_resets >= 0 && tot.resets > max_resets / 100 * tot.cycles) {
+        fprintf(stderr, "Quota resets over %.1f%% of the cycles\n",
+            max_resets);
+        return EXIT_FAILURE;
+    }
+    if (max_waiting >= 0 && tot.waiting_max > max_waiting) {
+        fprintf(stderr, "Admission wait over %ld cycles\n", max_waiting);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
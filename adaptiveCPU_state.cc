@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_state.h"
+
+namespace bbque { namespace plugins {
+
+ControllerStateTable::ControllerStateTable():
+    cycle(0) {
+}
+
+void ControllerStateTable::BeginCycle() {
+    ++cycle;
+}
+
+AppCtrlState_t & ControllerStateTable::Get(uint32_t uid, bool & created) {
+    auto it = index.find(uid);
+    if (it != index.end()) {
+        created = false;
+        AppCtrlState_t & entry(entries[it->second]);
+        entry.last_seen = cycle;
+        return entry;
+    }
+
+    created = true;
+    index.emplace(uid, entries.size());
+    entries.emplace_back();
+    AppCtrlState_t & entry(entries.back());
+    entry.uid = uid;
+    entry.last_binding = CTRL_NO_BINDING;
+    entry.last_ref_num = -1;
+    entry.dirty = true;
+    entry.last_seen = cycle;
+    TunerReset(entry.tuner);
+    ForecastReset(entry.forecast);
+    ThrottleReset(entry.throttle);
+    ReconfReset(entry.reconf);
+    UsageReset(entry.usage);
+    BurstReset(entry.burst);
+    return entry;
+}
+
+AppCtrlState_t * ControllerStateTable::Find(uint32_t uid) {
+    auto it = index.find(uid);
+    if (it == index.end())
+        return nullptr;
+    return &entries[it->second];
+}
+
+size_t ControllerStateTable::Evict(std::vector<uint32_t> * evicted) {
+    size_t count = 0;
+    size_t i = 0;
+
+    // Swap-remove to keep the storage contiguous
+    while (i < entries.size()) {
+        if (entries[i].last_seen == cycle) {
+            ++i;
+            continue;
+        }
+        if (evicted)
+            evicted->push_back(entries[i].uid);
+        index.erase(entries[i].uid);
+        if (i != entries.size() - 1) {
+            entries[i] = entries.back();
+            index[entries[i].uid] = i;
+        }
+        entries.pop_back();
+        ++count;
+    }
+
+    return count;
+}
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_STATE_H_
+#define BBQUE_ADAPTIVE_CPU_STATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "adaptiveCPU_burst.h"
+#include "adaptiveCPU_controller.h"
+#include "adaptiveCPU_forecast.h"
+#include "adaptiveCPU_hysteresis.h"
+#include "adaptiveCPU_overcommit.h"
+#include "adaptiveCPU_throttle.h"
+#include "adaptiveCPU_tuner.h"
+
+/** No CPU binding domain assigned */
+#define CTRL_NO_BINDING -1
+
+namespace bbque { namespace plugins {
+
+/** Run-time profile sample of an application */
+struct ProfileSample_t
+{
+    int32_t cpu_usage;
+    int32_t ctime_ms;
+    int32_t ggap_percent;
+    bool is_valid;
+
+    inline bool operator==(ProfileSample_t const & other) const {
+        return cpu_usage == other.cpu_usage &&
+            ctime_ms == other.ctime_ms &&
+            ggap_percent == other.ggap_percent &&
+            is_valid == other.is_valid;
+    }
+};
+
+/** Controller state of a single application */
+struct AppCtrlState_t
+{
+    /** Application UID */
+    uint32_t uid;
+    /** Integral and derivative error history */
+    PIDState_t pid;
+    /** Integral and derivative goal gap error history */
+    PIDState_t ggap_pid;
+    /** Quota assigned in the last cycle */
+    uint64_t last_quota;
+    /** CPU binding domain assigned in the last cycle */
+    int32_t last_binding;
+    /** Binding reference number of the last schedule request */
+    int32_t last_ref_num;
+    /** Profile sample used in the last quota computation */
+    ProfileSample_t last_sample;
+    /** Scheduling state of the application in the last cycle */
+    uint8_t last_state;
+    /** Online identification and tuned gains */
+    TunerState_t tuner;
+    /** Usage forecasting (predictive mode) */
+    ForecastState_t forecast;
+    /** Counters of the last cgroup throttling reading */
+    ThrottleState_t throttle;
+    /** Reconfiguration cost estimate and held quota change */
+    ReconfState_t reconf;
+    /** Usage history (overcommit mode) */
+    UsageHistory_t usage;
+    /** Burst credits (latency class) */
+    BurstState_t burst;
+    /** Control error and control variable of the last computation */
+    int64_t last_error;
+    int64_t last_cv;
+    /** The quota must be recomputed in the current cycle */
+    bool dirty;
+    /** Last scheduling cycle the application has been seen */
+    uint32_t last_seen;
+};
+
+/**
+ * @class ControllerStateTable
+ *
+ * Policy-owned store of the per-application controller state, keyed by
+ * application UID. The entries are kept in a contiguous vector, while the
+ * hash map only translates the UID into the entry index. An entry is
+ * created the first time an application is seen, and it is evicted at the
+ * end of the first scheduling cycle not visiting the application.
+ */
+class ControllerStateTable {
+
+public:
+
+    typedef std::vector<AppCtrlState_t>::iterator iterator;
+
+    ControllerStateTable();
+
+    /**
+    * @brief Start a new scheduling cycle
+    */
+    void BeginCycle();
+
+    /**
+    * @brief Get the state of an application, creating it if missing
+    *
+    * The entry is marked as seen in the current cycle.
+    *
+    * @param uid The application UID
+    * @param created Set to true if the entry has been created
+    *
+    * @note The reference is valid until the next Evict() call
+    */
+    AppCtrlState_t & Get(uint32_t uid, bool & created);
+
+    /**
+    * @brief Look for the state of an application
+    *
+    * @return A pointer to the entry or nullptr if missing. The entry is not
+    * marked as seen.
+    */
+    AppCtrlState_t * Find(uint32_t uid);
+
+    /**
+    * @brief Remove the entries not seen in the current cycle
+    *
+    * @param evicted If not null, filled with the UIDs of the removed entries
+    *
+    * @return The number of removed entries
+    */
+    size_t Evict(std::vector<uint32_t> * evicted = nullptr);
+
+    /**
+    * @brief The current scheduling cycle
+    */
+    inline uint32_t Cycle() const { return cycle; }
+
+    inline size_t Size() const { return entries.size(); }
+
+    inline iterator begin() { return entries.begin(); }
+
+    inline iterator end() { return entries.end(); }
+
+private:
+
+    /** Contiguous storage of the entries */
+    std::vector<AppCtrlState_t> entries;
+
+    /** UID to entry index */
+    std::unordered_map<uint32_t, uint32_t> index;
+
+    uint32_t cycle;
+
+};
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_STATE_H_
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_throttle.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "adaptiveCPU_controller.h"
+
+/** The cgroup files are small: a fixed buffer, no allocations */
+#define CGROUP_FILE_BUFFER 1024
+
+namespace bbque { namespace plugins {
+
+namespace {
+
+bool ReadFile(std::string const & path, char * buf, size_t size) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    ssize_t len = read(fd, buf, size - 1);
+    close(fd);
+    if (len <= 0)
+        return false;
+    buf[len] = '\0';
+    return true;
+}
+
+/** The value of "<key> <value>" or "<key>=<value>" after the position */
+bool FindValue(char const * text, char const * key, uint64_t & value) {
+    size_t key_len = strlen(key);
+    for (char const * p = strstr(text, key); p != nullptr;
+            p = strstr(p + 1, key)) {
+        bool start = (p == text || p[-1] == '\n' || p[-1] == ' ');
+        char sep = p[key_len];
+        if (start && (sep == ' ' || sep == '=')) {
+            value = strtoull(p + key_len + 1, nullptr, 10);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Replace(std::string & s, char const * key, std::string const & value) {
+    size_t key_len = strlen(key);
+    for (size_t pos = s.find(key); pos != std::string::npos;
+            pos = s.find(key, pos + value.size()))
+        s.replace(pos, key_len, value);
+}
+
+uint64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+} // namespace
+
+std::string CgroupPath(
+        ThrottleParams_t const & params,
+        std::string const & id,
+        std::string const & name,
+        int32_t pid,
+        uint32_t uid) {
+    std::string path(params.path);
+    Replace(path, "{id}", id);
+    Replace(path, "{name}", name);
+    Replace(path, "{pid}", std::to_string(pid));
+    Replace(path, "{uid}", std::to_string(uid));
+    return params.root + "/" + path;
+}
+
+void ThrottleReset(ThrottleState_t & ts) {
+    ts.valid = false;
+    ts.nr_periods = 0;
+    ts.nr_throttled = 0;
+    ts.throttled_usec = 0;
+    ts.stall_usec = 0;
+    ts.timestamp = 0;
+}
+
+ThrottleSample_t ThrottleUpdate(
+        ThrottleState_t & ts, std::string const & cgroup) {
+    ThrottleSample_t sample = {false, 0, 0};
+    char buf[CGROUP_FILE_BUFFER];
+    ThrottleState_t now;
+    now.timestamp = NowUs();
+
+    if (!ReadFile(cgroup + "/cpu.stat", buf, sizeof(buf)) ||
+            !FindValue(buf, "nr_periods", now.nr_periods) ||
+            !FindValue(buf, "nr_throttled", now.nr_throttled) ||
+            !FindValue(buf, "throttled_usec", now.throttled_usec)) {
+        ts.valid = false;
+        return sample;
+    }
+
+    // The pressure file is missing if PSI is disabled: throttling only
+    now.stall_usec = 0;
+    if (ReadFile(cgroup + "/cpu.pressure", buf, sizeof(buf))) {
+        char const * some = strstr(buf, "some ");
+        if (some != nullptr)
+            FindValue(some, "total", now.stall_usec);
+    }
+    now.valid = true;
+
+    // Counters reset (e.g., the cgroup has been re-created)
+    bool monotonic = ts.valid &&
+        now.nr_periods >= ts.nr_periods &&
+        now.nr_throttled >= ts.nr_throttled &&
+        now.throttled_usec >= ts.throttled_usec &&
+        now.stall_usec >= ts.stall_usec &&
+        now.timestamp > ts.timestamp;
+    if (monotonic) {
+        uint64_t periods = now.nr_periods - ts.nr_periods;
+        float elapsed = now.timestamp - ts.timestamp;
+        sample.valid = true;
+        sample.throttled_periods = periods ?
+            float(now.nr_throttled - ts.nr_throttled) / periods : 0;
+        sample.stall = std::min(1.0f, std::max(
+            (now.throttled_usec - ts.throttled_usec) / elapsed,
+            (now.stall_usec - ts.stall_usec) / elapsed));
+    }
+    ts = now;
+    return sample;
+}
+
+int64_t ThrottleDelta(
+        ThrottleSample_t const & sample,
+        ThrottleParams_t const & params,
+        int64_t neg_delta,
+        uint64_t prev_used) {
+    if (!sample.valid)
+        return neg_delta;
+
+    // Saturated but not starving: the quota fits, no error
+    if (sample.throttled_periods == 0 && sample.stall < params.min_stall)
+        return ADMISSIBLE_DELTA/2;
+
+    // Demand estimate: the usage, had the stalled time been running
+    float stall = std::min(sample.stall, params.max_stall);
+    int64_t shortfall = std::lround(
+        params.gain * prev_used * stall / (1 - stall));
+    shortfall = std::min(shortfall, params.max_step);
+    return std::min(neg_delta, -shortfall);
+}
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_THROTTLE_H_
+#define BBQUE_ADAPTIVE_CPU_THROTTLE_H_
+
+#include <cstdint>
+#include <string>
+
+#define DEFAULT_CGROUP_ROOT "/sys/fs/cgroup"
+#define DEFAULT_CGROUP_PATH "bbque/{id}"
+#define DEFAULT_THROTTLE_GAIN 1.0
+#define DEFAULT_THROTTLE_MAX_STALL 0.9
+#define DEFAULT_THROTTLE_MIN_STALL 0.01
+#define DEFAULT_THROTTLE_MAX_STEP 200
+
+/*
+ * Throttling measurement from the cgroup v2 CPU controller.
+ *
+ * The slack controller sees a saturated quota (usage equal to the quota)
+ * and pushes the constant neg_delta, since it cannot tell an application
+ * exactly fitting its quota from a starving one. The cgroup of the
+ * application tells the difference:
+ *
+ * - cpu.stat: periods throttled (nr_throttled) and time spent throttled
+ *   (throttled_usec) by the CFS bandwidth control;
+ * - cpu.pressure: time some task has been stalled waiting for the CPU
+ *   ("some" line, total).
+ *
+ * The stall fraction s of the last cycle (the largest of the two time
+ * fractions) gives the demand estimate usage / (1 - s): the quota shortfall
+ * replaces neg_delta, so that the quota grows in proportion to the stall.
+ * A saturated application neither throttled nor stalled fits its quota,
+ * and it is left unchanged.
+ */
+
+namespace bbque { namespace plugins {
+
+/** Throttling input configuration */
+struct ThrottleParams_t
+{
+    bool enabled;
+    /** Mount point of the cgroup v2 hierarchy */
+    std::string root;
+    /**
+     * Cgroup of an application, relative to the root. "{id}", "{name}",
+     * "{pid}" and "{uid}" are replaced by the application string ID, name,
+     * PID and UID.
+     */
+    std::string path;
+    /** Gain of the shortfall estimate */
+    float gain;
+    /** Stall fraction bound (the estimate diverges approaching 1) */
+    float max_stall;
+    /** Stall fraction below which an application is not starving */
+    float min_stall;
+    /** Upper bound of the shortfall */
+    int64_t max_step;
+};
+
+/** Cumulative counters of the last reading */
+struct ThrottleState_t
+{
+    bool valid;
+    uint64_t nr_periods;
+    uint64_t nr_throttled;
+    uint64_t throttled_usec;
+    uint64_t stall_usec;
+    /** Time of the reading [us] */
+    uint64_t timestamp;
+};
+
+/** Throttling measured in the last cycle */
+struct ThrottleSample_t
+{
+    bool valid;
+    /** Fraction of the bandwidth periods throttled */
+    float throttled_periods;
+    /** Fraction of time throttled or stalled */
+    float stall;
+};
+
+/**
+ * @brief The cgroup directory of an application
+ */
+std::string CgroupPath(
+        ThrottleParams_t const & params,
+        std::string const & id,
+        std::string const & name,
+        int32_t pid,
+        uint32_t uid);
+
+/**
+ * @brief Reset the throttling state
+ */
+void ThrottleReset(ThrottleState_t & ts);
+
+/**
+ * @brief Read the cgroup counters and compute the throttling since the
+ * previous reading
+ *
+ * @param ts The throttling state of the application (updated)
+ * @param cgroup The cgroup directory of the application
+ *
+ * @return The sample, not valid at the first reading or if the cgroup
+ * files cannot be read
+ */
+ThrottleSample_t ThrottleUpdate(ThrottleState_t & ts, std::string const & cgroup);
+
+/**
+ * @brief The slack to use for a saturated application
+ *
+ * @param sample The throttling of the last cycle
+ * @param params The throttling input configuration
+ * @param neg_delta The slack used without throttling information
+ * @param prev_used CPU usage observed in the previous cycle
+ */
+int64_t ThrottleDelta(
+        ThrottleSample_t const & sample,
+        ThrottleParams_t const & params,
+        int64_t neg_delta,
+        uint64_t prev_used);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_THROTTLE_H_
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Live view of the AdaptiveCPU controller state.
+ *
+ * Reads the snapshot published by the policy after each cycle into the
+ * shared memory segment AdaptiveCPUSchedPol.export_shm, and prints it
+ * top-like: the cycle timing and budget totals, then one row per
+ * application. Reading never blocks the policy.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "adaptiveCPU_export.h"
+
+using namespace bbque::plugins;
+
+typedef enum SortKey {
+    SORT_QUOTA,
+    SORT_USED,
+    SORT_ERROR,
+    SORT_CV,
+    SORT_STALL,
+    SORT_UID
+} SortKey_t;
+
+static void Usage(char const * prog) {
+    fprintf(stderr,
+        "Usage: %s [options] [NAME]\n"
+        "  NAME        shared memory segment (default: %s)\n"
+        "  -d SECONDS  refresh interval (default: 1)\n"
+        "  -n COUNT    exit after COUNT refreshes (default: never)\n"
+        "  -b          batch mode: do not clear the screen\n"
+        "  -s KEY      sort by quota, used, error, cv, stall or uid "
+        "(default: quota)\n",
+        prog, DEFAULT_EXPORT_NAME);
+}
+
+static bool ParseSortKey(char const * name, SortKey_t & key) {
+    static char const * names[] = {
+        "quota", "used", "error", "cv", "stall", "uid" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        if (strcmp(name, names[i]) == 0) {
+            key = static_cast<SortKey_t>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void Sort(std::vector<ExportApp_t> & apps, SortKey_t key) {
+    std::stable_sort(apps.begin(), apps.end(),
+        [key](ExportApp_t const & a, ExportApp_t const & b) {
+            switch (key) {
+            case SORT_USED:
+                return a.used > b.used;
+            case SORT_ERROR:
+                return std::llabs(a.error) > std::llabs(b.error);
+            case SORT_CV:
+                return std::llabs(a.cv) > std::llabs(b.cv);
+            case SORT_STALL:
+                return a.stall > b.stall;
+            case SORT_UID:
+                return a.uid < b.uid;
+            default:
+                return a.next_quota > b.next_quota;
+            }
+        });
+}
+
+/**
+ * Map the segment and copy a snapshot. The segment is mapped again at each
+ * refresh, so that a restarted daemon is followed.
+ */
+static bool Snapshot(
+        std::string const & name,
+        ExportCycle_t & cycle,
+        std::vector<ExportApp_t> & apps,
+        int32_t & owner) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0)
+            close(fd);
+        fprintf(stderr, "Cannot open segment [%s]\n", name.c_str());
+        return false;
+    }
+    void * base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Cannot map segment [%s]\n", name.c_str());
+        return false;
+    }
+
+    ExportHeader_t const * header = static_cast<ExportHeader_t const *>(base);
+    bool valid = StateExporter::Read(header, st.st_size, cycle, apps);
+    if (valid)
+        owner = header->pid;
+    else
+        fprintf(stderr, "No valid snapshot in segment [%s]\n", name.c_str());
+    munmap(base, st.st_size);
+    return valid;
+}
+
+static void Print(
+        ExportCycle_t const & c,
+        std::vector<ExportApp_t> const & apps,
+        int32_t owner) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t now = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+        ts.tv_nsec;
+    double age = (now > c.timestamp) ? (now - c.timestamp) / 1e9 : 0;
+
+    printf("bbque [%d] cycle %" PRIu64 ", %.1f s ago: %.3f ms "
+        "(collect %.3f, control %.3f, reconcile %.3f)\n",
+        owner, c.cycle, age, c.cycle_ms,
+        c.collect_ms, c.control_ms, c.reconcile_ms);
+    printf("CPU: total %" PRIu64 ", available %" PRIu64 ", booked %" PRIu64
+        ", not booked %" PRIu64 "\n",
+        c.total_cpu, c.available_cpu, c.booked_cpu, c.unbooked_cpu);
+    printf("Applications: %u, running %u, not scheduled %u",
+        c.nr_apps + c.nr_dropped, c.nr_running, c.nr_skipped);
+    if (c.nr_dropped > 0)
+        printf(", not exported %u", c.nr_dropped);
+    printf("\n\n");
+
+    printf("%6s %7s %-16s %2s %3s %3s %4s %6s %6s %6s %6s %6s %6s %6s %6s "
+        "%6s %6s %5s %5s %5s %5s %5s %6s\n",
+        "UID", "PID", "NAME", "ST", "PRI", "GRP", "BIND",
+        "QUOTA", "USED", "NEXT", "ERR", "P", "I", "D", "FF", "CV",
+        "IERR", "NEGD", "KP", "KI", "KD", "STALL", "ENERGY");
+    for (auto const & a : apps) {
+        char name[EXPORT_NAME_LEN];
+        memcpy(name, a.name, sizeof(name));
+        name[sizeof(name) - 1] = '\0';
+        char flag = ' ';
+        if (a.flags & EXPORT_SKIPPED)
+            flag = 'S';
+        else if (a.flags & EXPORT_BIND_FAILED)
+            flag = 'B';
+        else if (a.flags & EXPORT_RESET)
+            flag = 'R';
+        else if (a.flags & EXPORT_THROTTLED)
+            flag = 'T';
+        else if (a.flags & EXPORT_BURST)
+            flag = 'U';
+        else if (!(a.flags & EXPORT_RUNNING))
+            flag = 'N';
+        printf("%6u %7d %-16.16s %c%1u %3u %3u %4d %6" PRIu64 " %6" PRIu64
+            " %6" PRIu64 " %6" PRId64 " %6" PRId64 " %6" PRId64 " %6" PRId64
+            " %6" PRId64 " %6" PRId64 " %6" PRId64 " %5d %5.2f %5.2f %5.2f"
+            " %5.2f %6.2f\n",
+            a.uid, a.pid, name, flag, a.state, a.priority, a.group,
+            a.binding, a.quota, a.used, a.next_quota, a.error,
+            a.pvar, a.ivar, a.dvar, a.ffvar, a.cv, a.ierr,
+            a.neg_delta, a.kp, a.ki, a.kd, a.stall, a.energy);
+    }
+}
+
+int main(int argc, char * argv[]) {
+    double interval = 1;
+    long count = 0;
+    bool batch = false;
+    SortKey_t key = SORT_QUOTA;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:bs:h")) != -1) {
+        switch (opt) {
+        case 'd':
+            interval = std::strtod(optarg, nullptr);
+            break;
+        case 'n':
+            count = std::strtol(optarg, nullptr, 10);
+            break;
+        case 'b':
+            batch = true;
+            break;
+        case 's':
+            if (!ParseSortKey(optarg, key)) {
+                fprintf(stderr, "Unknown sort key [%s]\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            Usage(argv[0]);
+            return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind < argc - 1 || interval <= 0) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::string name((optind < argc) ? argv[optind] : DEFAULT_EXPORT_NAME);
+    if (name[0] != '/')
+        name = "/" + name;
+
+    ExportCycle_t cycle;
+    std::vector<ExportApp_t> apps;
+    int32_t owner = 0;
+    for (long i = 0; count == 0 || i < count; ++i) {
+        if (i > 0)
+            usleep(static_cast<useconds_t>(interval * 1e6));
+        if (!Snapshot(name, cycle, apps, owner))
+            return EXIT_FAILURE;
+        Sort(apps, key);
+        if (!batch)
+            printf("\033[H\033[2J");
+        Print(cycle, apps, owner);
+        if (batch)
+            printf("\n");
+        fflush(stdout);
+    }
+    return EXIT_SUCCESS;
+}
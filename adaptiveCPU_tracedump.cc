@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decoder of the AdaptiveCPU decision trace.
+ *
+ * Prints the records of a trace file (AdaptiveCPUSchedPol.trace_file) as
+ * CSV, from the oldest to the newest. The file can be decoded while the
+ * policy is writing it.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "adaptiveCPU_tracer.h"
+
+using namespace bbque::plugins;
+
+#define TRACEDUMP_ALL_UIDS -1
+
+static void Usage(char const * prog) {
+    fprintf(stderr,
+        "Usage: %s [options] FILE\n"
+        "  -u UID      print only the records of the application UID\n"
+        "  -n          do not print the CSV header\n",
+        prog);
+}
+
+int main(int argc, char * argv[]) {
+    int64_t uid = TRACEDUMP_ALL_UIDS;
+    bool print_header = true;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "u:nh")) != -1) {
+        switch (opt) {
+        case 'u':
+            uid = std::strtoll(optarg, nullptr, 10);
+            break;
+        case 'n':
+            print_header = false;
+            break;
+        default:
+            Usage(argv[0]);
+            return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::string path(argv[optind]);
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Cannot open trace file [%s]\n", path.c_str());
+        return EXIT_FAILURE;
+    }
+    void * base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Cannot map trace file [%s]\n", path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::vector<TraceRecord_t> records;
+    uint64_t lost;
+    if (!DecisionTracer::Read(static_cast<TraceHeader_t const *>(base),
+            st.st_size, records, lost)) {
+        fprintf(stderr, "Not a valid trace file [%s]\n", path.c_str());
+        munmap(base, st.st_size);
+        return EXIT_FAILURE;
+    }
+    munmap(base, st.st_size);
+
+    if (print_header)
+        printf("cycle,uid,prev_used,prev_quota,error,pvar,ivar,dvar,cv,"
+            "next_quota,binding,running,skipped,reset,bind_failed\n");
+    for (auto const & r : records) {
+        if (uid != TRACEDUMP_ALL_UIDS && r.uid != uid)
+            continue;
+        printf("%" PRIu64 ",%" PRIu32 ",%" PRIu64 ",%" PRIu64 ","
+            "%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ","
+            "%" PRIu64 ",%" PRId32 ",%d,%d,%d,%d\n",
+            r.cycle, r.uid, r.prev_used, r.prev_quota,
+            r.error, r.pvar, r.ivar, r.dvar, r.cv,
+            r.next_quota, r.binding,
+            (r.flags & TRACE_RUNNING) != 0,
+            (r.flags & TRACE_SKIPPED) != 0,
+            (r.flags & TRACE_RESET) != 0,
+            (r.flags & TRACE_BIND_FAILED) != 0);
+    }
+
+    fprintf(stderr, "%zu records, %" PRIu64 " overwritten\n",
+        records.size(), lost);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_tracer.h"
+
+#include <algorithm>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static_assert(sizeof(bbque::plugins::TraceHeader_t) == 64,
+    "Trace header layout changed: bump TRACE_VERSION");
+static_assert(sizeof(bbque::plugins::TraceRecord_t) == 88,
+    "Trace record layout changed: bump TRACE_VERSION");
+
+namespace bbque { namespace plugins {
+
+DecisionTracer::DecisionTracer():
+        header(nullptr),
+        records(nullptr),
+        mask(0),
+        map_size(0),
+        file_backed(false) {
+}
+
+DecisionTracer::~DecisionTracer() {
+    Close();
+}
+
+bool DecisionTracer::Open(uint32_t capacity, std::string const & path) {
+    Close();
+    if (capacity == 0)
+        return false;
+
+    uint64_t slots = 1;
+    while (slots < capacity)
+        slots <<= 1;
+    size_t size = sizeof(TraceHeader_t) + slots * sizeof(TraceRecord_t);
+
+    void * base;
+    if (path.empty()) {
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    else {
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        if (ftruncate(fd, size) != 0) {
+            close(fd);
+            return false;
+        }
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    if (base == MAP_FAILED)
+        return false;
+
+    header = new (base) TraceHeader_t();
+    header->magic = TRACE_MAGIC;
+    header->version = TRACE_VERSION;
+    header->record_size = sizeof(TraceRecord_t);
+    header->capacity = slots;
+    header->claim.store(0, std::memory_order_relaxed);
+    header->head.store(0, std::memory_order_release);
+    records = reinterpret_cast<TraceRecord_t *>(header + 1);
+    mask = slots - 1;
+    map_size = size;
+    file_backed = !path.empty();
+    return true;
+}
+
+void DecisionTracer::Close() {
+    if (header == nullptr)
+        return;
+    if (file_backed)
+        msync(header, map_size, MS_ASYNC);
+    munmap(header, map_size);
+    header = nullptr;
+    records = nullptr;
+    mask = 0;
+    map_size = 0;
+    file_backed = false;
+}
+
+void DecisionTracer::Sync() {
+    if (header != nullptr && file_backed)
+        msync(header, map_size, MS_ASYNC);
+}
+
+bool DecisionTracer::Read(
+        TraceHeader_t const * header,
+        size_t size,
+        std::vector<TraceRecord_t> & out,
+        uint64_t & lost) {
+    out.clear();
+    lost = 0;
+    if (size < sizeof(TraceHeader_t) ||
+            header->magic != TRACE_MAGIC ||
+            header->version != TRACE_VERSION ||
+            header->record_size != sizeof(TraceRecord_t) ||
+            header->capacity == 0 ||
+            (header->capacity & (header->capacity - 1)) != 0 ||
+            size < sizeof(TraceHeader_t) +
+                header->capacity * sizeof(TraceRecord_t))
+        return false;
+
+    TraceRecord_t const * records =
+        reinterpret_cast<TraceRecord_t const *>(header + 1);
+    uint64_t capacity = header->capacity;
+    uint64_t mask = capacity - 1;
+
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    uint64_t first = (head > capacity) ? head - capacity : 0;
+    for (uint64_t i = first; i < head; ++i)
+        out.push_back(records[i & mask]);
+
+    // The writer may have overwritten the oldest slots while copying: the
+    // slot of record i is intact only if i >= (claim - capacity)
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t claim = header->claim.load(std::memory_order_relaxed);
+    uint64_t safe = (claim > capacity) ? claim - capacity : 0;
+    if (safe > first) {
+        size_t nr_unsafe = std::min<uint64_t>(safe - first, out.size());
+        out.erase(out.begin(), out.begin() + nr_unsafe);
+        first += nr_unsafe;
+    }
+    lost = first;
+    return true;
+}
+
+} // namespace plugins
+
+} // namespace bbque
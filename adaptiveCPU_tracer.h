@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_TRACER_H_
+#define BBQUE_ADAPTIVE_CPU_TRACER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define TRACE_MAGIC 0x55504341 // "ACPU"
+#define TRACE_VERSION 1
+#define DEFAULT_TRACE_RECORDS 4096
+
+/** Decision flags */
+#define TRACE_RUNNING 0x1
+#define TRACE_SKIPPED 0x2
+#define TRACE_RESET 0x4
+#define TRACE_BIND_FAILED 0x8
+
+/*
+ * Binary trace of the controller decisions.
+ *
+ * The records are stored in a ring buffer, overwriting the oldest ones. The
+ * ring is either anonymous memory or a memory-mapped file: in the latter
+ * case the kernel spills the records to the file, and the trace can be
+ * decoded offline, or while the policy is running, by bbque-adaptiveCPU-trace.
+ *
+ * There is a single writer (the scheduling thread), which never blocks: it
+ * claims the slot, stores the record, and then publishes it by advancing the
+ * head counter. A reader copies the published slots and then checks the
+ * claim counter, dropping the records overwritten meanwhile.
+ */
+
+namespace bbque { namespace plugins {
+
+/** Trace file header */
+struct TraceHeader_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    /** Number of record slots (a power of two) */
+    uint32_t capacity;
+    /** Number of records written since the trace has been opened */
+    std::atomic<uint64_t> head;
+    /** Number of records whose write has started */
+    std::atomic<uint64_t> claim;
+    uint64_t reserved[4];
+};
+
+/** A controller decision */
+struct TraceRecord_t
+{
+    uint64_t cycle;
+    uint32_t uid;
+    /** CPU binding domain, or -1 if not bound */
+    int32_t binding;
+    uint64_t prev_used;
+    uint64_t prev_quota;
+    int64_t error;
+    int64_t pvar;
+    int64_t ivar;
+    int64_t dvar;
+    int64_t cv;
+    uint64_t next_quota;
+    /** TRACE_* flags */
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+class DecisionTracer
+{
+public:
+
+    DecisionTracer();
+
+    ~DecisionTracer();
+
+    /**
+    * @brief Open a trace of (at least) the given number of records
+    *
+    * @param capacity The number of records, rounded up to a power of two
+    * @param path The trace file, or empty for an in-memory trace
+    *
+    * @return false if the trace memory could not be allocated
+    */
+    bool Open(uint32_t capacity, std::string const & path);
+
+    /**
+    * @brief Release the trace memory (the trace file is kept)
+    */
+    void Close();
+
+    bool Enabled() const {
+        return header != nullptr;
+    }
+
+    /**
+    * @brief Append a record, overwriting the oldest one if the ring is full
+    */
+    void Record(TraceRecord_t const & rec) {
+        uint64_t head = header->head.load(std::memory_order_relaxed);
+        header->claim.store(head + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        records[head & mask] = rec;
+        header->head.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+    * @brief Schedule the write-back of the trace file
+    */
+    void Sync();
+
+    /**
+    * @brief Copy the records of a trace, from the oldest to the newest
+    *
+    * @param header The trace header, followed by the records
+    * @param size The size of the trace memory
+    * @param out Filled with the records
+    * @param lost Set to the number of records overwritten, or not readable
+    * since overwritten while copying
+    *
+    * @return false if the memory does not hold a valid trace
+    */
+    static bool Read(
+        TraceHeader_t const * header,
+        size_t size,
+        std::vector<TraceRecord_t> & out,
+        uint64_t & lost);
+
+private:
+
+    TraceHeader_t * header;
+    TraceRecord_t * records;
+    uint64_t mask;
+    size_t map_size;
+    bool file_backed;
+
+};
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_TRACER_H_
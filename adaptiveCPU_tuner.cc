@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_tuner.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+/** RLS forgetting factor */
+#define TUNER_FORGETTING 0.95
+/** Minimum quota variation to consider a cycle informative */
+#define TUNER_MIN_EXCITATION 2
+/** Range of the estimated process gain */
+#define TUNER_GAIN_MIN 0.05
+#define TUNER_GAIN_MAX 1.5
+/** Weight of a new sample in the burstiness average */
+#define TUNER_NOISE_ALPHA 0.2
+
+namespace bbque { namespace plugins {
+
+void TunerReset(TunerState_t & ts) {
+    ts.gain = 1.0;
+    ts.cov = 1.0;
+    ts.noise = 0.0;
+    ts.samples = 0;
+    ts.last_slack = 0;
+    ts.last_used = 0;
+    ts.last_u = 0;
+    ts.has_last = false;
+    ts.kp = 0.0;
+    ts.ki = 0.0;
+    ts.kd = 0.0;
+}
+
+void TunerObserve(TunerState_t & ts, int64_t slack, int64_t used) {
+    if (ts.has_last) {
+        float dused = std::llabs(used - ts.last_used);
+        ts.noise += TUNER_NOISE_ALPHA * (dused - ts.noise);
+
+        if (std::llabs(ts.last_u) >= TUNER_MIN_EXCITATION) {
+            float u = ts.last_u;
+            float y = slack - ts.last_slack;
+            float k = ts.cov * u / (TUNER_FORGETTING + u * ts.cov * u);
+            ts.gain += k * (y - ts.gain * u);
+            ts.cov = (ts.cov - k * u * ts.cov) / TUNER_FORGETTING;
+            ts.gain = std::min<float>(
+                std::max<float>(ts.gain, TUNER_GAIN_MIN), TUNER_GAIN_MAX);
+            ++ts.samples;
+        }
+    }
+
+    ts.last_slack = slack;
+    ts.last_used = used;
+    ts.has_last = true;
+}
+
+bool TunerGains(
+        TunerState_t & ts,
+        PIDParams_t const & defaults,
+        TunerBounds_t const & bounds,
+        PIDParams_t & params) {
+    params = defaults;
+    if (ts.samples < TUNER_MIN_SAMPLES || defaults.kp <= 0.0)
+        return false;
+
+    float kp = (1.0 - bounds.pole) / ts.gain;
+    float ki = kp * defaults.ki / defaults.kp;
+    // The derivative action amplifies the usage noise of bursty apps
+    float kd = kp * defaults.kd / defaults.kp /
+        (1.0 + ts.noise / ADMISSIBLE_DELTA);
+
+    ts.kp = std::min(std::max(kp, bounds.kp_min), bounds.kp_max);
+    ts.ki = std::min(std::max(ki, bounds.ki_min), bounds.ki_max);
+    ts.kd = std::min(std::max(kd, bounds.kd_min), bounds.kd_max);
+
+    params.kp = ts.kp;
+    params.ki = ts.ki;
+    params.kd = ts.kd;
+    return true;
+}
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_TUNER_H_
+#define BBQUE_ADAPTIVE_CPU_TUNER_H_
+
+#include <cstdint>
+
+#include "adaptiveCPU_controller.h"
+
+#define DEFAULT_TUNER_POLE 0.5
+#define DEFAULT_TUNER_KP_MIN 0.05
+#define DEFAULT_TUNER_KP_MAX 2.0
+#define DEFAULT_TUNER_KI_MIN 0.0
+#define DEFAULT_TUNER_KI_MAX 1.0
+#define DEFAULT_TUNER_KD_MIN 0.0
+#define DEFAULT_TUNER_KD_MAX 0.5
+#define DEFAULT_IERR_LIMIT 200
+
+/** Identification samples required before using the tuned gains */
+#define TUNER_MIN_SAMPLES 8
+
+/*
+ * Online identification of the response of an application to the quota
+ * variations, and derivation of its PID gains.
+ *
+ * The controlled variable is the slack (quota - usage). An application whose
+ * usage does not follow the quota sees its slack grow one-to-one with the
+ * quota, while an application saturating its quota sees almost no slack
+ * change. The per-cycle model is:
+ *
+ *   slack[k] - slack[k-1] = K * u[k-1] + noise
+ *
+ * where u is the applied quota variation. K is estimated by recursive least
+ * squares with forgetting, using only the cycles with a significant quota
+ * variation (step-response identification on the controller own moves).
+ * The gains place the closed-loop pole of the proportional action at a
+ * configured value (kp = (1 - pole) / K), keep the default ki/kp and kd/kp
+ * ratios, and damp the derivative action of bursty applications.
+ */
+
+namespace bbque { namespace plugins {
+
+/** Bounds and target of the gains derivation */
+struct TunerBounds_t
+{
+    /** Target closed-loop pole, in (0, 1): lower is faster */
+    float pole;
+    float kp_min;
+    float kp_max;
+    float ki_min;
+    float ki_max;
+    float kd_min;
+    float kd_max;
+};
+
+/** Identification state of an application */
+struct TunerState_t
+{
+    /** Estimated process gain K */
+    float gain;
+    /** RLS covariance */
+    float cov;
+    /** Average absolute variation of the usage (burstiness) */
+    float noise;
+    /** Number of identification samples */
+    uint32_t samples;
+    /** Slack and usage of the previous cycle */
+    int64_t last_slack;
+    int64_t last_used;
+    /** Quota variation applied in the previous cycle */
+    int64_t last_u;
+    bool has_last;
+    /** Gains derived from the last estimate */
+    float kp;
+    float ki;
+    float kd;
+};
+
+/**
+* @brief Reset the identification state
+*/
+void TunerReset(TunerState_t & ts);
+
+/**
+* @brief Update the identification with the observation of a new cycle
+*
+* @param ts The identification state
+* @param slack The current slack (quota - usage)
+* @param used The current usage
+*/
+void TunerObserve(TunerState_t & ts, int64_t slack, int64_t used);
+
+/**
+* @brief Derive the gains of an application
+*
+* @param ts The identification state (updated with the derived gains)
+* @param defaults The global controller parameters
+* @param bounds Bounds and target of the derivation
+* @param params Filled with the parameters to use for the application
+*
+* @return true if the gains come from the identification, false if there
+* are not enough samples yet and the defaults are used
+*/
+bool TunerGains(
+        TunerState_t & ts,
+        PIDParams_t const & defaults,
+        TunerBounds_t const & bounds,
+        PIDParams_t & params);
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_TUNER_H_
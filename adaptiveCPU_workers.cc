@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptiveCPU_workers.h"
+
+#include <algorithm>
+
+namespace bbque { namespace plugins {
+
+WorkerPool::WorkerPool():
+    job(nullptr),
+    job_count(0),
+    job_chunk(1),
+    job_next(0),
+    pending(0),
+    generation(0),
+    stop(false) {
+}
+
+WorkerPool::~WorkerPool() {
+    Stop();
+}
+
+void WorkerPool::Stop() {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        stop = true;
+    }
+    start_cv.notify_all();
+    for (auto & t : threads)
+        t.join();
+    threads.clear();
+    stop = false;
+}
+
+void WorkerPool::Resize(uint32_t nr_workers) {
+    if (nr_workers == threads.size())
+        return;
+    Stop();
+    for (uint32_t i = 0; i < nr_workers; ++i)
+        threads.emplace_back(&WorkerPool::Worker, this, generation);
+}
+
+void WorkerPool::RunChunks() {
+    size_t begin;
+    while ((begin = job_next.fetch_add(job_chunk)) < job_count)
+        (*job)(begin, std::min(begin + job_chunk, job_count));
+}
+
+void WorkerPool::Worker(uint64_t seen) {
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            start_cv.wait(lock, [&]{ return stop || generation != seen; });
+            if (stop)
+                return;
+            seen = generation;
+        }
+
+        RunChunks();
+
+        std::unique_lock<std::mutex> lock(mtx);
+        if (--pending == 0)
+            done_cv.notify_one();
+    }
+}
+
+void WorkerPool::ParallelFor(
+        size_t count, size_t min_chunk, RangeFunc_t const & func) {
+    if (min_chunk == 0)
+        min_chunk = 1;
+
+    if (threads.empty() || count <= min_chunk) {
+        func(0, count);
+        return;
+    }
+
+    // Split the range so that each thread gets a few chunks to balance
+    size_t nr_threads = threads.size() + 1;
+    size_t chunk = std::max(min_chunk, count / (nr_threads * 4));
+
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        job = &func;
+        job_count = count;
+        job_chunk = chunk;
+        job_next = 0;
+        pending = threads.size();
+        ++generation;
+    }
+    start_cv.notify_all();
+
+    RunChunks();
+
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [&]{ return pending == 0; });
+    job = nullptr;
+}
+
+} // namespace plugins
+
+} // namespace bbque
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2016  Politecnico di Milano
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBQUE_ADAPTIVE_CPU_WORKERS_H_
+#define BBQUE_ADAPTIVE_CPU_WORKERS_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bbque { namespace plugins {
+
+/**
+ * @class WorkerPool
+ *
+ * A fixed set of threads running data-parallel loops on behalf of the
+ * scheduling policy. The calling thread takes part to the loop, and it
+ * returns only once every chunk has been processed.
+ */
+class WorkerPool {
+
+public:
+
+    typedef std::function<void(size_t, size_t)> RangeFunc_t;
+
+    WorkerPool();
+
+    ~WorkerPool();
+
+    /**
+    * @brief Set the number of worker threads (0 to run serially)
+    */
+    void Resize(uint32_t nr_workers);
+
+    inline uint32_t Size() const { return threads.size(); }
+
+    /**
+    * @brief Run func(begin, end) over the range [0, count)
+    *
+    * @param count The size of the range
+    * @param min_chunk The minimum number of items of a chunk. The loop is
+    * run serially if the range is not larger than a single chunk.
+    * @param func The function processing a chunk of the range
+    */
+    void ParallelFor(size_t count, size_t min_chunk, RangeFunc_t const & func);
+
+private:
+
+    std::vector<std::thread> threads;
+
+    std::mutex mtx;
+
+    std::condition_variable start_cv;
+
+    std::condition_variable done_cv;
+
+    /** The loop currently running */
+    RangeFunc_t const * job;
+    size_t job_count;
+    size_t job_chunk;
+    std::atomic<size_t> job_next;
+
+    /** Workers still running the current loop */
+    uint32_t pending;
+
+    /** Incremented for each new loop */
+    uint64_t generation;
+
+    bool stop;
+
+    /**
+    * @brief Thread body
+    *
+    * @param seen The loop generation at the thread creation: only the
+    * loops started later are run
+    */
+    void Worker(uint64_t seen);
+
+    void RunChunks();
+
+    void Stop();
+
+};
+
+} // namespace plugins
+
+} // namespace bbque
+
+#endif // BBQUE_ADAPTIVE_CPU_WORKERS_H_